@@ -0,0 +1,287 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "BatchPipeline.h"
+#include "GridFile.h"
+#include "MappedFile.h"
+#include "StreamVoxelizer.h"
+#include "BinaryMeshLoader.h"
+
+#define NUM_MESH_SLOTS	2
+
+using namespace std;
+using namespace std::chrono;
+
+static inline double elapsedMs(const steady_clock::time_point &start)
+{
+	return duration<double, milli>(steady_clock::now() - start).count();
+}
+
+static inline uint32_t defaultLoadWorkers()
+{
+	return (max)(thread::hardware_concurrency() / 4, 1u);
+}
+
+// Unreadable files count as OBJ so that they fail where OBJ files do
+static bool isObjFile(const string &fileName)
+{
+	uint64_t fileSize, fileTime;
+	uint8_t header[BinaryMeshLoader::HeaderSize] = {};
+	ifstream file(fileName, ios::binary);
+	if (!file || !MappedFile::Stat(fileName.c_str(), fileSize, fileTime)) return true;
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+
+	return BinaryMeshLoader::DetectFormat(header, static_cast<size_t>(fileSize)) == BinaryMeshLoader::OBJ;
+}
+
+//--------------------------------------------------------------------------------------
+// Blocking queue
+//--------------------------------------------------------------------------------------
+
+template<typename T>
+void BatchPipeline::BlockingQueue<T>::Push(T &&item)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_items.push_back(move(item));
+	}
+	m_condition.notify_one();
+}
+
+template<typename T>
+bool BatchPipeline::BlockingQueue<T>::Pop(T &item)
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_condition.wait(lock, [this]() { return !m_items.empty() || m_closed; });
+	if (m_items.empty()) return false;
+
+	item = move(m_items.front());
+	m_items.pop_front();
+
+	return true;
+}
+
+template<typename T>
+void BatchPipeline::BlockingQueue<T>::Close()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_closed = true;
+	}
+	m_condition.notify_all();
+}
+
+template<typename T>
+void BatchPipeline::BlockingQueue<T>::Reset()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_items.clear();
+	m_closed = false;
+}
+
+//--------------------------------------------------------------------------------------
+// Batch pipeline
+//--------------------------------------------------------------------------------------
+
+BatchPipeline::BatchPipeline(const Options &options) :
+	m_options(options),
+	m_loadScheduler(options.NumLoadWorkers > 0 ? options.NumLoadWorkers : defaultLoadWorkers()),
+	m_voxelizer(options.GridSize),
+	m_numFailed(0),
+	m_numTriangles(0)
+{
+	for (auto &grid : m_grids) grid = make_unique<SparseGrid>(options.GridSize);
+}
+
+BatchPipeline::~BatchPipeline()
+{
+}
+
+uint32_t BatchPipeline::Run(const vector<string> &inputFiles, const vector<string> &outputFiles)
+{
+	m_numFailed = 0;
+	m_numTriangles = 0;
+
+	// Tokens and queues left over from a previous batch
+	m_meshSlots.Reset();
+	m_freeGrids.Reset();
+	m_loadedJobs.Reset();
+	m_voxelizedJobs.Reset();
+	for (auto i = 0u; i < NUM_MESH_SLOTS; ++i) m_meshSlots.Push(move(i));
+	for (auto &grid : m_grids) m_freeGrids.Push(grid.get());
+
+	const auto start = steady_clock::now();
+
+	// Streaming splits OBJ text into batches; binary STL and PLY are loaded whole instead
+	vector<uint32_t> streamIndices, loadIndices;
+	for (auto i = 0u; i < inputFiles.size(); ++i)
+		(m_options.StreamBudget > 0 && isObjFile(inputFiles[i]) ? streamIndices : loadIndices).push_back(i);
+
+	if (!streamIndices.empty()) stream(inputFiles, outputFiles, streamIndices);
+	if (!loadIndices.empty())
+	{
+		// The voxelizer keeps the calling thread so that it owns the default scheduler
+		thread loader(&BatchPipeline::load, this, cref(inputFiles), cref(loadIndices));
+		thread writer(&BatchPipeline::write, this, cref(inputFiles), cref(outputFiles));
+		voxelize();
+		loader.join();
+		writer.join();
+	}
+
+	const auto totalTime = elapsedMs(start);
+	const auto numFiles = static_cast<uint32_t>(inputFiles.size());
+	cout << fixed << setprecision(1) << "Total: " << numFiles - m_numFailed << "/" << numFiles
+		<< " files in " << totalTime << " ms, "
+		<< numFiles * 1000.0 / (max)(totalTime, 1e-3) << " files/s, "
+		<< m_numTriangles / 1000.0 / (max)(totalTime, 1e-3) << " Mtri/s" << endl;
+
+	return m_numFailed;
+}
+
+void BatchPipeline::load(const vector<string> &inputFiles, const vector<uint32_t> &fileIndices)
+{
+	for (const auto &i : fileIndices)
+	{
+		// Wait until the voxelizer has released a mesh
+		uint32_t slot;
+		m_meshSlots.Pop(slot);
+
+		auto job = make_unique<Job>();
+		job->Index = i;
+		job->Mesh = make_unique<ObjLoader>(m_loadScheduler);
+		job->pGrid = nullptr;
+		job->NumTriangles = 0;
+		job->SourceSize = 0;
+		job->OutputSize = 0;
+		job->VoxelizeTime = 0.0;
+		job->WriteTime = 0.0;
+
+		const auto start = steady_clock::now();
+		job->Succeeded = job->Mesh->Import(inputFiles[i].c_str(), true, true, m_options.UseCache);
+		if (job->Succeeded && m_options.Quantize) job->Succeeded = job->Mesh->Quantize();
+		job->LoadTime = elapsedMs(start);
+
+		if (job->Succeeded)
+		{
+			uint64_t modifiedTime;
+			MappedFile::Stat(inputFiles[i].c_str(), job->SourceSize, modifiedTime);
+			job->NumTriangles = job->Mesh->GetNumIndices() / 3;
+		}
+
+		m_loadedJobs.Push(move(job));
+	}
+
+	m_loadedJobs.Close();
+}
+
+void BatchPipeline::voxelize()
+{
+	unique_ptr<Job> job;
+	while (m_loadedJobs.Pop(job))
+	{
+		if (job->Succeeded)
+		{
+			// Wait until the writer has released a grid
+			m_freeGrids.Pop(job->pGrid);
+
+			const auto &mesh = *job->Mesh;
+			const auto start = steady_clock::now();
+			const auto radius = mesh.GetRadius();
+			const auto extent = m_options.Anisotropic ? mesh.GetExtent() : ObjLoader::float3(radius, radius, radius);
+			if (mesh.GetQuantizedVertices())
+				m_voxelizer.SetMesh(mesh.GetNumVertices(), mesh.GetQuantizedVertices(), mesh.GetNumIndices(),
+					mesh.GetIndices(), mesh.GetCenter(), mesh.GetExtent(), mesh.GetCenter(), extent);
+			else m_voxelizer.SetMesh(mesh.GetNumVertices(), mesh.GetVertexStride(), mesh.GetVertices(),
+				mesh.GetNumIndices(), mesh.GetIndices(), mesh.GetCenter(), extent);
+			m_voxelizer.Voxelize(m_options.Method, *job->pGrid);
+			job->VoxelizeTime = elapsedMs(start);
+		}
+
+		// The grid holds everything the writer needs
+		job->Mesh.reset();
+		m_meshSlots.Push(0);
+		m_voxelizedJobs.Push(move(job));
+	}
+
+	m_voxelizedJobs.Close();
+}
+
+void BatchPipeline::write(const vector<string> &inputFiles, const vector<string> &outputFiles)
+{
+	unique_ptr<Job> job;
+	while (m_voxelizedJobs.Pop(job))
+	{
+		if (job->pGrid)
+		{
+			const auto start = steady_clock::now();
+			job->Succeeded = GridFile::Write(outputFiles[job->Index].c_str(), *job->pGrid, &job->OutputSize);
+			job->WriteTime = elapsedMs(start);
+			m_freeGrids.Push(move(job->pGrid));
+		}
+
+		if (job->Succeeded) m_numTriangles += job->NumTriangles;
+		else ++m_numFailed;
+
+		report(*job, inputFiles[job->Index]);
+	}
+}
+
+void BatchPipeline::report(const Job &job, const string &inputFile) const
+{
+	cout << "[" << job.Index + 1 << "] " << inputFile;
+	if (!job.Succeeded)
+	{
+		cout << ": failed" << endl;
+
+		return;
+	}
+
+	const auto mb = 1.0 / (1024.0 * 1024.0);
+	cout << fixed << setprecision(1) << ": " << job.NumTriangles << " tris, load " << job.LoadTime
+		<< " ms (" << job.SourceSize * mb * 1000.0 / (max)(job.LoadTime, 1e-3) << " MB/s), voxelize "
+		<< job.VoxelizeTime << " ms (" << job.NumTriangles / 1000.0 / (max)(job.VoxelizeTime, 1e-3)
+		<< " Mtri/s), write " << job.WriteTime << " ms (" << job.OutputSize * mb * 1000.0 /
+		(max)(job.WriteTime, 1e-3) << " MB/s)" << endl;
+}
+
+void BatchPipeline::stream(const vector<string> &inputFiles, const vector<string> &outputFiles,
+	const vector<uint32_t> &fileIndices)
+{
+	StreamVoxelizer voxelizer(m_options.GridSize, m_options.StreamBudget);
+	const auto mb = 1.0 / (1024.0 * 1024.0);
+
+	for (const auto &i : fileIndices)
+	{
+		const auto &inputFile = inputFiles[i];
+		cout << "[" << i + 1 << "] " << inputFile;
+
+		// The spill file goes next to the output, which is known to be writable
+		auto start = steady_clock::now();
+		if (!voxelizer.Voxelize(inputFile.c_str(), m_options.Method, m_options.Anisotropic,
+			(outputFiles[i] + ".spill").c_str()))
+		{
+			cout << ": failed" << endl;
+			++m_numFailed;
+			continue;
+		}
+		const auto streamTime = elapsedMs(start);
+
+		start = steady_clock::now();
+		uint64_t outputSize = 0;
+		if (!GridFile::Write(outputFiles[i].c_str(), voxelizer.GetGrid(), voxelizer.GetGridSize(), &outputSize))
+		{
+			cout << ": failed" << endl;
+			++m_numFailed;
+			continue;
+		}
+		const auto writeTime = elapsedMs(start);
+
+		const auto numTri = voxelizer.GetNumTriangles();
+		m_numTriangles += numTri;
+		cout << fixed << setprecision(1) << ": " << numTri << " tris, streamed in " << voxelizer.GetNumBatches()
+			<< " batches in " << streamTime << " ms (" << numTri / 1000.0 / (max)(streamTime, 1e-3)
+			<< " Mtri/s, peak batch memory " << voxelizer.GetPeakBatchMemory() * mb << " MB), write " << writeTime
+			<< " ms (" << outputSize * mb * 1000.0 / (max)(writeTime, 1e-3) << " MB/s)" << endl;
+	}
+}
@@ -0,0 +1,89 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelizerCPU.h"
+
+//--------------------------------------------------------------------------------------
+// Three-stage batch voxelizer: loads mesh N+1 while voxelizing N while writing N-1.
+// Each stage runs on its own thread; at most two meshes and two grids are alive.
+//--------------------------------------------------------------------------------------
+class BatchPipeline
+{
+public:
+	struct Options
+	{
+		uint32_t				GridSize;
+		VoxelizerCPU::Method	Method;
+		uint32_t				NumLoadWorkers;		// 0 selects a quarter of the hardware threads
+		bool					UseCache;
+		bool					Anisotropic;		// Scale each axis to fill the grid
+		bool					Quantize;			// Keep only the 10-byte quantized vertices in memory
+		size_t					StreamBudget;		// Out-of-core batches within this many bytes; 0 loads whole meshes
+	};
+
+	BatchPipeline(const Options &options);
+	virtual ~BatchPipeline();
+
+	// Runs one batch and returns the number of files that failed
+	uint32_t Run(const std::vector<std::string> &inputFiles, const std::vector<std::string> &outputFiles);
+
+protected:
+	struct Job
+	{
+		uint32_t					Index;
+		std::unique_ptr<ObjLoader>	Mesh;
+		SparseGrid					*pGrid;
+		bool						Succeeded;
+
+		uint32_t					NumTriangles;
+		uint64_t					SourceSize;
+		uint64_t					OutputSize;
+		double						LoadTime;		// In milliseconds
+		double						VoxelizeTime;
+		double						WriteTime;
+	};
+
+	template<typename T>
+	class BlockingQueue
+	{
+	public:
+		BlockingQueue() : m_closed(false) {}
+
+		void Push(T &&item);
+		bool Pop(T &item);	// Returns false once closed and drained
+		void Close();
+		void Reset();		// Empties and reopens the queue
+
+	protected:
+		std::mutex				m_mutex;
+		std::condition_variable	m_condition;
+		std::deque<T>			m_items;
+		bool					m_closed;
+	};
+
+	// The stages process the files of the given indices
+	void load(const std::vector<std::string> &inputFiles, const std::vector<uint32_t> &fileIndices);
+	void voxelize();
+	void write(const std::vector<std::string> &inputFiles, const std::vector<std::string> &outputFiles);
+	void report(const Job &job, const std::string &inputFile) const;
+
+	// One file at a time through StreamVoxelizer, which overlaps loading internally; OBJ only
+	void stream(const std::vector<std::string> &inputFiles, const std::vector<std::string> &outputFiles,
+		const std::vector<uint32_t> &fileIndices);
+
+	Options						m_options;
+	TaskScheduler				m_loadScheduler;
+	VoxelizerCPU				m_voxelizer;
+	std::unique_ptr<SparseGrid>	m_grids[2];
+
+	BlockingQueue<uint32_t>		m_meshSlots;	// Tokens bounding the meshes in flight
+	BlockingQueue<SparseGrid*>	m_freeGrids;
+	BlockingQueue<std::unique_ptr<Job>> m_loadedJobs;
+	BlockingQueue<std::unique_ptr<Job>> m_voxelizedJobs;
+
+	uint32_t					m_numFailed;
+	uint64_t					m_numTriangles;
+};
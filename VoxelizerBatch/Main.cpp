@@ -0,0 +1,171 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "BatchPipeline.h"
+
+#define GRID_FILE_EXT	".grid"
+
+using namespace std;
+
+static bool hasExtension(const string &fileName, const char *ext)
+{
+	const auto extLen = strlen(ext);
+	if (fileName.size() < extLen) return false;
+
+	return equal(fileName.end() - extLen, fileName.end(), ext, [](char a, char b)
+	{
+		return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b));
+	});
+}
+
+static bool isMeshFile(const string &fileName)
+{
+	return hasExtension(fileName, ".obj") || hasExtension(fileName, ".stl") || hasExtension(fileName, ".ply");
+}
+
+// Recursively collects the OBJ, STL and PLY files under the directory
+static void findMeshes(const string &dir, vector<string> &fileNames)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	const auto hFind = FindFirstFileA((dir + "\\*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE) return;
+
+	do
+	{
+		const string name = findData.cFileName;
+		if (name == "." || name == "..") continue;
+
+		const auto path = dir + "\\" + name;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) findMeshes(path, fileNames);
+		else if (isMeshFile(name)) fileNames.push_back(path);
+	} while (FindNextFileA(hFind, &findData));
+
+	FindClose(hFind);
+#else
+	const auto pDir = opendir(dir.c_str());
+	if (!pDir) return;
+
+	while (const auto pEntry = readdir(pDir))
+	{
+		const string name = pEntry->d_name;
+		if (name == "." || name == "..") continue;
+
+		const auto path = dir + "/" + name;
+		struct stat fileStat;
+		if (stat(path.c_str(), &fileStat) != 0) continue;
+
+		if (S_ISDIR(fileStat.st_mode)) findMeshes(path, fileNames);
+		else if (isMeshFile(name)) fileNames.push_back(path);
+	}
+
+	closedir(pDir);
+#endif
+}
+
+static string getOutputName(const string &inputFile, const string &inputDir, const string &outputDir)
+{
+	auto name = inputFile.substr(0, inputFile.size() - 4) + GRID_FILE_EXT;
+	if (outputDir.empty()) return name;
+
+	// Flatten the relative path so that no subdirectories need to be created
+	name = name.substr(inputDir.size() + 1);
+	replace(name.begin(), name.end(), '\\', '_');
+	replace(name.begin(), name.end(), '/', '_');
+
+	return outputDir + "/" + name;
+}
+
+static void printUsage(const char *exe)
+{
+	cout << "Usage: " << exe << " <mesh directory> [options]" << endl
+		<< "  -gridSize N      voxel grid resolution (default " << GRID_SIZE << ")" << endl
+		<< "  -method M        proj, tess, union or sat (default proj)" << endl
+		<< "  -output DIR      output directory (default: next to each mesh)" << endl
+		<< "  -loadThreads N   worker threads for mesh loading (default: a quarter of the cores)" << endl
+		<< "  -cache           read and write binary mesh caches next to the meshes" << endl
+		<< "  -anisotropic     scale each axis to fill the grid instead of the largest one" << endl
+		<< "  -quantize        voxelize from 16-bit quantized vertices, halving mesh memory" << endl
+		<< "  -stream MB       out-of-core: stream each OBJ in batches within this memory budget;" << endl
+		<< "                   STL and PLY files are still loaded whole" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		printUsage(argv[0]);
+
+		return 1;
+	}
+
+	string inputDir = argv[1];
+	string outputDir;
+	BatchPipeline::Options options = { GRID_SIZE, VoxelizerCPU::TRI_PROJ, 0, false, false, false, 0 };
+
+	for (auto i = 2; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if ((arg == "-gridSize" || arg == "/gridSize") && i + 1 < argc)
+		{
+			const auto gridSize = atoi(argv[++i]);
+			options.GridSize = gridSize > 1 ? gridSize : options.GridSize;
+		}
+		else if ((arg == "-method" || arg == "/method") && i + 1 < argc)
+		{
+			const string method = argv[++i];
+			if (method == "proj") options.Method = VoxelizerCPU::TRI_PROJ;
+			else if (method == "tess") options.Method = VoxelizerCPU::TRI_PROJ_TESS;
+			else if (method == "union") options.Method = VoxelizerCPU::TRI_PROJ_UNION;
+			else if (method == "sat") options.Method = VoxelizerCPU::TRI_SAT;
+			else
+			{
+				cerr << "Unknown method: " << method << endl;
+
+				return 1;
+			}
+		}
+		else if ((arg == "-output" || arg == "/output") && i + 1 < argc) outputDir = argv[++i];
+		else if ((arg == "-loadThreads" || arg == "/loadThreads") && i + 1 < argc)
+		{
+			const auto numThreads = atoi(argv[++i]);
+			options.NumLoadWorkers = numThreads > 0 ? numThreads : 0;
+		}
+		else if (arg == "-cache" || arg == "/cache") options.UseCache = true;
+		else if (arg == "-anisotropic" || arg == "/anisotropic") options.Anisotropic = true;
+		else if (arg == "-quantize" || arg == "/quantize") options.Quantize = true;
+		else if ((arg == "-stream" || arg == "/stream") && i + 1 < argc)
+		{
+			const auto budget = atoi(argv[++i]);
+			options.StreamBudget = budget > 0 ? static_cast<size_t>(budget) << 20 : 0;
+		}
+		else
+		{
+			printUsage(argv[0]);
+
+			return 1;
+		}
+	}
+
+	while (!inputDir.empty() && (inputDir.back() == '/' || inputDir.back() == '\\')) inputDir.pop_back();
+
+	vector<string> inputFiles;
+	findMeshes(inputDir, inputFiles);
+	sort(inputFiles.begin(), inputFiles.end());
+	if (inputFiles.empty())
+	{
+		cerr << "No mesh files found in " << inputDir << endl;
+
+		return 1;
+	}
+
+	vector<string> outputFiles;
+	outputFiles.reserve(inputFiles.size());
+	for (const auto &inputFile : inputFiles)
+		outputFiles.push_back(getOutputName(inputFile, inputDir, outputDir));
+
+	BatchPipeline pipeline(options);
+
+	return pipeline.Run(inputFiles, outputFiles) > 0 ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CacheSimulator.h"
+
+#define INVALID_TAG	UINT64_MAX
+
+using namespace std;
+
+CacheSimulator::CacheSimulator(const Level &l1, const Level &l2, uint32_t lineSize) :
+	m_lineShift(0),
+	m_numAccesses(0)
+{
+	while ((2u << m_lineShift) <= lineSize) ++m_lineShift;
+	init(m_l1, l1, 1 << m_lineShift);
+	init(m_l2, l2, 1 << m_lineShift);
+}
+
+CacheSimulator::~CacheSimulator()
+{
+}
+
+void CacheSimulator::Reset()
+{
+	for (auto cache : { &m_l1, &m_l2 })
+	{
+		fill(cache->Tags.begin(), cache->Tags.end(), INVALID_TAG);
+		cache->NumMisses = 0;
+	}
+	m_numAccesses = 0;
+}
+
+void CacheSimulator::Access(uint64_t address)
+{
+	const auto line = address >> m_lineShift;
+	++m_numAccesses;
+
+	// Only L1 misses reach L2
+	if (!access(m_l1, line)) access(m_l2, line);
+}
+
+uint64_t CacheSimulator::GetNumAccesses() const
+{
+	return m_numAccesses;
+}
+
+uint64_t CacheSimulator::GetNumL1Misses() const
+{
+	return m_l1.NumMisses;
+}
+
+uint64_t CacheSimulator::GetNumL2Misses() const
+{
+	return m_l2.NumMisses;
+}
+
+void CacheSimulator::init(Cache &cache, const Level &level, uint32_t lineSize)
+{
+	cache.Ways = (max)(level.Ways, 1u);
+	cache.NumSets = (max)(level.Size / (lineSize * cache.Ways), 1u);
+	cache.Tags.assign(static_cast<size_t>(cache.NumSets) * cache.Ways, INVALID_TAG);
+	cache.NumMisses = 0;
+}
+
+bool CacheSimulator::access(Cache &cache, uint64_t line)
+{
+	const auto pSet = &cache.Tags[static_cast<size_t>(line % cache.NumSets) * cache.Ways];
+
+	// Move the line to the front of its set; on a miss the least recently used falls out
+	auto way = 0u;
+	while (way + 1 < cache.Ways && pSet[way] != line) ++way;
+	const auto hit = pSet[way] == line;
+	for (; way > 0; --way) pSet[way] = pSet[way - 1];
+	pSet[0] = line;
+
+	if (!hit) ++cache.NumMisses;
+
+	return hit;
+}
@@ -0,0 +1,47 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Two-level set-associative LRU cache model counting the misses of an address stream.
+// Hardware counters are not portable, so the layout benchmark replays its accesses here.
+//--------------------------------------------------------------------------------------
+class CacheSimulator
+{
+public:
+	struct Level
+	{
+		uint32_t Size;			// In bytes
+		uint32_t Ways;
+	};
+
+	// Defaults to a typical 32 KB 8-way L1D and 1 MB 16-way L2 with 64-byte lines
+	CacheSimulator(const Level &l1 = { 32 << 10, 8 }, const Level &l2 = { 1 << 20, 16 }, uint32_t lineSize = 64);
+	virtual ~CacheSimulator();
+
+	void Reset();
+	void Access(uint64_t address);
+
+	uint64_t GetNumAccesses() const;
+	uint64_t GetNumL1Misses() const;
+	uint64_t GetNumL2Misses() const;
+
+protected:
+	struct Cache
+	{
+		std::vector<uint64_t>	Tags;		// Per set, most recently used first
+		uint32_t				NumSets;
+		uint32_t				Ways;
+		uint64_t				NumMisses;
+	};
+
+	static void init(Cache &cache, const Level &level, uint32_t lineSize);
+	static bool access(Cache &cache, uint64_t line);
+
+	Cache		m_l1;
+	Cache		m_l2;
+	uint32_t	m_lineShift;
+	uint64_t	m_numAccesses;
+};
@@ -0,0 +1,289 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "LayoutBenchmark.h"
+#include "SolidFill.h"
+
+#define NUM_SAMPLES			128		// Same as PSRayCast.hlsl
+#define ZERO_THRESHOLD		0.01f
+#define RAY_GRAIN_SIZE		256
+#define STENCIL_GRAIN_SIZE	(1 << 16)
+
+using namespace std;
+using namespace std::chrono;
+
+using float3 = ObjLoader::float3;
+
+static const char *g_methodNames[] = { "TRI_PROJ", "TRI_PROJ_TESS", "TRI_PROJ_UNION", "TRI_SAT" };
+
+static void printMisses(const CacheSimulator &cache)
+{
+	const auto numAccesses = max<uint64_t>(cache.GetNumAccesses(), 1);
+	cout << ", L1 misses " << cache.GetNumL1Misses() / 1000.0 << "K (" << 100.0 * cache.GetNumL1Misses() / numAccesses
+		<< "%), L2 misses " << cache.GetNumL2Misses() / 1000.0 << "K (" << 100.0 * cache.GetNumL2Misses() / numAccesses << "%)";
+}
+
+LayoutBenchmark::LayoutBenchmark(const Options &options, TaskScheduler &scheduler) :
+	m_options(options),
+	m_scheduler(scheduler)
+{
+	m_options.NumRepeats = (max)(m_options.NumRepeats, 1u);
+}
+
+LayoutBenchmark::~LayoutBenchmark()
+{
+}
+
+bool LayoutBenchmark::Run(const ObjLoader &mesh)
+{
+	VoxelizerCPU voxelizer(m_options.GridSize, m_scheduler);
+	voxelizer.SetMesh(mesh.GetNumVertices(), mesh.GetVertexStride(), mesh.GetVertices(),
+		mesh.GetNumIndices(), mesh.GetIndices(), mesh.GetCenter(), mesh.GetRadius());
+	voxelizer.Voxelize(VoxelizerCPU::TRI_PROJ);
+	const auto reference = voxelizer.GetGrid();
+	const auto numTri = mesh.GetNumIndices() / 3;
+
+	generateRays();
+
+	cout << fixed << setprecision(1) << "Grid " << m_options.GridSize << "^3, " << numTri
+		<< " triangles, " << m_rays.size() << " rays, " << m_scheduler.GetNumWorkers() << " workers, BMI2 "
+		<< (VOXEL_LAYOUT_BMI2 ? "on" : "off") << endl;
+
+	auto succeeded = runLayout<LinearLayout>(voxelizer, reference, numTri);
+	succeeded = runLayout<MortonLayout>(voxelizer, reference, numTri) && succeeded;
+	succeeded = runLayout<TiledLayout>(voxelizer, reference, numTri) && succeeded;
+
+	return succeeded;
+}
+
+template<typename Layout>
+bool LayoutBenchmark::runLayout(VoxelizerCPU &voxelizer, const vector<uint32_t> &reference, uint32_t numTri)
+{
+	VoxelGrid<Layout> grid(m_options.GridSize, m_scheduler);
+	cout << Layout::GetName() << ": padded " << grid.GetPaddedSize() << "^3, "
+		<< grid.GetNumVoxels() * sizeof(uint32_t) / (1024.0 * 1024.0) << " MB" << endl;
+
+	// Surface voxelization
+	for (uint8_t i = 0; i < VoxelizerCPU::NUM_METHOD; ++i)
+	{
+		const auto method = static_cast<VoxelizerCPU::Method>(i);
+		const auto time = measure([&]() { voxelizer.Voxelize(method, grid); });
+		cout << "  voxelize " << g_methodNames[i] << ": " << time << " ms ("
+			<< numTri / 1000.0 / time << " Mtri/s)" << endl;
+	}
+
+	voxelizer.Voxelize(VoxelizerCPU::TRI_PROJ, grid);
+	vector<uint32_t> linear;
+	grid.ToLinear(linear);
+	const auto matched = linear == reference;
+	if (!matched) cout << "  MISMATCH against the linear reference" << endl;
+
+	// Solid fill, restoring the surface before each run; the filled count doubles as a checksum
+	SolidFill solidFill(m_scheduler);
+	auto time = measure([&]() { solidFill.Fill(grid); }, [&]() { voxelizer.Voxelize(VoxelizerCPU::TRI_PROJ, grid); });
+	cout << "  solid fill: " << time << " ms (" << grid.GetNumVoxels() / 1000.0 / time << " Mvoxels/s, checksum "
+		<< solidFill.GetNumFilled() << ")" << endl;
+	voxelizer.Voxelize(VoxelizerCPU::TRI_PROJ, grid);
+
+	const auto pData = grid.GetData();
+	const auto read = [pData](uint64_t i) { return pData[i]; };
+
+	// Ray march; the sample count doubles as a checksum across layouts
+	atomic<uint64_t> numSamples(0);
+	time = measure([&]()
+	{
+		numSamples = 0;
+		m_scheduler.ParallelFor(0, static_cast<uint32_t>(m_rays.size()), RAY_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+		{
+			auto samples = 0ull;
+			for (auto i = begin; i < end; ++i) samples += rayMarch(grid, m_rays[i], read);
+			numSamples += samples;
+		});
+	});
+
+	CacheSimulator cache;
+	for (const auto &ray : m_rays) rayMarch(grid, ray, [&](uint64_t i) { cache.Access(i * sizeof(uint32_t)); return pData[i]; });
+
+	cout << "  ray march: " << time << " ms (" << numSamples / 1000.0 / time << " Msamples/s, checksum "
+		<< numSamples.load() << ")";
+	printMisses(cache);
+	cout << endl;
+
+	// Neighbor stencil in storage order
+	const auto numBlocks = static_cast<uint32_t>((grid.GetNumVoxels() + STENCIL_GRAIN_SIZE - 1) / STENCIL_GRAIN_SIZE);
+	atomic<uint64_t> numNeighbors(0);
+	time = measure([&]()
+	{
+		numNeighbors = 0;
+		m_scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+		{
+			const auto blockEnd = (min)(static_cast<uint64_t>(end) * STENCIL_GRAIN_SIZE, grid.GetNumVoxels());
+			numNeighbors += stencil(grid, static_cast<uint64_t>(begin) * STENCIL_GRAIN_SIZE, blockEnd, read);
+		});
+	});
+
+	cache.Reset();
+	stencil(grid, 0, grid.GetNumVoxels(), [&](uint64_t i) { cache.Access(i * sizeof(uint32_t)); return pData[i]; });
+
+	cout << "  stencil: " << time << " ms (" << grid.GetNumVoxels() / 1000.0 / time << " Mvoxels/s, checksum "
+		<< numNeighbors.load() << ")";
+	printMisses(cache);
+	cout << endl;
+
+	return matched;
+}
+
+template<typename Layout, typename ReadFunc>
+uint32_t LayoutBenchmark::rayMarch(const VoxelGrid<Layout> &grid, const Ray &ray, const ReadFunc &readFunc) const
+{
+	const auto gridSize = static_cast<float>(grid.GetGridSize());
+	const float origin[] = { ray.Origin.x, ray.Origin.y, ray.Origin.z };
+	const float dir[] = { ray.Dir.x, ray.Dir.y, ray.Dir.z };
+
+	// Clip the ray to the grid box
+	auto tNear = 0.0f, tFar = FLT_MAX;
+	for (auto i = 0u; i < 3; ++i)
+	{
+		const auto invDir = 1.0f / dir[i];
+		auto t0 = -origin[i] * invDir;
+		auto t1 = (gridSize - origin[i]) * invDir;
+		if (t0 > t1) swap(t0, t1);
+		tNear = (max)(tNear, t0);
+		tFar = (min)(tFar, t1);
+	}
+	if (tNear >= tFar) return 0;
+
+	// Same step and opacity model as PSRayCast, in voxel units
+	const auto stepScale = 2.0f * sqrtf(3.0f) / NUM_SAMPLES;
+	const auto step = stepScale * gridSize * 0.5f;
+	const auto maxCoord = grid.GetGridSize() - 1;
+	auto transmit = 1.0f;
+	auto numSamples = 0u;
+	for (auto t = tNear; t < tFar && numSamples < NUM_SAMPLES; t += step, ++numSamples)
+	{
+		const float pos[] = { origin[0] + dir[0] * t - 0.5f, origin[1] + dir[1] * t - 0.5f, origin[2] + dir[2] * t - 0.5f };
+		uint32_t base[3];
+		float frac[3];
+		for (auto i = 0u; i < 3; ++i)
+		{
+			const auto p = (max)(pos[i], 0.0f);
+			base[i] = (min)(static_cast<uint32_t>(p), maxCoord);
+			frac[i] = p - base[i];
+		}
+
+		// Trilinear filtering of the alpha channel, as the linear sampler would do
+		auto density = 0.0f;
+		for (auto i = 0u; i < 8; ++i)
+		{
+			const auto x = (min)(base[0] + (i & 1), maxCoord);
+			const auto y = (min)(base[1] + ((i >> 1) & 1), maxCoord);
+			const auto z = (min)(base[2] + (i >> 2), maxCoord);
+			const auto weight = (i & 1 ? frac[0] : 1.0f - frac[0]) * ((i >> 1) & 1 ? frac[1] : 1.0f - frac[1]) *
+				(i >> 2 ? frac[2] : 1.0f - frac[2]);
+			density += weight * (readFunc(grid.GetIndex(x, y, z)) >> 30) / 3.0f;
+		}
+		density = (min)(density * 8.0f, 16.0f);
+
+		transmit *= (max)(1.0f - density * stepScale, 0.0f);
+		if (transmit < ZERO_THRESHOLD) break;
+	}
+
+	return numSamples;
+}
+
+template<typename Layout, typename ReadFunc>
+uint32_t LayoutBenchmark::stencil(const VoxelGrid<Layout> &grid, uint64_t begin, uint64_t end, const ReadFunc &readFunc) const
+{
+	const auto gridSize = grid.GetGridSize();
+	const auto paddedSize = grid.GetPaddedSize();
+	auto numNeighbors = 0u;
+	for (auto i = begin; i < end; ++i)
+	{
+		uint32_t x, y, z;
+		Layout::Decode(i, paddedSize, x, y, z);
+		if (x >= gridSize || y >= gridSize || z >= gridSize || !readFunc(i)) continue;
+
+		if (x > 0) numNeighbors += readFunc(grid.GetIndex(x - 1, y, z)) ? 1 : 0;
+		if (y > 0) numNeighbors += readFunc(grid.GetIndex(x, y - 1, z)) ? 1 : 0;
+		if (z > 0) numNeighbors += readFunc(grid.GetIndex(x, y, z - 1)) ? 1 : 0;
+		if (x + 1 < gridSize) numNeighbors += readFunc(grid.GetIndex(x + 1, y, z)) ? 1 : 0;
+		if (y + 1 < gridSize) numNeighbors += readFunc(grid.GetIndex(x, y + 1, z)) ? 1 : 0;
+		if (z + 1 < gridSize) numNeighbors += readFunc(grid.GetIndex(x, y, z + 1)) ? 1 : 0;
+	}
+
+	return numNeighbors;
+}
+
+void LayoutBenchmark::generateRays()
+{
+	// Pinhole camera on a random direction around the grid, with pixels in scanline order
+	const auto resolution = static_cast<uint32_t>(sqrt(static_cast<double>(m_options.NumRays)));
+	const auto gridSize = static_cast<float>(m_options.GridSize);
+	mt19937 rng(m_options.Seed);
+	uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+	float3 forward;
+	float len;
+	do
+	{
+		forward = float3(uniform(rng), uniform(rng), uniform(rng));
+		len = sqrtf(forward.x * forward.x + forward.y * forward.y + forward.z * forward.z);
+	} while (len < 0.1f || len > 1.0f);
+	forward = float3(-forward.x / len, -forward.y / len, -forward.z / len);
+
+	const auto center = gridSize * 0.5f;
+	const auto eye = float3(center - forward.x * gridSize * 2.0f, center - forward.y * gridSize * 2.0f,
+		center - forward.z * gridSize * 2.0f);
+
+	// Right and up vectors; any up hint not parallel to forward will do
+	const auto hint = fabsf(forward.y) < 0.9f ? float3(0.0f, 1.0f, 0.0f) : float3(1.0f, 0.0f, 0.0f);
+	auto right = float3(hint.y * forward.z - hint.z * forward.y, hint.z * forward.x - hint.x * forward.z,
+		hint.x * forward.y - hint.y * forward.x);
+	len = sqrtf(right.x * right.x + right.y * right.y + right.z * right.z);
+	right = float3(right.x / len, right.y / len, right.z / len);
+	const auto up = float3(forward.y * right.z - forward.z * right.y, forward.z * right.x - forward.x * right.z,
+		forward.x * right.y - forward.y * right.x);
+
+	// A 45-degree field of view frames the grid from twice its size away
+	const auto tanHalfFov = tanf(0.392699082f);
+	m_rays.resize(static_cast<size_t>(resolution) * resolution);
+	for (auto j = 0u; j < resolution; ++j)
+	{
+		for (auto i = 0u; i < resolution; ++i)
+		{
+			const auto u = ((i + 0.5f) / resolution * 2.0f - 1.0f) * tanHalfFov;
+			const auto v = ((j + 0.5f) / resolution * 2.0f - 1.0f) * tanHalfFov;
+			auto dir = float3(forward.x + right.x * u + up.x * v, forward.y + right.y * u + up.y * v,
+				forward.z + right.z * u + up.z * v);
+			len = sqrtf(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+
+			auto &ray = m_rays[static_cast<size_t>(j) * resolution + i];
+			ray.Origin = eye;
+			ray.Dir = float3(dir.x / len, dir.y / len, dir.z / len);
+		}
+	}
+}
+
+template<typename Func>
+double LayoutBenchmark::measure(const Func &func) const
+{
+	return measure(func, []() {});
+}
+
+template<typename Func, typename SetupFunc>
+double LayoutBenchmark::measure(const Func &func, const SetupFunc &setupFunc) const
+{
+	vector<double> times(m_options.NumRepeats);
+	for (auto &time : times)
+	{
+		setupFunc();
+		const auto start = steady_clock::now();
+		func();
+		time = duration<double, milli>(steady_clock::now() - start).count();
+	}
+
+	nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+
+	return times[times.size() / 2];
+}
@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelizerCPU.h"
+#include "CacheSimulator.h"
+
+//--------------------------------------------------------------------------------------
+// Compares the voxel storage layouts on surface voxelization, solid fill, a volume ray
+// march with the access pattern of PSRayCast, and a 6-neighbor stencil over the voxels
+//--------------------------------------------------------------------------------------
+class LayoutBenchmark
+{
+public:
+	struct Options
+	{
+		uint32_t	GridSize;
+		uint32_t	NumRepeats;
+		uint32_t	NumRays;
+		uint32_t	Seed;
+	};
+
+	LayoutBenchmark(const Options &options, TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~LayoutBenchmark();
+
+	// Returns false if any layout disagrees with the linear reference grid
+	bool Run(const ObjLoader &mesh);
+
+protected:
+	struct Ray
+	{
+		ObjLoader::float3 Origin;	// In voxel units
+		ObjLoader::float3 Dir;
+	};
+
+	template<typename Layout>
+	bool runLayout(VoxelizerCPU &voxelizer, const std::vector<uint32_t> &reference, uint32_t numTri);
+
+	// ReadFunc: uint32_t(uint64_t index)
+	template<typename Layout, typename ReadFunc>
+	uint32_t rayMarch(const VoxelGrid<Layout> &grid, const Ray &ray, const ReadFunc &readFunc) const;
+	template<typename Layout, typename ReadFunc>
+	uint32_t stencil(const VoxelGrid<Layout> &grid, uint64_t begin, uint64_t end, const ReadFunc &readFunc) const;
+
+	void generateRays();
+
+	// Runs func NumRepeats times and returns the median in milliseconds; setupFunc is not timed
+	template<typename Func>
+	double measure(const Func &func) const;
+	template<typename Func, typename SetupFunc>
+	double measure(const Func &func, const SetupFunc &setupFunc) const;
+
+	Options				m_options;
+	TaskScheduler		&m_scheduler;
+	std::vector<Ray>	m_rays;
+};
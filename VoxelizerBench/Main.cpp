@@ -0,0 +1,190 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "LayoutBenchmark.h"
+#include "StageBenchmark.h"
+
+using namespace std;
+
+static void printUsage(const char *exe)
+{
+	cout << "Usage: " << exe << " [mesh...] [options]" << endl
+		<< "  -gridSize N   voxel grid resolution (default 256)" << endl
+		<< "  -repeat N     runs per measurement (default 5, or 25 with -stages)" << endl
+		<< "  -rays N       rays for the ray-march pass (default 65536)" << endl
+		<< "  -seed N       random seed of the camera and the synthetic meshes (default 1)" << endl
+		<< "  -stages       time each pipeline stage on synthetic and the given meshes instead" << endl
+		<< "  -sparse       check the sparse grid against the dense grid at 64^3, 128^3 and 256^3 instead" << endl
+		<< "  -json FILE    write the stage report to FILE rather than stdout" << endl
+		<< "  -temp DIR     directory for the synthetic meshes (default: the system temp directory)" << endl;
+}
+
+static string getTempDir()
+{
+#ifdef _WIN32
+	char tempPath[MAX_PATH + 1];
+	const auto length = GetTempPathA(MAX_PATH + 1, tempPath);
+	string tempDir(tempPath, length <= MAX_PATH ? length : 0);
+#else
+	const auto pTemp = getenv("TMPDIR");
+	string tempDir = pTemp ? pTemp : "/tmp";
+#endif
+	while (!tempDir.empty() && (tempDir.back() == '/' || tempDir.back() == '\\')) tempDir.pop_back();
+
+	return tempDir;
+}
+
+static string getMeshName(const string &fileName)
+{
+	const auto slash = fileName.find_last_of("/\\");
+	const auto name = slash == string::npos ? fileName : fileName.substr(slash + 1);
+
+	return name.substr(0, name.find_last_of('.'));
+}
+
+static int runStages(const vector<string> &meshFiles, const StageBenchmark::Options &options,
+	const string &jsonFile, const string &tempDir)
+{
+	StageBenchmark benchmark(options);
+	if (!benchmark.AddSyntheticMeshes(tempDir))
+	{
+		cerr << "Failed to write the synthetic meshes to " << tempDir << endl;
+
+		return 1;
+	}
+
+	// The bundled mesh unless others are given
+	if (meshFiles.empty())
+	{
+		const string bundledFile = "Media/bunny.obj";
+		if (ifstream(bundledFile)) benchmark.AddMesh("bunny", bundledFile);
+	}
+	for (const auto &meshFile : meshFiles) benchmark.AddMesh(getMeshName(meshFile), meshFile);
+
+	if (jsonFile.empty()) return benchmark.Run(cout, cerr) ? 0 : 1;
+
+	ofstream file(jsonFile, ios::trunc);
+	if (!file)
+	{
+		cerr << "Failed to create " << jsonFile << endl;
+
+		return 1;
+	}
+
+	return benchmark.Run(file, cout) ? 0 : 1;
+}
+
+static int runSparseCheck(const vector<string> &meshFiles)
+{
+	static const char *methodNames[] = { "TRI_PROJ", "TRI_PROJ_TESS", "TRI_PROJ_UNION", "TRI_SAT" };
+	static const uint32_t gridSizes[] = { 64, 128, 256 };
+
+	auto succeeded = true;
+	for (const auto &meshFile : meshFiles)
+	{
+		ObjLoader mesh;
+		if (!mesh.Import(meshFile.c_str()))
+		{
+			cerr << "Failed to load " << meshFile << endl;
+
+			return 1;
+		}
+
+		cout << getMeshName(meshFile) << ": " << mesh.GetNumIndices() / 3 << " triangles" << endl;
+		for (const auto &gridSize : gridSizes)
+		{
+			VoxelizerCPU voxelizer(gridSize);
+			voxelizer.SetMesh(mesh.GetNumVertices(), mesh.GetVertexStride(), mesh.GetVertices(),
+				mesh.GetNumIndices(), mesh.GetIndices(), mesh.GetCenter(), mesh.GetRadius());
+
+			SparseGrid sparseGrid(gridSize);
+			vector<uint32_t> dense;
+			for (uint8_t i = 0; i < VoxelizerCPU::NUM_METHOD; ++i)
+			{
+				const auto method = static_cast<VoxelizerCPU::Method>(i);
+				voxelizer.Voxelize(method);
+				voxelizer.Voxelize(method, sparseGrid);
+				sparseGrid.ToDense(dense);
+
+				const auto &reference = voxelizer.GetGrid();
+				uint64_t numMismatches = 0;
+				for (size_t j = 0; j < reference.size(); ++j) numMismatches += dense[j] != reference[j];
+
+				cout << "  " << gridSize << "^3 " << methodNames[i] << ": " << sparseGrid.GetNumBricks() << " bricks, "
+					<< sparseGrid.GetMemorySize() / 1024 << " KB";
+				if (numMismatches) cout << ", MISMATCH against the dense grid in " << numMismatches << " voxels";
+				cout << endl;
+				succeeded = succeeded && !numMismatches;
+			}
+		}
+	}
+
+	return succeeded ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	vector<string> meshFiles;
+	LayoutBenchmark::Options options = { 256, 0, 65536, 1 };
+	string jsonFile, tempDir = getTempDir();
+	auto stages = false;
+	auto sparse = false;
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if ((arg == "-gridSize" || arg == "/gridSize") && i + 1 < argc)
+		{
+			const auto gridSize = atoi(argv[++i]);
+			options.GridSize = gridSize > 1 ? gridSize : options.GridSize;
+		}
+		else if ((arg == "-repeat" || arg == "/repeat") && i + 1 < argc)
+		{
+			const auto numRepeats = atoi(argv[++i]);
+			options.NumRepeats = numRepeats > 0 ? numRepeats : options.NumRepeats;
+		}
+		else if ((arg == "-rays" || arg == "/rays") && i + 1 < argc)
+		{
+			const auto numRays = atoi(argv[++i]);
+			options.NumRays = numRays > 0 ? numRays : options.NumRays;
+		}
+		else if ((arg == "-seed" || arg == "/seed") && i + 1 < argc) options.Seed = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (arg == "-stages" || arg == "/stages") stages = true;
+		else if (arg == "-sparse" || arg == "/sparse") sparse = true;
+		else if ((arg == "-json" || arg == "/json") && i + 1 < argc) jsonFile = argv[++i];
+		else if ((arg == "-temp" || arg == "/temp") && i + 1 < argc) tempDir = argv[++i];
+		else if (arg[0] != '-') meshFiles.push_back(arg);
+		else
+		{
+			printUsage(argv[0]);
+
+			return 1;
+		}
+	}
+
+	if (stages)
+	{
+		const StageBenchmark::Options stageOptions = { options.GridSize, options.NumRepeats ? options.NumRepeats : 25, options.Seed };
+
+		return runStages(meshFiles, stageOptions, jsonFile, tempDir);
+	}
+
+	if (meshFiles.empty()) meshFiles.push_back("Media/bunny.obj");
+	if (sparse) return runSparseCheck(meshFiles);
+
+	const auto &meshFile = meshFiles.front();
+	options.NumRepeats = options.NumRepeats ? options.NumRepeats : 5;
+
+	ObjLoader mesh;
+	if (!mesh.Import(meshFile.c_str()))
+	{
+		cerr << "Failed to load " << meshFile << endl;
+
+		return 1;
+	}
+
+	LayoutBenchmark benchmark(options);
+
+	return benchmark.Run(mesh) ? 0 : 1;
+}
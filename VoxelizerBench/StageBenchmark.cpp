@@ -0,0 +1,670 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "StageBenchmark.h"
+#include "SparseVoxelOctree.h"
+#include "MeshOptimizer.h"
+#include "VertexQuantizer.h"
+#include "DistanceField.h"
+#include "TriangleBVH.h"
+
+#define SPHERE_SLICES	512
+#define SPHERE_STACKS	256
+#define TORUS_SLICES	384
+#define TORUS_SIDES		128
+#define SOUP_TRIANGLES	(1 << 17)
+#define SOUP_TRI_SIZE	0.05f
+#define SDF_BAND_WIDTH	4.0f	// Voxels refined by exact distances
+#define SDF_SIGN_TOLERANCE	0.05f	// Voxels this close to the analytic sphere may take either sign
+#define HOLE_INTERVAL	20		// Every 20th triangle is dropped from the holed copy
+
+using namespace std;
+using namespace std::chrono;
+
+static const char *g_methodNames[] = { "TRI_PROJ", "TRI_PROJ_TESS", "TRI_PROJ_UNION", "TRI_SAT" };
+static const char *g_isaNames[] = { "SSE", "AVX2" };
+
+//--------------------------------------------------------------------------------------
+// Exposes the post-import passes of ObjLoader so that they can be timed on their own
+//--------------------------------------------------------------------------------------
+class MeshProbe : public ObjLoader
+{
+public:
+	MeshProbe(TaskScheduler &scheduler) : ObjLoader(scheduler) {}
+
+	void ComputeNormal() { computeNormal(); }
+	void ComputeBound() { computeBound(); }
+};
+
+static void writeVertex(ostream &file, float x, float y, float z)
+{
+	file << "v " << x << ' ' << y << ' ' << z << '\n';
+}
+
+static void writeTriangle(ostream &file, uint32_t i0, uint32_t i1, uint32_t i2)
+{
+	file << "f " << i0 + 1 << ' ' << i1 + 1 << ' ' << i2 + 1 << '\n';
+}
+
+// UV sphere: closed and convex, the friendly case for every stage
+static bool writeSphere(const string &fileName, uint32_t slices, uint32_t stacks)
+{
+	ofstream file(fileName, ios::trunc);
+	if (!file) return false;
+	file << setprecision(7);
+
+	const auto pi = 3.14159265f;
+	writeVertex(file, 0.0f, 1.0f, 0.0f);
+	for (auto j = 1u; j < stacks; ++j)
+	{
+		const auto phi = pi * j / stacks;
+		for (auto i = 0u; i < slices; ++i)
+		{
+			const auto theta = 2.0f * pi * i / slices;
+			writeVertex(file, sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta));
+		}
+	}
+	writeVertex(file, 0.0f, -1.0f, 0.0f);
+
+	const auto ring = [slices](uint32_t j, uint32_t i) { return 1 + (j - 1) * slices + i % slices; };
+	const auto bottom = 1 + (stacks - 1) * slices;
+	for (auto i = 0u; i < slices; ++i)
+	{
+		writeTriangle(file, 0, ring(1, i + 1), ring(1, i));
+		for (auto j = 1u; j + 1 < stacks; ++j)
+		{
+			writeTriangle(file, ring(j, i), ring(j, i + 1), ring(j + 1, i));
+			writeTriangle(file, ring(j, i + 1), ring(j + 1, i + 1), ring(j + 1, i));
+		}
+		writeTriangle(file, ring(stacks - 1, i), ring(stacks - 1, i + 1), bottom);
+	}
+
+	return file.good();
+}
+
+// Torus: closed with a hole, so the solid fill sees two surface runs per column
+static bool writeTorus(const string &fileName, uint32_t slices, uint32_t sides)
+{
+	ofstream file(fileName, ios::trunc);
+	if (!file) return false;
+	file << setprecision(7);
+
+	const auto pi = 3.14159265f;
+	const auto majorRadius = 1.0f, minorRadius = 0.35f;
+	for (auto i = 0u; i < slices; ++i)
+	{
+		const auto theta = 2.0f * pi * i / slices;
+		for (auto j = 0u; j < sides; ++j)
+		{
+			const auto phi = 2.0f * pi * j / sides;
+			const auto r = majorRadius + minorRadius * cosf(phi);
+			writeVertex(file, r * cosf(theta), minorRadius * sinf(phi), r * sinf(theta));
+		}
+	}
+
+	const auto index = [slices, sides](uint32_t i, uint32_t j) { return (i % slices) * sides + j % sides; };
+	for (auto i = 0u; i < slices; ++i)
+	{
+		for (auto j = 0u; j < sides; ++j)
+		{
+			writeTriangle(file, index(i, j), index(i, j + 1), index(i + 1, j));
+			writeTriangle(file, index(i, j + 1), index(i + 1, j + 1), index(i + 1, j));
+		}
+	}
+
+	return file.good();
+}
+
+// Triangle soup: unshared vertices scattered in random order, the worst case for locality
+static bool writeSoup(const string &fileName, uint32_t numTri, uint32_t seed)
+{
+	ofstream file(fileName, ios::trunc);
+	if (!file) return false;
+	file << setprecision(7);
+
+	mt19937 rng(seed);
+	uniform_real_distribution<float> position(-1.0f, 1.0f);
+	uniform_real_distribution<float> offset(-SOUP_TRI_SIZE, SOUP_TRI_SIZE);
+	for (auto i = 0u; i < numTri; ++i)
+	{
+		const auto x = position(rng), y = position(rng), z = position(rng);
+		for (auto j = 0u; j < 3; ++j) writeVertex(file, x + offset(rng), y + offset(rng), z + offset(rng));
+	}
+
+	for (auto i = 0u; i < numTri; ++i) writeTriangle(file, i * 3, i * 3 + 1, i * 3 + 2);
+
+	return file.good();
+}
+
+template<typename T>
+static uint64_t hashArray(const T *pData, size_t count)
+{
+	// FNV-1a over the bytes
+	const auto pBytes = reinterpret_cast<const uint8_t*>(pData);
+	auto hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < count * sizeof(T); ++i) hash = (hash ^ pBytes[i]) * 0x100000001b3ull;
+
+	return hash;
+}
+
+static uint64_t countVoxels(const vector<uint32_t> &grid)
+{
+	return grid.size() - count(grid.cbegin(), grid.cend(), 0u);
+}
+
+static uint64_t countMismatches(const vector<uint32_t> &grid, const vector<uint32_t> &reference)
+{
+	uint64_t numMismatches = 0;
+	for (size_t i = 0; i < grid.size(); ++i) numMismatches += (grid[i] != 0) != (reference[i] != 0) ? 1 : 0;
+
+	return numMismatches;
+}
+
+// Counts the voxels signed against the sphere of the voxel-space mesh, by dominant axis from its center
+static void countSphereSignErrors(const DistanceField &distanceField, const VoxelizerCPU &voxelizer, uint64_t errors[3])
+{
+	// Every vertex of the tessellated sphere is on it
+	double center[3] = {};
+	ObjLoader::float3 v[3];
+	const auto numTri = voxelizer.GetNumTriangles();
+	for (auto i = 0u; i < numTri; ++i)
+	{
+		voxelizer.GetTriangle(i, v);
+		for (const auto &vert : v)
+		{
+			center[0] += vert.x;
+			center[1] += vert.y;
+			center[2] += vert.z;
+		}
+	}
+	for (auto &c : center) c /= numTri * 3.0;
+	voxelizer.GetTriangle(0, v);
+	const auto radius = sqrt((v[0].x - center[0]) * (v[0].x - center[0]) +
+		(v[0].y - center[1]) * (v[0].y - center[1]) + (v[0].z - center[2]) * (v[0].z - center[2]));
+
+	errors[0] = errors[1] = errors[2] = 0;
+	const auto gridSize = distanceField.GetGridSize();
+	for (auto z = 0u; z < gridSize; ++z)
+		for (auto y = 0u; y < gridSize; ++y)
+			for (auto x = 0u; x < gridSize; ++x)
+			{
+				const double d[] = { x + 0.5 - center[0], y + 0.5 - center[1], z + 0.5 - center[2] };
+				const auto dist = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) - radius;
+				if (abs(dist) <= SDF_SIGN_TOLERANCE) continue;
+				if ((dist < 0.0) == (distanceField.GetDistance(x, y, z) < 0.0f)) continue;
+
+				const auto axis = abs(d[0]) >= abs(d[1]) ? (abs(d[0]) >= abs(d[2]) ? 0 : 2) : (abs(d[1]) >= abs(d[2]) ? 1 : 2);
+				++errors[axis];
+			}
+}
+
+static string escapeJson(const string &str)
+{
+	string escaped;
+	for (const auto &c : str)
+	{
+		if (c == '"' || c == '\\') escaped += '\\';
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+StageBenchmark::StageBenchmark(const Options &options, TaskScheduler &scheduler) :
+	m_options(options),
+	m_scheduler(scheduler)
+{
+	m_options.NumRepeats = (max)(m_options.NumRepeats, 1u);
+}
+
+StageBenchmark::~StageBenchmark()
+{
+	for (const auto &mesh : m_meshes)
+		if (mesh.Temporary) remove(mesh.FileName.c_str());
+}
+
+bool StageBenchmark::AddSyntheticMeshes(const string &tempDir)
+{
+	const auto prefix = tempDir.empty() ? string() : tempDir + "/";
+
+	const Mesh sphere = { "sphere", prefix + "StageBenchSphere.obj", true };
+	const Mesh torus = { "torus", prefix + "StageBenchTorus.obj", true };
+	const Mesh soup = { "soup", prefix + "StageBenchSoup.obj", true };
+	if (!writeSphere(sphere.FileName, SPHERE_SLICES, SPHERE_STACKS)) return false;
+	m_meshes.push_back(sphere);
+	if (!writeTorus(torus.FileName, TORUS_SLICES, TORUS_SIDES)) return false;
+	m_meshes.push_back(torus);
+	if (!writeSoup(soup.FileName, SOUP_TRIANGLES, m_options.Seed)) return false;
+	m_meshes.push_back(soup);
+
+	return true;
+}
+
+void StageBenchmark::AddMesh(const string &name, const string &fileName)
+{
+	m_meshes.push_back({ name, fileName, false });
+}
+
+bool StageBenchmark::Run(ostream &out, ostream &log)
+{
+	log << fixed << setprecision(3) << "Grid " << m_options.GridSize << "^3, " << m_options.NumRepeats
+		<< " repeats, seed " << m_options.Seed << ", " << m_scheduler.GetNumWorkers() << " workers" << endl;
+
+	vector<Result> results;
+	auto succeeded = true;
+	for (const auto &mesh : m_meshes)
+	{
+		Result result;
+		if (runMesh(mesh, result, log)) results.push_back(result);
+		else succeeded = false;
+	}
+
+	writeJson(out, m_options, m_scheduler.GetNumWorkers(), results);
+
+	return succeeded;
+}
+
+bool StageBenchmark::runMesh(const Mesh &mesh, Result &result, ostream &log)
+{
+	// Parse only; the cache would skip the work being measured
+	MeshProbe loader(m_scheduler);
+	if (!loader.Import(mesh.FileName.c_str(), false, false, false))
+	{
+		log << mesh.Name << ": failed to load " << mesh.FileName << endl;
+
+		return false;
+	}
+
+	result.Name = mesh.Name;
+	result.NumVertices = loader.GetNumVertices();
+	result.NumTriangles = loader.GetNumIndices() / 3;
+	log << mesh.Name << ": " << result.NumVertices << " vertices, " << result.NumTriangles << " triangles" << endl;
+
+	const auto noSetup = []() {};
+
+	auto stage = measure("import", [&]() { loader.Import(mesh.FileName.c_str(), false, false, false); }, noSetup);
+	stage.Checksum = hashArray(loader.GetIndices(), loader.GetNumIndices());
+	result.Stages.push_back(stage);
+
+	stage = measure("computeNormal", [&]() { loader.ComputeNormal(); }, noSetup);
+	stage.Checksum = hashArray(loader.GetVertices(), static_cast<size_t>(loader.GetNumVertices()) * loader.GetVertexStride());
+	result.Stages.push_back(stage);
+
+	stage = measure("computeBound", [&]() { loader.ComputeBound(); }, noSetup);
+	const float bound[] = { loader.GetCenter().x, loader.GetCenter().y, loader.GetCenter().z, loader.GetRadius() };
+	stage.Checksum = hashArray(bound, 4);
+	result.Stages.push_back(stage);
+
+	// Mesh optimization passes, each on a fresh copy of the previous pass output
+	const auto pVertices = reinterpret_cast<const ObjLoader::Vertex*>(loader.GetVertices());
+	const ObjLoader::vVertex vertices(pVertices, pVertices + loader.GetNumVertices());
+	const ObjLoader::vuint indices(loader.GetIndices(), loader.GetIndices() + loader.GetNumIndices());
+	const auto computeAcmr = [](const ObjLoader::vuint &indices, size_t numVertices)
+	{
+		return MeshOptimizer::ComputeACMR(indices.data(), static_cast<uint32_t>(indices.size()),
+			static_cast<uint32_t>(numVertices));
+	};
+	result.Acmr = computeAcmr(indices, vertices.size());
+
+	auto optVertices = vertices;
+	auto optIndices = indices;
+	stage = measure("weld", [&]() { MeshOptimizer::Weld(optVertices, optIndices); },
+		[&]() { optVertices = vertices; optIndices = indices; });
+	stage.Checksum = hashArray(optIndices.data(), optIndices.size());
+	stage.Acmr = computeAcmr(optIndices, optVertices.size());
+	result.Stages.push_back(stage);
+
+	const auto weldedVertices = optVertices;
+	const auto weldedIndices = optIndices;
+	const auto numWelded = static_cast<uint32_t>(weldedVertices.size());
+	stage = measure("reorder triangles", [&]() { MeshOptimizer::ReorderTriangles(optIndices, numWelded); },
+		[&]() { optIndices = weldedIndices; });
+	stage.Checksum = hashArray(optIndices.data(), optIndices.size());
+	stage.Acmr = computeAcmr(optIndices, numWelded);
+	result.Stages.push_back(stage);
+
+	const auto reorderedIndices = optIndices;
+	stage = measure("reorder vertices", [&]() { MeshOptimizer::ReorderVertices(optVertices, optIndices); },
+		[&]() { optVertices = weldedVertices; optIndices = reorderedIndices; });
+	stage.Checksum = hashArray(optIndices.data(), optIndices.size());
+	stage.Acmr = computeAcmr(optIndices, optVertices.size());
+	result.Stages.push_back(stage);
+
+	// Quantized inside the bound, as ObjLoader::Quantize() does
+	ObjLoader::vQuantizedVertex quantized(loader.GetNumVertices());
+	stage = measure("quantize", [&]()
+	{
+		VertexQuantizer::Quantize(loader.GetVertices(), loader.GetNumVertices(), loader.GetVertexStride(),
+			loader.GetCenter(), loader.GetExtent(), quantized.data(), m_scheduler);
+	}, noSetup);
+	stage.Checksum = hashArray(quantized.data(), quantized.size());
+	result.Stages.push_back(stage);
+
+	const auto error = VertexQuantizer::MeasureError(loader.GetVertices(), loader.GetNumVertices(),
+		loader.GetVertexStride(), quantized.data(), loader.GetCenter(), loader.GetExtent(), m_scheduler);
+	result.Quantization.MaxPositionError = error.Position / loader.GetRadius() * m_options.GridSize * 0.5f;
+	result.Quantization.MaxNormalError = error.Normal;
+
+	VoxelizerCPU voxelizer(m_options.GridSize, m_scheduler);
+	voxelizer.SetMesh(loader.GetNumVertices(), loader.GetVertexStride(), loader.GetVertices(),
+		loader.GetNumIndices(), loader.GetIndices(), loader.GetCenter(), loader.GetRadius());
+	vector<uint32_t> reference;
+	for (uint8_t i = 0; i < VoxelizerCPU::NUM_METHOD; ++i)
+	{
+		const auto method = static_cast<VoxelizerCPU::Method>(i);
+		stage = measure((string("voxelize ") + g_methodNames[i]).c_str(), [&]() { voxelizer.Voxelize(method); }, noSetup);
+		stage.Checksum = countVoxels(voxelizer.GetGrid());
+		result.Stages.push_back(stage);
+		if (method == VoxelizerCPU::TRI_PROJ) reference = voxelizer.GetGrid();
+		else if (method == VoxelizerCPU::TRI_SAT)
+		{
+			const auto &grid = voxelizer.GetGrid();
+			auto &conservative = result.Conservative;
+			conservative.SatVoxels = stage.Checksum;
+			conservative.TriProjVoxels = countVoxels(reference);
+			conservative.TriProjOnlyVoxels = 0;
+			for (size_t j = 0; j < grid.size(); ++j)
+				conservative.TriProjOnlyVoxels += reference[j] && !grid[j] ? 1 : 0;
+			conservative.OverMarking = conservative.TriProjVoxels ?
+				static_cast<float>(conservative.TriProjOnlyVoxels) / conservative.TriProjVoxels : 0.0f;
+		}
+	}
+
+	// The overlap kernel alone, on the same voxel-space triangles as TRI_SAT
+	{
+		const auto scale = 0.5f * m_options.GridSize / loader.GetRadius();
+		const auto &center = loader.GetCenter();
+		const auto stride = loader.GetVertexStride();
+		vector<ObjLoader::float3> triangles(loader.GetNumIndices());
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			const auto &pos = reinterpret_cast<const ObjLoader::Vertex*>(loader.GetVertices() +
+				static_cast<size_t>(loader.GetIndices()[i]) * stride)->m_vPosition;
+			triangles[i] = ObjLoader::float3((pos.x - center.x) * scale + 0.5f * m_options.GridSize,
+				(center.y - pos.y) * scale + 0.5f * m_options.GridSize, (pos.z - center.z) * scale + 0.5f * m_options.GridSize);
+		}
+
+		const uint32_t boxMin[] = { 0, 0, 0 };
+		const uint32_t boxMax[] = { m_options.GridSize - 1, m_options.GridSize - 1, m_options.GridSize - 1 };
+		const auto numWorkers = m_scheduler.GetNumWorkers();
+		vector<vector<uint32_t>> voxels(numWorkers);
+		vector<uint64_t> numTested(numWorkers), numOverlapped(numWorkers);
+		for (uint8_t i = 0; i < SatKernel::NUM_ISA; ++i)
+		{
+			const auto isa = static_cast<SatKernel::Isa>(i);
+			result.Conservative.KernelRates[i] = 0.0;
+			if (isa > SatKernel::GetIsa()) continue;
+
+			fill(numTested.begin(), numTested.end(), 0ull);
+			fill(numOverlapped.begin(), numOverlapped.end(), 0ull);
+			stage = measure((string("SAT kernel ") + g_isaNames[i]).c_str(), [&]()
+			{
+				m_scheduler.ParallelFor(0, result.NumTriangles, 64, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+				{
+					auto &workerVoxels = voxels[workerIdx];
+					for (auto t = begin; t < end; ++t)
+					{
+						workerVoxels.clear();
+						numTested[workerIdx] += SatKernel::Overlap(&triangles[t * 3], boxMin, boxMax, workerVoxels, isa);
+						numOverlapped[workerIdx] += workerVoxels.size() / 3;
+					}
+				});
+			}, noSetup);
+
+			// Counted over the warm-up and every repeat
+			uint64_t tested = 0;
+			stage.Checksum = 0;
+			for (auto j = 0u; j < numWorkers; ++j)
+			{
+				tested += numTested[j];
+				stage.Checksum += numOverlapped[j];
+			}
+			stage.Checksum /= m_options.NumRepeats + 1;
+			tested /= m_options.NumRepeats + 1;
+			result.Conservative.KernelRates[i] = stage.P50 > 0.0 ? tested / (stage.P50 * 1000.0) : 0.0;
+			result.Stages.push_back(stage);
+		}
+	}
+
+	// Same voxelization straight from the quantized stream
+	{
+		const auto radius = loader.GetRadius();
+		VoxelizerCPU quantVoxelizer(m_options.GridSize, m_scheduler);
+		quantVoxelizer.SetMesh(loader.GetNumVertices(), quantized.data(), loader.GetNumIndices(), loader.GetIndices(),
+			loader.GetCenter(), loader.GetExtent(), loader.GetCenter(), ObjLoader::float3(radius, radius, radius));
+		stage = measure("voxelize TRI_PROJ quantized", [&]() { quantVoxelizer.Voxelize(VoxelizerCPU::TRI_PROJ); }, noSetup);
+
+		const auto &grid = quantVoxelizer.GetGrid();
+		stage.Checksum = countVoxels(grid);
+		result.Stages.push_back(stage);
+
+		result.Quantization.VoxelMismatches = 0;
+		for (size_t i = 0; i < grid.size(); ++i)
+			result.Quantization.VoxelMismatches += (grid[i] != 0) != (reference[i] != 0) ? 1 : 0;
+	}
+
+	// Scene of 2x2x2 instances of the mesh, each with its own material
+	{
+		VoxelizerCPU sceneVoxelizer(m_options.GridSize, m_scheduler);
+		const auto mesh = sceneVoxelizer.AddMesh(loader.GetNumVertices(), loader.GetVertexStride(), loader.GetVertices(),
+			loader.GetNumIndices(), loader.GetIndices());
+		const auto spacing = loader.GetRadius() * 2.0f;
+		for (auto i = 0u; i < 8; ++i)
+		{
+			const VoxelizerCPU::Instance instance =
+			{
+				mesh, static_cast<uint16_t>(i + 1),
+				{
+					{ 1.0f, 0.0f, 0.0f, (i & 1) * spacing },
+					{ 0.0f, 1.0f, 0.0f, ((i >> 1) & 1) * spacing },
+					{ 0.0f, 0.0f, 1.0f, (i >> 2) * spacing }
+				}
+			};
+			sceneVoxelizer.AddInstance(instance);
+		}
+		sceneVoxelizer.SetScene();
+		stage = measure("voxelize TRI_PROJ scene 8 instances", [&]() { sceneVoxelizer.Voxelize(VoxelizerCPU::TRI_PROJ); }, noSetup);
+		stage.Checksum = countVoxels(sceneVoxelizer.GetGrid());
+		result.Stages.push_back(stage);
+	}
+
+	// Re-voxelizes the bins of the first 1% of the triangles, as after a small edit in place
+	voxelizer.Voxelize(VoxelizerCPU::TRI_PROJ);
+	stage = measure("voxelize TRI_PROJ dirty 1%", [&]() { voxelizer.VoxelizeDirty(VoxelizerCPU::TRI_PROJ); },
+		[&]() { voxelizer.MarkDirty(0, (max)(result.NumTriangles / 100, 1u)); });
+	stage.Checksum = countVoxels(voxelizer.GetGrid());
+	result.Stages.push_back(stage);
+
+	// Averaged normals instead of the max; same occupancy, so the checksum matches TRI_PROJ
+	voxelizer.SetResolve(VoxelizerCPU::RESOLVE_AVERAGE);
+	stage = measure("voxelize TRI_PROJ average", [&]() { voxelizer.Voxelize(VoxelizerCPU::TRI_PROJ); }, noSetup);
+	stage.Checksum = countVoxels(voxelizer.GetGrid());
+	result.Stages.push_back(stage);
+	voxelizer.SetResolve(VoxelizerCPU::RESOLVE_MAX);
+
+	stage = measure("solid fill", [&]() { voxelizer.FillSolid(); }, [&]() { voxelizer.Voxelize(VoxelizerCPU::TRI_PROJ); });
+	stage.Checksum = countVoxels(voxelizer.GetGrid());
+	result.Stages.push_back(stage);
+
+	// Same interior by winding numbers, including the tree build, then both fills with holes punched
+	{
+		const auto &kBufferGrid = voxelizer.GetGrid();
+		VoxelizerCPU windingVoxelizer(m_options.GridSize, m_scheduler);
+		windingVoxelizer.SetMesh(loader.GetNumVertices(), loader.GetVertexStride(), loader.GetVertices(),
+			loader.GetNumIndices(), loader.GetIndices(), loader.GetCenter(), loader.GetRadius());
+		stage = measure("winding number fill", [&]() { windingVoxelizer.FillSolidWinding(); },
+			[&]() { windingVoxelizer.Voxelize(VoxelizerCPU::TRI_PROJ); });
+		stage.Checksum = countVoxels(windingVoxelizer.GetGrid());
+		result.Stages.push_back(stage);
+
+		auto &solid = result.Solid;
+		const auto windingGrid = windingVoxelizer.GetGrid();
+		solid.Disagreements = countMismatches(windingGrid, kBufferGrid);
+
+		ObjLoader::vuint holedIndices;
+		holedIndices.reserve(loader.GetNumIndices());
+		for (auto i = 0u; i < result.NumTriangles; ++i)
+			if ((i + 1) % HOLE_INTERVAL)
+				holedIndices.insert(holedIndices.end(), loader.GetIndices() + i * 3, loader.GetIndices() + i * 3 + 3);
+		windingVoxelizer.SetMesh(loader.GetNumVertices(), loader.GetVertexStride(), loader.GetVertices(),
+			static_cast<uint32_t>(holedIndices.size()), holedIndices.data(), loader.GetCenter(), loader.GetRadius());
+
+		windingVoxelizer.Voxelize(VoxelizerCPU::TRI_PROJ);
+		windingVoxelizer.FillSolid();
+		solid.KBufferHoleChanges = countMismatches(windingVoxelizer.GetGrid(), kBufferGrid);
+		windingVoxelizer.Voxelize(VoxelizerCPU::TRI_PROJ);
+		windingVoxelizer.FillSolidWinding();
+		solid.WindingHoleChanges = countMismatches(windingVoxelizer.GetGrid(), windingGrid);
+	}
+
+	// Signed by the filled grid; the checksum counts the interior voxels
+	DistanceField distanceField(m_scheduler);
+	stage = measure("distance field", [&]() { distanceField.Build(voxelizer.GetGrid().data(), voxelizer.GetGridSize()); }, noSetup);
+	stage.Checksum = count_if(distanceField.GetDistances().cbegin(), distanceField.GetDistances().cend(),
+		[](uint16_t d) { return (d & 0x8000) != 0; });
+	result.Stages.push_back(stage);
+
+	auto &sphereSigns = result.SphereSigns;
+	sphereSigns.Tested = mesh.Temporary && mesh.Name == "sphere";
+	if (sphereSigns.Tested) countSphereSignErrors(distanceField, voxelizer, sphereSigns.Build);
+
+	TriangleBVH bvh(m_scheduler);
+	stage = measure("BVH build", [&]()
+	{
+		bvh.Build(voxelizer.GetNumTriangles(), [&](uint32_t primId, ObjLoader::float3 v[3]) { voxelizer.GetTriangle(primId, v); });
+	}, noSetup);
+	stage.Checksum = bvh.GetNumNodes();
+	result.Stages.push_back(stage);
+
+	uint64_t numRefined = 0;
+	stage = measure("distance field exact band", [&]() { numRefined = distanceField.Refine(voxelizer.GetGrid().data(), bvh, SDF_BAND_WIDTH); },
+		[&]() { distanceField.Build(voxelizer.GetGrid().data(), voxelizer.GetGridSize()); });
+	stage.Checksum = numRefined;
+	result.Stages.push_back(stage);
+	if (sphereSigns.Tested) countSphereSignErrors(distanceField, voxelizer, sphereSigns.Refine);
+
+	// On the filled grid, as the renderer would consume it
+	SparseVoxelOctree octree(m_scheduler);
+	stage = measure("octree build", [&]() { octree.Build(voxelizer.GetGrid(), m_options.GridSize); }, noSetup);
+	stage.Checksum = octree.GetNumNodes();
+	result.Stages.push_back(stage);
+
+	const auto &conservative = result.Conservative;
+	log << "  conservative: " << conservative.SatVoxels << " SAT voxels, " << conservative.TriProjVoxels
+		<< " TRI_PROJ voxels, " << conservative.TriProjOnlyVoxels << " over-marked (" << conservative.OverMarking * 100.0f
+		<< "%), kernel";
+	for (auto i = 0u; i < SatKernel::NUM_ISA; ++i) log << ' ' << g_isaNames[i] << ' ' << conservative.KernelRates[i];
+	log << " Mvoxels/s" << endl;
+	log << "  quantization: max position error " << result.Quantization.MaxPositionError << " voxels, max normal error "
+		<< result.Quantization.MaxNormalError << " degrees, " << result.Quantization.VoxelMismatches << " voxel mismatches" << endl;
+	log << "  solid: " << result.Solid.Disagreements << " voxels differ between K-buffer and winding number fills, "
+		<< result.Solid.KBufferHoleChanges << " and " << result.Solid.WindingHoleChanges << " changed by holes" << endl;
+	if (sphereSigns.Tested)
+	{
+		log << "  sphere signs: build";
+		for (const auto &e : sphereSigns.Build) log << ' ' << e;
+		log << ", exact band";
+		for (const auto &e : sphereSigns.Refine) log << ' ' << e;
+		log << " wrong voxels along x y z" << endl;
+	}
+	for (const auto &s : result.Stages)
+	{
+		log << "  " << s.Name << ": p50 " << s.P50 << " ms, p99 " << s.P99 << " ms";
+		if (s.Acmr >= 0.0f) log << ", ACMR " << s.Acmr;
+		log << endl;
+	}
+
+	return true;
+}
+
+template<typename Func, typename SetupFunc>
+StageBenchmark::Stage StageBenchmark::measure(const char *name, const Func &func, const SetupFunc &setupFunc) const
+{
+	setupFunc();
+	func();
+
+	vector<double> times(m_options.NumRepeats);
+	for (auto &time : times)
+	{
+		setupFunc();
+		const auto start = steady_clock::now();
+		func();
+		time = duration<double, milli>(steady_clock::now() - start).count();
+	}
+
+	// Nearest-rank percentiles
+	sort(times.begin(), times.end());
+	const auto percentile = [&times](double p)
+	{
+		const auto rank = static_cast<size_t>(ceil(p * times.size()));
+		return times[(max)(rank, static_cast<size_t>(1)) - 1];
+	};
+
+	Stage stage;
+	stage.Name = name;
+	stage.P50 = percentile(0.5);
+	stage.P99 = percentile(0.99);
+	stage.Min = times.front();
+	stage.Max = times.back();
+	stage.Checksum = 0;
+	stage.Acmr = -1.0f;
+
+	return stage;
+}
+
+void StageBenchmark::writeJson(ostream &out, const Options &options, uint32_t numWorkers, const vector<Result> &results)
+{
+	out << fixed << setprecision(4) << "{" << endl;
+	out << "  \"gridSize\": " << options.GridSize << "," << endl;
+	out << "  \"repeats\": " << options.NumRepeats << "," << endl;
+	out << "  \"seed\": " << options.Seed << "," << endl;
+	out << "  \"workers\": " << numWorkers << "," << endl;
+	out << "  \"unit\": \"ms\"," << endl;
+	out << "  \"meshes\": [" << endl;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto &result = results[i];
+		out << "    {" << endl;
+		out << "      \"name\": \"" << escapeJson(result.Name) << "\"," << endl;
+		out << "      \"vertices\": " << result.NumVertices << "," << endl;
+		out << "      \"triangles\": " << result.NumTriangles << "," << endl;
+		out << "      \"acmr\": " << result.Acmr << "," << endl;
+		out << "      \"quantization\": { \"bytesPerVertex\": " << sizeof(ObjLoader::QuantizedVertex)
+			<< ", \"maxPositionErrorVoxels\": " << setprecision(6) << result.Quantization.MaxPositionError
+			<< ", \"maxNormalErrorDegrees\": " << result.Quantization.MaxNormalError << setprecision(4)
+			<< ", \"voxelMismatches\": " << result.Quantization.VoxelMismatches << " }," << endl;
+		out << "      \"conservative\": { \"satVoxels\": " << result.Conservative.SatVoxels
+			<< ", \"triProjVoxels\": " << result.Conservative.TriProjVoxels
+			<< ", \"triProjOnlyVoxels\": " << result.Conservative.TriProjOnlyVoxels
+			<< ", \"overMarking\": " << result.Conservative.OverMarking;
+		for (auto j = 0u; j < SatKernel::NUM_ISA; ++j)
+			out << ", \"kernel" << g_isaNames[j] << "MvoxelsPerSec\": " << result.Conservative.KernelRates[j];
+		out << " }," << endl;
+		out << "      \"solid\": { \"holeInterval\": " << HOLE_INTERVAL
+			<< ", \"disagreements\": " << result.Solid.Disagreements
+			<< ", \"kBufferHoleChanges\": " << result.Solid.KBufferHoleChanges
+			<< ", \"windingHoleChanges\": " << result.Solid.WindingHoleChanges << " }," << endl;
+		if (result.SphereSigns.Tested)
+		{
+			const auto &signs = result.SphereSigns;
+			out << "      \"sphereSignErrors\": { \"tolerance\": " << SDF_SIGN_TOLERANCE
+				<< ", \"build\": [" << signs.Build[0] << ", " << signs.Build[1] << ", " << signs.Build[2]
+				<< "], \"exactBand\": [" << signs.Refine[0] << ", " << signs.Refine[1] << ", " << signs.Refine[2] << "] }," << endl;
+		}
+		out << "      \"stages\": [" << endl;
+		for (size_t j = 0; j < result.Stages.size(); ++j)
+		{
+			const auto &stage = result.Stages[j];
+			out << "        { \"name\": \"" << escapeJson(stage.Name) << "\", \"p50\": " << stage.P50
+				<< ", \"p99\": " << stage.P99 << ", \"min\": " << stage.Min << ", \"max\": " << stage.Max
+				<< ", \"checksum\": " << stage.Checksum;
+			if (stage.Acmr >= 0.0f) out << ", \"acmr\": " << stage.Acmr;
+			out << " }" << (j + 1 < result.Stages.size() ? "," : "") << endl;
+		}
+		out << "      ]" << endl;
+		out << "    }" << (i + 1 < results.size() ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelizerCPU.h"
+#include "SatKernel.h"
+
+//--------------------------------------------------------------------------------------
+// Times each stage of the CPU pipeline separately, from OBJ import to octree build, on
+// a fixed set of synthetic and bundled meshes, and reports the percentiles as JSON
+//--------------------------------------------------------------------------------------
+class StageBenchmark
+{
+public:
+	struct Options
+	{
+		uint32_t	GridSize;
+		uint32_t	NumRepeats;
+		uint32_t	Seed;
+	};
+
+	StageBenchmark(const Options &options, TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~StageBenchmark();
+
+	// Synthetic meshes are written as OBJ files to tempDir so that import is measured too
+	bool AddSyntheticMeshes(const std::string &tempDir);
+	void AddMesh(const std::string &name, const std::string &fileName);
+
+	// Progress goes to the log stream, the JSON report to out
+	bool Run(std::ostream &out, std::ostream &log);
+
+protected:
+	struct Mesh
+	{
+		std::string	Name;
+		std::string	FileName;
+		bool		Temporary;
+	};
+
+	struct Stage
+	{
+		std::string	Name;
+		double		P50;
+		double		P99;
+		double		Min;
+		double		Max;
+		uint64_t	Checksum;	// Stage output summary, for spotting behavior changes along with the timings
+		float		Acmr;		// Vertex cache miss ratio of the output index order; negative if not applicable
+	};
+
+	// Quantized vertex stream against the float path
+	struct QuantizationError
+	{
+		float		MaxPositionError;	// In voxels
+		float		MaxNormalError;		// In degrees
+		uint64_t	VoxelMismatches;	// Voxels whose occupancy differs with TRI_PROJ
+	};
+
+	// Exact SAT overlap against the conservative AABB test of TRI_PROJ. SAT marks every
+	// voxel a triangle touches, TRI_PROJ one depth per projected pixel, so SAT has more.
+	struct ConservativeOverlap
+	{
+		uint64_t	SatVoxels;
+		uint64_t	TriProjVoxels;
+		uint64_t	TriProjOnlyVoxels;	// Marked by TRI_PROJ but overlapped by no triangle
+		float		OverMarking;	// TriProjOnlyVoxels per TRI_PROJ voxel
+		double		KernelRates[SatKernel::NUM_ISA];	// Million candidate voxels tested per second; 0 if unsupported
+	};
+
+	// Winding number fill against the K-buffer fill, on the mesh and on a copy with holes,
+	// where surface crossings no longer pair up along the columns
+	struct SolidComparison
+	{
+		uint64_t	Disagreements;		// Voxels filled by only one of them on the mesh
+		uint64_t	KBufferHoleChanges;	// Voxels whose occupancy the holes change, per fill
+		uint64_t	WindingHoleChanges;
+	};
+
+	// Distance field signs against the analytic sphere, per dominant axis of the voxel from the
+	// center; voxels within SDF_SIGN_TOLERANCE of the sphere are not counted. Sphere mesh only.
+	struct SphereSignErrors
+	{
+		bool		Tested;
+		uint64_t	Build[3];	// Disc distances of Build()
+		uint64_t	Refine[3];	// Exact band of Refine()
+	};
+
+	struct Result
+	{
+		std::string			Name;
+		uint32_t			NumVertices;
+		uint32_t			NumTriangles;
+		float				Acmr;	// Of the index order as imported
+		QuantizationError	Quantization;
+		ConservativeOverlap	Conservative;
+		SolidComparison		Solid;
+		SphereSignErrors	SphereSigns;
+		std::vector<Stage>	Stages;
+	};
+
+	bool runMesh(const Mesh &mesh, Result &result, std::ostream &log);
+
+	// Runs setupFunc untimed then func, once for warm-up then NumRepeats times
+	template<typename Func, typename SetupFunc>
+	Stage measure(const char *name, const Func &func, const SetupFunc &setupFunc) const;
+
+	static void writeJson(std::ostream &out, const Options &options, uint32_t numWorkers,
+		const std::vector<Result> &results);
+
+	Options				m_options;
+	TaskScheduler		&m_scheduler;
+	std::vector<Mesh>	m_meshes;
+};
@@ -0,0 +1,551 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "BinaryMeshLoader.h"
+
+#define STL_HEADER_SIZE		80
+#define STL_TRIANGLE_SIZE	50	// Normal, 3 positions and the attribute byte count
+#define WELD_BUCKET_SIZE	2048
+#define CORNER_BLOCK_SIZE	(1 << 18)
+#define PLY_GRAIN_SIZE		(1 << 14)
+
+using namespace std;
+
+enum PlyType : uint8_t
+{
+	PLY_INT8,
+	PLY_UINT8,
+	PLY_INT16,
+	PLY_UINT16,
+	PLY_INT32,
+	PLY_UINT32,
+	PLY_FLOAT32,
+	PLY_FLOAT64,
+
+	PLY_NONE
+};
+
+static const uint32_t PlyTypeSizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+struct PlyProperty
+{
+	string		Name;
+	PlyType		Type;		// Of the items for a list
+	PlyType		CountType;	// PLY_NONE unless a list
+	uint32_t	Offset;		// Inside the element, valid up to the first list
+};
+
+struct PlyElement
+{
+	string				Name;
+	uint64_t			Count;
+	vector<PlyProperty>	Properties;
+	uint32_t			Stride;		// Bytes per element if it has no list
+	bool				HasList;
+};
+
+static PlyType parsePlyType(const string &name)
+{
+	static const char *const names[][2] =
+	{
+		{ "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+		{ "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" }
+	};
+
+	for (auto i = 0u; i < PLY_NONE; ++i)
+		if (name == names[i][0] || name == names[i][1]) return static_cast<PlyType>(i);
+
+	return PLY_NONE;
+}
+
+template<typename T>
+static inline T loadScalar(const uint8_t *p, bool swapBytes)
+{
+	uint8_t bytes[sizeof(T)];
+	if (swapBytes) reverse_copy(p, p + sizeof(T), bytes);
+	else memcpy(bytes, p, sizeof(T));
+
+	T value;
+	memcpy(&value, bytes, sizeof(T));
+
+	return value;
+}
+
+static double loadPlyValue(PlyType type, const uint8_t *p, bool swapBytes)
+{
+	switch (type)
+	{
+	case PLY_INT8:
+		return static_cast<int8_t>(*p);
+	case PLY_UINT8:
+		return *p;
+	case PLY_INT16:
+		return loadScalar<int16_t>(p, swapBytes);
+	case PLY_UINT16:
+		return loadScalar<uint16_t>(p, swapBytes);
+	case PLY_INT32:
+		return loadScalar<int32_t>(p, swapBytes);
+	case PLY_UINT32:
+		return loadScalar<uint32_t>(p, swapBytes);
+	case PLY_FLOAT32:
+		return loadScalar<float>(p, swapBytes);
+	case PLY_FLOAT64:
+		return loadScalar<double>(p, swapBytes);
+	default:
+		return 0.0;
+	}
+}
+
+// Returns the first byte of the body, or null if the header is invalid or ASCII
+static const uint8_t *parsePlyHeader(const uint8_t *pData, size_t size, vector<PlyElement> &elements, bool &swapBytes)
+{
+	const auto pEnd = pData + size;
+	auto p = pData;
+	auto isBinary = false;
+	while (p < pEnd)
+	{
+		const auto pLineEnd = find(p, pEnd, '\n');
+		istringstream line(string(reinterpret_cast<const char*>(p), pLineEnd - p));
+		p = pLineEnd < pEnd ? pLineEnd + 1 : pEnd;
+
+		// Comments and unknown keywords are skipped
+		string keyword;
+		line >> keyword;
+		if (keyword == "format")
+		{
+			string format;
+			line >> format;
+			isBinary = format == "binary_little_endian" || format == "binary_big_endian";
+			swapBytes = format == "binary_big_endian";
+		}
+		else if (keyword == "element")
+		{
+			PlyElement element = { string(), 0, vector<PlyProperty>(), 0, false };
+			line >> element.Name >> element.Count;
+			if (!line) return nullptr;
+			elements.push_back(element);
+		}
+		else if (keyword == "property")
+		{
+			if (elements.empty()) return nullptr;
+
+			auto &element = elements.back();
+			PlyProperty property = { string(), PLY_NONE, PLY_NONE, element.Stride };
+			string type;
+			line >> type;
+			if (type == "list")
+			{
+				string countType, itemType;
+				line >> countType >> itemType;
+				property.CountType = parsePlyType(countType);
+				property.Type = parsePlyType(itemType);
+				if (property.CountType == PLY_NONE) return nullptr;
+				element.HasList = true;
+			}
+			else
+			{
+				property.Type = parsePlyType(type);
+				if (property.Type != PLY_NONE) element.Stride += PlyTypeSizes[property.Type];
+			}
+
+			line >> property.Name;
+			if (!line || property.Type == PLY_NONE) return nullptr;
+			element.Properties.push_back(property);
+		}
+		else if (keyword == "end_header") return isBinary ? p : nullptr;
+	}
+
+	return nullptr;
+}
+
+static const uint8_t *skipPlyProperty(const PlyProperty &property, const uint8_t *p, const uint8_t *pEnd, bool swapBytes)
+{
+	auto bytes = static_cast<uint64_t>(PlyTypeSizes[property.Type]);
+	if (property.CountType != PLY_NONE)
+	{
+		const auto countSize = PlyTypeSizes[property.CountType];
+		if (static_cast<size_t>(pEnd - p) < countSize) return nullptr;
+
+		const auto count = loadPlyValue(property.CountType, p, swapBytes);
+		if (count < 0.0) return nullptr;
+		bytes = countSize + static_cast<uint64_t>(count) * bytes;
+	}
+
+	return static_cast<uint64_t>(pEnd - p) < bytes ? nullptr : p + bytes;
+}
+
+static bool loadPlyVertices(const PlyElement &element, const uint8_t *&p, const uint8_t *pEnd, bool swapBytes,
+	BinaryMeshLoader::vVertex &vertices, bool &hasNormals, TaskScheduler &scheduler)
+{
+	// Fixed-size records only, so that they convert in parallel
+	if (element.HasList || element.Count > UINT32_MAX) return false;
+	if (static_cast<uint64_t>(pEnd - p) < element.Count * element.Stride) return false;
+
+	static const char *const names[] = { "x", "y", "z", "nx", "ny", "nz" };
+	const PlyProperty *pProperties[6] = {};
+	for (const auto &property : element.Properties)
+		for (auto i = 0u; i < 6; ++i)
+			if (property.Name == names[i]) pProperties[i] = &property;
+	if (!pProperties[0] || !pProperties[1] || !pProperties[2]) return false;
+	hasNormals = pProperties[3] && pProperties[4] && pProperties[5];
+
+	const auto numVert = static_cast<uint32_t>(element.Count);
+	const auto pBase = p;
+	vertices.resize(numVert);
+	scheduler.ParallelFor(0, numVert, PLY_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pVert = pBase + static_cast<size_t>(element.Stride) * i;
+			const auto load = [&](uint32_t j)
+			{
+				return static_cast<float>(loadPlyValue(pProperties[j]->Type, pVert + pProperties[j]->Offset, swapBytes));
+			};
+
+			auto &vertex = vertices[i];
+			vertex.m_vPosition = BinaryMeshLoader::float3(load(0), load(1), load(2));
+			vertex.m_vNormal = BinaryMeshLoader::float3(0.0f, 0.0f, 0.0f);
+			if (!hasNormals) continue;
+
+			// File normals are not guaranteed to be unit length
+			const BinaryMeshLoader::float3 n(load(3), load(4), load(5));
+			const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			if (l > 0.0f) vertex.m_vNormal = BinaryMeshLoader::float3(n.x / l, n.y / l, n.z / l);
+		}
+	});
+	p += static_cast<size_t>(element.Count * element.Stride);
+
+	return true;
+}
+
+static bool loadPlyFaces(const PlyElement &element, uint64_t numVert, const uint8_t *&p, const uint8_t *pEnd,
+	bool swapBytes, BinaryMeshLoader::vuint &indices, TaskScheduler &scheduler)
+{
+	const auto it = find_if(element.Properties.cbegin(), element.Properties.cend(), [](const PlyProperty &property)
+	{
+		return property.CountType != PLY_NONE && (property.Name == "vertex_indices" || property.Name == "vertex_index");
+	});
+	if (it == element.Properties.cend()) return false;
+
+	const auto &list = *it;
+	const auto countSize = PlyTypeSizes[list.CountType];
+	const auto indexSize = PlyTypeSizes[list.Type];
+	const auto loadIndex = [&](const uint8_t *pIdx)
+	{
+		const auto index = loadPlyValue(list.Type, pIdx, swapBytes);
+		return index >= 0.0 && index < numVert ? static_cast<uint32_t>(index) : UINT32_MAX;
+	};
+
+	// Fast path: if the index list is the only list and every face is a triangle, all faces
+	// have the same size and convert in parallel
+	auto faceSize = countSize + indexSize * 3;
+	auto isUniform = element.Count <= UINT32_MAX / 3;
+	for (const auto &property : element.Properties)
+	{
+		if (&property == &list) continue;
+		isUniform = isUniform && property.CountType == PLY_NONE;
+		faceSize += PlyTypeSizes[property.Type];
+	}
+
+	if (isUniform && static_cast<uint64_t>(pEnd - p) >= element.Count * faceSize)
+	{
+		const auto numFaces = static_cast<uint32_t>(element.Count);
+		const auto pBase = p + list.Offset;
+		atomic<bool> isTriangles(true);
+		indices.resize(static_cast<size_t>(numFaces) * 3);
+		scheduler.ParallelFor(0, numFaces, PLY_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+		{
+			for (auto i = begin; i < end && isTriangles; ++i)
+			{
+				const auto pFace = pBase + static_cast<size_t>(faceSize) * i;
+				if (loadPlyValue(list.CountType, pFace, swapBytes) != 3.0) isTriangles = false;
+				for (auto j = 0u; j < 3 && isTriangles; ++j)
+				{
+					indices[i * 3 + j] = loadIndex(pFace + countSize + indexSize * j);
+					if (indices[i * 3 + j] == UINT32_MAX) isTriangles = false;
+				}
+			}
+		});
+
+		if (isTriangles)
+		{
+			p += static_cast<size_t>(element.Count * faceSize);
+
+			return true;
+		}
+		indices.clear();
+	}
+
+	// Face by face, fanning the polygons and dropping those with invalid indices
+	BinaryMeshLoader::vuint polygon;
+	for (uint64_t i = 0; i < element.Count; ++i)
+	{
+		for (const auto &property : element.Properties)
+		{
+			const auto pNext = skipPlyProperty(property, p, pEnd, swapBytes);
+			if (!pNext) return false;
+
+			if (&property == &list)
+			{
+				polygon.clear();
+				for (auto pIdx = p + countSize; pIdx < pNext; pIdx += indexSize) polygon.push_back(loadIndex(pIdx));
+				if (find(polygon.cbegin(), polygon.cend(), UINT32_MAX) == polygon.cend())
+				{
+					for (size_t j = 2; j < polygon.size(); ++j)
+					{
+						indices.push_back(polygon[0]);
+						indices.push_back(polygon[j - 1]);
+						indices.push_back(polygon[j]);
+					}
+				}
+			}
+			p = pNext;
+		}
+	}
+
+	return true;
+}
+
+struct WeldCorner
+{
+	uint32_t	Key[3];
+	uint32_t	Corner;
+};
+
+// Mixes all bits into the top ones, which select the weld bucket
+static inline uint32_t hashKey(const uint32_t key[3])
+{
+	auto h = key[0] * 0x9e3779b1u;
+	h = (h ^ key[1]) * 0x85ebca6bu;
+	h ^= h >> 13;
+	h = (h ^ key[2]) * 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+BinaryMeshLoader::Format BinaryMeshLoader::DetectFormat(const uint8_t *pData, size_t size)
+{
+	if (size >= 4 && memcmp(pData, "ply", 3) == 0 && (pData[3] == '\n' || pData[3] == '\r')) return PLY;
+
+	// ASCII STL files start with "solid" too, so the header text proves nothing
+	if (size >= STL_HEADER_SIZE + sizeof(uint32_t))
+	{
+		uint32_t numTri;
+		memcpy(&numTri, pData + STL_HEADER_SIZE, sizeof(uint32_t));
+		if (STL_HEADER_SIZE + sizeof(uint32_t) + static_cast<uint64_t>(numTri) * STL_TRIANGLE_SIZE == size) return STL;
+	}
+
+	return OBJ;
+}
+
+bool BinaryMeshLoader::ImportStl(const uint8_t *pData, size_t size, vVertex &vertices, vuint &indices,
+	TaskScheduler &scheduler)
+{
+	vertices.clear();
+	indices.clear();
+	if (DetectFormat(pData, size) != STL) return false;
+
+	uint32_t numTri;
+	memcpy(&numTri, pData + STL_HEADER_SIZE, sizeof(uint32_t));
+	if (numTri == 0 || numTri > UINT32_MAX / 3) return false;
+
+	// Positions are read in place as bitwise keys, with -0 and +0 the same point
+	const auto numCorners = numTri * 3;
+	const auto pTriangles = pData + STL_HEADER_SIZE + sizeof(uint32_t);
+	const auto loadKey = [pTriangles](uint32_t corner, uint32_t key[3])
+	{
+		memcpy(key, pTriangles + static_cast<size_t>(corner / 3) * STL_TRIANGLE_SIZE + sizeof(float3) * (corner % 3 + 1),
+			sizeof(float3));
+		for (auto i = 0u; i < 3; ++i) key[i] = key[i] == 0x80000000u ? 0 : key[i];
+	};
+
+	vuint hashes(numCorners);
+	scheduler.ParallelFor(0, numCorners, CORNER_BLOCK_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		uint32_t key[3];
+		for (auto i = begin; i < end; ++i)
+		{
+			loadKey(i, key);
+			hashes[i] = hashKey(key);
+		}
+	});
+
+	// Counting sort of the corners into buckets by the top hash bits, stable across the
+	// corner blocks as in ObjLoader::computeNormal()
+	auto bucketBits = 0u;
+	while ((numCorners >> bucketBits) > WELD_BUCKET_SIZE) ++bucketBits;
+	const auto numBuckets = 1u << bucketBits;
+	const auto getBucket = [&](uint32_t corner) { return bucketBits ? hashes[corner] >> (32 - bucketBits) : 0; };
+	const auto numBlocks = (numCorners + CORNER_BLOCK_SIZE - 1) / CORNER_BLOCK_SIZE;
+
+	vuint bucketOffsets(static_cast<size_t>(numBlocks) * numBuckets);
+	scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pCounts = &bucketOffsets[static_cast<size_t>(i) * numBuckets];
+			const auto blockEnd = (min)((i + 1) * CORNER_BLOCK_SIZE, numCorners);
+			for (auto j = i * CORNER_BLOCK_SIZE; j < blockEnd; ++j) ++pCounts[getBucket(j)];
+		}
+	});
+
+	vuint bucketBases(numBuckets + 1);
+	auto sum = 0u;
+	for (auto b = 0u; b < numBuckets; ++b)
+	{
+		bucketBases[b] = sum;
+		for (auto i = 0u; i < numBlocks; ++i)
+		{
+			auto &offset = bucketOffsets[static_cast<size_t>(i) * numBuckets + b];
+			const auto count = offset;
+			offset = sum;
+			sum += count;
+		}
+	}
+	bucketBases[numBuckets] = sum;
+
+	// The keys travel with the corners, so that each bucket is welded from contiguous memory
+	vector<WeldCorner> sorted(numCorners);
+	scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pOffsets = &bucketOffsets[static_cast<size_t>(i) * numBuckets];
+			const auto blockEnd = (min)((i + 1) * CORNER_BLOCK_SIZE, numCorners);
+			for (auto j = i * CORNER_BLOCK_SIZE; j < blockEnd; ++j)
+			{
+				auto &sortedCorner = sorted[pOffsets[getBucket(j)]++];
+				loadKey(j, sortedCorner.Key);
+				sortedCorner.Corner = j;
+			}
+		}
+	});
+	vuint().swap(bucketOffsets);
+	vuint().swap(hashes);
+
+	// Weld each bucket with a small open-addressing table of bucket slots; the corners of a
+	// bucket are in increasing order, so every position is represented by its first corner
+	vuint reps(numCorners);
+	vector<vuint> tables(scheduler.GetNumWorkers());
+	scheduler.ParallelFor(0, numBuckets, 1, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		auto &table = tables[workerIdx];
+		for (auto b = begin; b < end; ++b)
+		{
+			const auto pBucket = &sorted[bucketBases[b]];
+			const auto bucketSize = bucketBases[b + 1] - bucketBases[b];
+			auto tableSize = 1u;
+			while (tableSize < bucketSize * 2) tableSize <<= 1;
+			const auto mask = tableSize - 1;
+			table.assign(tableSize, UINT32_MAX);
+
+			for (auto j = 0u; j < bucketSize; ++j)
+			{
+				const auto &key = pBucket[j].Key;
+				for (auto slot = hashKey(key) & mask;; slot = (slot + 1) & mask)
+				{
+					const auto rep = table[slot];
+					if (rep == UINT32_MAX) table[slot] = j;
+					else if (!equal(key, key + 3, pBucket[rep].Key)) continue;
+					reps[pBucket[j].Corner] = pBucket[rep == UINT32_MAX ? j : rep].Corner;
+					break;
+				}
+			}
+		}
+	});
+	vector<vuint>().swap(tables);
+	vector<WeldCorner>().swap(sorted);
+
+	// Number the representatives in corner order with a scan over the blocks
+	vuint blockBases(numBlocks + 1);
+	scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto blockEnd = (min)((i + 1) * CORNER_BLOCK_SIZE, numCorners);
+			auto count = 0u;
+			for (auto j = i * CORNER_BLOCK_SIZE; j < blockEnd; ++j) count += reps[j] == j ? 1 : 0;
+			blockBases[i] = count;
+		}
+	});
+
+	sum = 0;
+	for (auto i = 0u; i <= numBlocks; ++i)
+	{
+		const auto count = blockBases[i];
+		blockBases[i] = sum;
+		sum += count;
+	}
+
+	vuint vertexIds(numCorners);
+	vertices.resize(blockBases[numBlocks]);
+	scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		uint32_t key[3];
+		float position[3];
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto blockEnd = (min)((i + 1) * CORNER_BLOCK_SIZE, numCorners);
+			auto vertexId = blockBases[i];
+			for (auto j = i * CORNER_BLOCK_SIZE; j < blockEnd; ++j)
+			{
+				if (reps[j] != j) continue;
+
+				loadKey(j, key);
+				memcpy(position, key, sizeof(position));
+				auto &vertex = vertices[vertexId];
+				vertex.m_vPosition = float3(position);
+				vertex.m_vNormal = float3(0.0f, 0.0f, 0.0f);
+				vertexIds[j] = vertexId++;
+			}
+		}
+	});
+
+	indices.resize(numCorners);
+	scheduler.ParallelFor(0, numCorners, CORNER_BLOCK_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i) indices[i] = vertexIds[reps[i]];
+	});
+
+	return true;
+}
+
+bool BinaryMeshLoader::ImportPly(const uint8_t *pData, size_t size, vVertex &vertices, vuint &indices,
+	bool &hasNormals, TaskScheduler &scheduler)
+{
+	vertices.clear();
+	indices.clear();
+	hasNormals = false;
+
+	vector<PlyElement> elements;
+	auto swapBytes = false;
+	auto p = parsePlyHeader(pData, size, elements, swapBytes);
+	if (!p) return false;
+
+	// Faces may be checked against the vertex count from the header, whatever the element order
+	const auto itVert = find_if(elements.cbegin(), elements.cend(), [](const PlyElement &e) { return e.Name == "vertex"; });
+	if (itVert == elements.cend()) return false;
+
+	const auto pEnd = pData + size;
+	for (const auto &element : elements)
+	{
+		if (element.Name == "vertex")
+		{
+			if (!loadPlyVertices(element, p, pEnd, swapBytes, vertices, hasNormals, scheduler)) return false;
+		}
+		else if (element.Name == "face")
+		{
+			if (!loadPlyFaces(element, itVert->Count, p, pEnd, swapBytes, indices, scheduler)) return false;
+		}
+		else
+		{
+			for (uint64_t i = 0; i < element.Count; ++i)
+				for (const auto &property : element.Properties)
+					if (!(p = skipPlyProperty(property, p, pEnd, swapBytes))) return false;
+		}
+	}
+
+	return !vertices.empty();
+}
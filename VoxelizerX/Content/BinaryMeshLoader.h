@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ObjLoader.h"
+
+//--------------------------------------------------------------------------------------
+// Binary STL and PLY import straight from the memory-mapped file into the ObjLoader
+// vertex and index arrays; ObjLoader::Import dispatches here by the file contents
+//--------------------------------------------------------------------------------------
+class BinaryMeshLoader
+{
+public:
+	using float3	= ObjLoader::float3;
+	using vVertex	= ObjLoader::vVertex;
+	using vuint		= ObjLoader::vuint;
+
+	enum Format : uint8_t
+	{
+		OBJ,
+		STL,
+		PLY
+	};
+
+	// Binary STL is told by its exact size, PLY by its magic; anything else is OBJ text.
+	// Only the first HeaderSize bytes are read, so the file prefix will do.
+	static Format DetectFormat(const uint8_t *pData, size_t size);
+
+	// STL triangles share no vertices: corners at bitwise equal positions are merged in
+	// parallel, in order of first use. Facet normals are ignored.
+	static bool ImportStl(const uint8_t *pData, size_t size, vVertex &vertices, vuint &indices,
+		TaskScheduler &scheduler = TaskScheduler::GetDefault());
+
+	// Little or big endian binary PLY; polygons are fanned, and hasNormals is set if the
+	// vertices have nx, ny and nz
+	static bool ImportPly(const uint8_t *pData, size_t size, vVertex &vertices, vuint &indices,
+		bool &hasNormals, TaskScheduler &scheduler = TaskScheduler::GetDefault());
+
+	static const size_t HeaderSize = 84;
+};
@@ -0,0 +1,327 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "DistanceField.h"
+
+#define FILL_DATA		(3u << 30)	// Interior voxels of SolidFill
+#define DISC_RADIUS		0.5f		// Of the surface patch in a voxel
+#define HALF_MAX		0x7bff		// 65504, where no surface voxel exists
+#define BRICK_SHIFT		3			// Of the Morton-ordered blocks of Refine()
+#define BRICK_GRAIN_SIZE	8
+#define BAND_MARGIN		2.0f		// Exact distances may exceed the propagated ones
+
+using namespace std;
+
+const uint32_t DistanceField::NoSite;
+
+// Unnormalized, as packed by VoxelizerCPU; returns its length
+static inline float unpackNormal(uint32_t packed, float n[3])
+{
+	n[0] = static_cast<float>(packed & 0x3ff) / 1023 * 2.0f - 1.0f;
+	n[1] = static_cast<float>((packed >> 10) & 0x3ff) / 1023 * 2.0f - 1.0f;
+	n[2] = static_cast<float>((packed >> 20) & 0x3ff) / 1023 * 2.0f - 1.0f;
+
+	return sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+}
+
+// Stored normals are in object space; voxel space has y flipped, as TexLoc in VoxelizerCPU
+static inline void toVoxelSpace(float n[3])
+{
+	n[1] = -n[1];
+}
+
+static inline float asFloat(uint32_t u)
+{
+	float f;
+	memcpy(&f, &u, sizeof(f));
+
+	return f;
+}
+
+static inline uint32_t asUint(float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+
+	return u;
+}
+
+DistanceField::DistanceField(TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_gridSize(0)
+{
+	m_lines.resize(m_scheduler.GetNumWorkers());
+	m_envelopes.resize(m_scheduler.GetNumWorkers());
+	m_points.resize(m_scheduler.GetNumWorkers());
+	m_pointVoxels.resize(m_scheduler.GetNumWorkers());
+	m_hits.resize(m_scheduler.GetNumWorkers());
+}
+
+DistanceField::~DistanceField()
+{
+}
+
+void DistanceField::Build(const uint32_t *pGrid, uint32_t gridSize)
+{
+	m_gridSize = gridSize;
+	const auto sliceSize = static_cast<size_t>(gridSize) * gridSize;
+	m_sites.resize(sliceSize * gridSize);
+	m_distances.resize(m_sites.size());
+	for (auto &line : m_lines) line.resize(gridSize);
+	for (auto &envelope : m_envelopes) envelope.resize(gridSize);
+
+	// Surface voxels are their own sites
+	m_scheduler.ParallelFor(0, gridSize, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin * sliceSize; i < end * sliceSize; ++i)
+			m_sites[i] = pGrid[i] && pGrid[i] != FILL_DATA ? static_cast<uint32_t>(i) : NoSite;
+	});
+
+	// Along x, in place on the contiguous rows
+	m_scheduler.ParallelFor(0, gridSize, 1, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		for (auto z = begin; z < end; ++z)
+			for (auto y = 0u; y < gridSize; ++y)
+			{
+				const uint32_t origin[] = { 0, y, z };
+				transformLine(&m_sites[z * sliceSize + y * gridSize], 0, origin, workerIdx);
+			}
+	});
+
+	// Along y, then z, gathering the strided lines; consecutive x share cache lines
+	for (auto axis = 1u; axis < 3; ++axis)
+	{
+		const auto stride = axis == 1 ? static_cast<size_t>(gridSize) : sliceSize;
+		m_scheduler.ParallelFor(0, gridSize, 1, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+		{
+			auto &line = m_lines[workerIdx];
+			for (auto w = begin; w < end; ++w)
+				for (auto x = 0u; x < gridSize; ++x)
+				{
+					// The other axis is z along y, and y along z
+					const uint32_t origin[] = { x, axis == 1 ? 0 : w, axis == 1 ? w : 0 };
+					const auto pLine = &m_sites[(axis == 1 ? w * sliceSize : w * static_cast<size_t>(gridSize)) + x];
+					for (auto i = 0u; i < gridSize; ++i) line[i] = pLine[i * stride];
+					transformLine(line.data(), axis, origin, workerIdx);
+					for (auto i = 0u; i < gridSize; ++i) pLine[i * stride] = line[i];
+				}
+		});
+	}
+
+	// Distance to the disc of the nearest surface voxel, negative in the filled interior
+	m_scheduler.ParallelFor(0, gridSize, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto z = begin; z < end; ++z)
+			for (auto y = 0u; y < gridSize; ++y)
+				for (auto x = 0u; x < gridSize; ++x)
+				{
+					const auto i = z * sliceSize + y * gridSize + x;
+					const auto site = m_sites[i];
+					if (site == NoSite)
+					{
+						m_distances[i] = HALF_MAX;
+						continue;
+					}
+
+					const float d[] =
+					{
+						static_cast<float>(x) - static_cast<float>(site % gridSize),
+						static_cast<float>(y) - static_cast<float>(site / gridSize % gridSize),
+						static_cast<float>(z) - static_cast<float>(site / sliceSize)
+					};
+					float n[3];
+					const auto nrmLen = unpackNormal(pGrid[site], n);
+					toVoxelSpace(n);
+					const auto distSq = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+					// Without a usable normal, the surface is the voxel center
+					auto dist = sqrt(distSq);
+					if (nrmLen > 0.1f)
+					{
+						const auto dn = (d[0] * n[0] + d[1] * n[1] + d[2] * n[2]) / nrmLen;
+						const auto dt = (max)(sqrt((max)(distSq - dn * dn, 0.0f)) - DISC_RADIUS, 0.0f);
+						dist = sqrt(dn * dn + dt * dt);
+					}
+
+					m_distances[i] = FloatToHalf(pGrid[i] == FILL_DATA ? -dist : dist);
+				}
+	});
+}
+
+uint64_t DistanceField::Refine(const uint32_t *pGrid, const TriangleBVH &bvh, float bandWidth)
+{
+	const auto gridSize = m_gridSize;
+	const auto sliceSize = static_cast<size_t>(gridSize) * gridSize;
+	const auto bricksPerAxis = (gridSize + (1 << BRICK_SHIFT) - 1) >> BRICK_SHIFT;
+	const auto brickVolume = 1u << (3 * BRICK_SHIFT);
+	atomic<uint64_t> numRefined(0);
+
+	m_scheduler.ParallelFor(0, bricksPerAxis * bricksPerAxis * bricksPerAxis, BRICK_GRAIN_SIZE,
+		[&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		auto &points = m_points[workerIdx];
+		auto &pointVoxels = m_pointVoxels[workerIdx];
+		auto &hits = m_hits[workerIdx];
+		uint64_t workerRefined = 0;
+		for (auto b = begin; b < end; ++b)
+		{
+			const uint32_t brick[] = { b % bricksPerAxis, b / bricksPerAxis % bricksPerAxis, b / (bricksPerAxis * bricksPerAxis) };
+
+			// Band voxels of the brick in Morton order, so that consecutive queries are neighbors
+			points.clear();
+			pointVoxels.clear();
+			for (auto m = 0u; m < brickVolume; ++m)
+			{
+				uint32_t coord[3];
+				for (auto a = 0u; a < 3; ++a)
+				{
+					coord[a] = brick[a] << BRICK_SHIFT;
+					for (auto i = 0u; i < BRICK_SHIFT; ++i) coord[a] |= ((m >> (3 * i + a)) & 1) << i;
+				}
+				if (coord[0] >= gridSize || coord[1] >= gridSize || coord[2] >= gridSize) continue;
+
+				const auto i = coord[2] * sliceSize + coord[1] * gridSize + coord[0];
+				if (!(abs(HalfToFloat(m_distances[i])) <= bandWidth)) continue;
+				points.emplace_back(coord[0] + 0.5f, coord[1] + 0.5f, coord[2] + 0.5f);
+				pointVoxels.push_back(static_cast<uint32_t>(i));
+			}
+			if (points.empty()) continue;
+
+			hits.resize(points.size());
+			bvh.Query(points.data(), static_cast<uint32_t>(points.size()), bandWidth + BAND_MARGIN, hits.data());
+			for (auto k = 0u; k < hits.size(); ++k)
+			{
+				const auto &hit = hits[k];
+				if (hit.PrimId == TriangleBVH::NoHit) continue;
+
+				// Surface voxels are on either side: behind their normal is inside
+				const auto i = pointVoxels[k];
+				auto inside = pGrid[i] == FILL_DATA;
+				float n[3];
+				if (pGrid[i] && !inside && unpackNormal(pGrid[i], n) > 0.1f)
+				{
+					const auto &p = points[k];
+					toVoxelSpace(n);
+					inside = (p.x - hit.Point.x) * n[0] + (p.y - hit.Point.y) * n[1] + (p.z - hit.Point.z) * n[2] < 0.0f;
+				}
+
+				m_distances[i] = FloatToHalf(inside ? -hit.Distance : hit.Distance);
+				++workerRefined;
+			}
+		}
+
+		numRefined += workerRefined;
+	});
+
+	return numRefined;
+}
+
+const vector<uint16_t> &DistanceField::GetDistances() const
+{
+	return m_distances;
+}
+
+float DistanceField::GetDistance(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return HalfToFloat(m_distances[(z * static_cast<size_t>(m_gridSize) + y) * m_gridSize + x]);
+}
+
+void DistanceField::GetNarrowBand(vector<uint8_t> &band, float bandWidth) const
+{
+	const auto sliceSize = static_cast<size_t>(m_gridSize) * m_gridSize;
+	const auto scale = 0.5f / bandWidth;
+	band.resize(m_distances.size());
+	m_scheduler.ParallelFor(0, m_gridSize, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin * sliceSize; i < end * sliceSize; ++i)
+		{
+			const auto v = HalfToFloat(m_distances[i]) * scale + 0.5f;
+			band[i] = static_cast<uint8_t>(floor((min)((max)(v, 0.0f), 1.0f) * 255.0f + 0.5f));
+		}
+	});
+}
+
+uint32_t DistanceField::GetGridSize() const
+{
+	return m_gridSize;
+}
+
+uint16_t DistanceField::FloatToHalf(float f)
+{
+	auto u = asUint(f);
+	const auto sign = static_cast<uint16_t>((u >> 16) & 0x8000);
+	u &= 0x7fffffff;
+
+	// Infinity and NaN, then what rounds past the largest half
+	if (u >= 0x7f800000) return sign | (u > 0x7f800000 ? 0x7e00 : 0x7c00);
+	if (u >= 0x477ff000) return sign | 0x7c00;
+
+	// Denormals: the float adder rounds the mantissa to the half precision
+	if (u < 0x38800000)
+	{
+		const auto denormMagic = asFloat(126u << 23);
+
+		return sign | static_cast<uint16_t>(asUint(asFloat(u) + denormMagic) - asUint(denormMagic));
+	}
+
+	// Rebias the exponent, then round the dropped 13 bits to nearest even
+	u += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + ((u >> 13) & 1);
+
+	return sign | static_cast<uint16_t>(u >> 13);
+}
+
+float DistanceField::HalfToFloat(uint16_t h)
+{
+	const auto sign = static_cast<uint32_t>(h & 0x8000) << 16;
+	const auto exponent = (h >> 10) & 0x1f;
+	const auto mantissa = static_cast<uint32_t>(h & 0x3ff);
+
+	if (exponent == 0) return asFloat(sign | asUint(ldexp(static_cast<float>(mantissa), -24)));
+	if (exponent == 0x1f) return asFloat(sign | 0x7f800000 | (mantissa << 13));
+
+	return asFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+void DistanceField::transformLine(uint32_t *pSites, uint32_t axis, const uint32_t lineOrigin[3], uint32_t workerIdx)
+{
+	const auto gridSize = m_gridSize;
+	const auto u = (axis + 1) % 3;
+	const auto v = (axis + 2) % 3;
+	const auto envelope = m_envelopes[workerIdx].data();
+
+	// Sites keep the coordinate of their line position along the axis, so each parabola has
+	// its vertex there, raised by the squared distance across the line
+	auto numParabolas = 0u;
+	for (auto q = 0u; q < gridSize; ++q)
+	{
+		const auto site = pSites[q];
+		if (site == NoSite) continue;
+
+		const uint32_t coord[] = { site % gridSize, site / gridSize % gridSize, site / (gridSize * gridSize) };
+		const auto du = static_cast<double>(coord[u]) - lineOrigin[u];
+		const auto dv = static_cast<double>(coord[v]) - lineOrigin[v];
+		const auto height = du * du + dv * dv;
+
+		// Drop the parabolas that the new one hides from their bound on
+		auto bound = -numeric_limits<double>::infinity();
+		while (numParabolas > 0)
+		{
+			const auto &last = envelope[numParabolas - 1];
+			const double p = last.Vertex;
+			bound = ((height + static_cast<double>(q) * q) - (last.Height + p * p)) / (2.0 * (q - p));
+			if (bound > last.Bound) break;
+			--numParabolas;
+			bound = -numeric_limits<double>::infinity();
+		}
+
+		envelope[numParabolas++] = { q, site, height, bound };
+	}
+
+	auto k = 0u;
+	for (auto q = 0u; q < gridSize; ++q)
+	{
+		while (k + 1 < numParabolas && envelope[k + 1].Bound <= q) ++k;
+		pSites[q] = numParabolas > 0 ? envelope[k].Site : NoSite;
+	}
+}
@@ -0,0 +1,68 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "TriangleBVH.h"
+
+//--------------------------------------------------------------------------------------
+// Signed distance field of a voxelized surface, in voxels. The nearest surface voxel of
+// every voxel comes from an exact separable feature transform, one parallel pass per
+// axis over independent lines. Distances are then taken to a voxel-wide disc through
+// that surface voxel, oriented by its stored normal, and are negative inside.
+//--------------------------------------------------------------------------------------
+class DistanceField
+{
+public:
+	DistanceField(TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~DistanceField();
+
+	// Voxels are packed R10G10B10A2 normals as output by VoxelizerCPU; 0 is empty. If the
+	// grid went through SolidFill, its filled voxels are inside, otherwise all is outside.
+	void Build(const uint32_t *pGrid, uint32_t gridSize);
+	// Replaces the distances within bandWidth by exact ones to the triangles of the BVH, which are
+	// in voxels, voxel (x, y, z) spanning [x, x + 1). pGrid is that of Build(), giving the signs,
+	// and surface voxels take the side of their normal. Returns the number of voxels refined.
+	uint64_t Refine(const uint32_t *pGrid, const TriangleBVH &bvh, float bandWidth);
+
+	const std::vector<uint16_t> &GetDistances() const;	// Half floats, linear layout
+	float GetDistance(uint32_t x, uint32_t y, uint32_t z) const;
+	// 8-bit UNORM narrow band: [-bandWidth, bandWidth] voxels to [0, 255], clamped outside
+	void GetNarrowBand(std::vector<uint8_t> &band, float bandWidth) const;
+	uint32_t GetGridSize() const;
+
+	static uint16_t FloatToHalf(float f);	// Round to nearest even
+	static float HalfToFloat(uint16_t h);
+
+	static const uint32_t NoSite = UINT32_MAX;
+
+protected:
+	struct Parabola
+	{
+		uint32_t	Vertex;	// Position along the line
+		uint32_t	Site;
+		double		Height;	// Squared distance to the site across the line
+		double		Bound;	// Where the parabola starts to be the lowest
+	};
+
+	// Lower envelope of the parabolas of one line along the axis; the sites of the line are
+	// nearest within the axes done so far on input, and within one more axis on output
+	void transformLine(uint32_t *pSites, uint32_t axis, const uint32_t lineOrigin[3], uint32_t workerIdx);
+
+	TaskScheduler			&m_scheduler;
+
+	std::vector<uint32_t>	m_sites;		// Linear index of the nearest surface voxel, or NoSite
+	std::vector<uint16_t>	m_distances;
+
+	// Per worker scratch of transformLine()
+	std::vector<std::vector<uint32_t>> m_lines;
+	std::vector<std::vector<Parabola>> m_envelopes;
+
+	// Per worker scratch of Refine()
+	std::vector<std::vector<ObjLoader::float3>> m_points;
+	std::vector<std::vector<uint32_t>> m_pointVoxels;
+	std::vector<std::vector<TriangleBVH::Hit>> m_hits;
+
+	uint32_t				m_gridSize;
+};
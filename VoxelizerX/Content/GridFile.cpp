@@ -0,0 +1,163 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "GridFile.h"
+
+using namespace std;
+
+bool GridFile::Write(const char *fileName, const SparseGrid &grid, uint64_t *pFileSize)
+{
+	const auto numBricks = grid.GetNumBricks();
+
+	Header header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.GridSize = grid.GetGridSize();
+	header.BrickSize = SparseGrid::BrickSize;
+
+	// Allocated bricks may still be empty after voxelization; drop them
+	vector<uint32_t> bricks;
+	vector<uint32_t> keys;
+	bricks.reserve(numBricks);
+	keys.reserve(numBricks);
+	for (auto i = 0u; i < numBricks; ++i)
+	{
+		const auto pBrick = grid.GetBrick(i);
+		const auto numVoxels = count_if(pBrick, pBrick + SparseGrid::VoxelsPerBrick, [](uint32_t v) { return v != 0; });
+		if (numVoxels == 0) continue;
+
+		bricks.push_back(i);
+		keys.push_back(grid.GetBrickKey(i));
+		header.NumVoxels += numVoxels;
+	}
+	header.NumBricks = static_cast<uint32_t>(bricks.size());
+
+	return writeFile(fileName, header, keys, [&](uint32_t i) { return grid.GetBrick(bricks[i]); }, pFileSize);
+}
+
+bool GridFile::Write(const char *fileName, const vector<uint32_t> &grid, uint32_t gridSize, uint64_t *pFileSize)
+{
+	const auto brickSize = SparseGrid::BrickSize;
+	const auto bricksPerAxis = (gridSize + brickSize - 1) / brickSize;
+	const auto size = static_cast<size_t>(gridSize);
+
+	Header header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.GridSize = gridSize;
+	header.BrickSize = brickSize;
+
+	// Gather the non-empty bricks in brick-map order, as SparseGrid numbers them
+	vector<uint32_t> bricks;
+	vector<uint32_t> keys;
+	uint32_t brick[SparseGrid::VoxelsPerBrick];
+	for (auto key = 0u; key < bricksPerAxis * bricksPerAxis * bricksPerAxis; ++key)
+	{
+		const auto brickX = key % bricksPerAxis * brickSize;
+		const auto brickY = key / bricksPerAxis % bricksPerAxis * brickSize;
+		const auto brickZ = key / (bricksPerAxis * bricksPerAxis) * brickSize;
+
+		auto numVoxels = 0u;
+		fill_n(brick, SparseGrid::VoxelsPerBrick, 0);
+		for (auto k = 0u; k < brickSize && brickZ + k < gridSize; ++k)
+		{
+			for (auto j = 0u; j < brickSize && brickY + j < gridSize; ++j)
+			{
+				for (auto i = 0u; i < brickSize && brickX + i < gridSize; ++i)
+				{
+					const auto voxel = grid[((brickZ + k) * size + brickY + j) * size + brickX + i];
+					brick[(k * brickSize + j) * brickSize + i] = voxel;
+					numVoxels += voxel != 0 ? 1 : 0;
+				}
+			}
+		}
+		if (numVoxels == 0) continue;
+
+		bricks.insert(bricks.end(), brick, brick + SparseGrid::VoxelsPerBrick);
+		keys.push_back(key);
+		header.NumVoxels += numVoxels;
+	}
+	header.NumBricks = static_cast<uint32_t>(keys.size());
+
+	return writeFile(fileName, header, keys, [&](uint32_t i) { return &bricks[static_cast<size_t>(i) * SparseGrid::VoxelsPerBrick]; },
+		pFileSize);
+}
+
+bool GridFile::Read(const char *fileName, vector<uint32_t> &grid, uint32_t &gridSize)
+{
+	ifstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	Header header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+	if (!file || header.Magic != Magic || header.Version != Version) return false;
+	if (header.BrickSize != SparseGrid::BrickSize || header.GridSize == 0) return false;
+
+	const auto brickSize = SparseGrid::BrickSize;
+	const auto bricksPerAxis = (header.GridSize + brickSize - 1) / brickSize;
+	const auto mapSize = static_cast<uint64_t>(bricksPerAxis) * bricksPerAxis * bricksPerAxis;
+	if (header.NumBricks > mapSize) return false;
+
+	vector<uint32_t> keys(header.NumBricks);
+	file.read(reinterpret_cast<char*>(keys.data()), sizeof(uint32_t) * keys.size());
+	if (!file) return false;
+
+	gridSize = header.GridSize;
+	const auto size = static_cast<size_t>(gridSize);
+	grid.assign(size * size * size, 0);
+
+	uint32_t brick[SparseGrid::VoxelsPerBrick];
+	for (const auto &key : keys)
+	{
+		file.read(reinterpret_cast<char*>(brick), sizeof(brick));
+		if (!file || key >= mapSize) return false;
+
+		const auto brickX = key % bricksPerAxis * brickSize;
+		const auto brickY = key / bricksPerAxis % bricksPerAxis * brickSize;
+		const auto brickZ = key / (bricksPerAxis * bricksPerAxis) * brickSize;
+		for (auto k = 0u; k < brickSize && brickZ + k < gridSize; ++k)
+			for (auto j = 0u; j < brickSize && brickY + j < gridSize; ++j)
+				for (auto i = 0u; i < brickSize && brickX + i < gridSize; ++i)
+					grid[((brickZ + k) * size + brickY + j) * size + brickX + i] =
+					brick[(k * brickSize + j) * brickSize + i];
+	}
+
+	return true;
+}
+
+bool GridFile::writeFile(const char *fileName, const Header &header, const vector<uint32_t> &keys,
+	const function<const uint32_t*(uint32_t)> &getBrick, uint64_t *pFileSize)
+{
+	// Write to a temporary file first so that readers never see a partial grid
+	const auto tempName = string(fileName) + ".tmp";
+	{
+		ofstream file(tempName, ios::binary | ios::trunc);
+		if (!file) return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(reinterpret_cast<const char*>(keys.data()), sizeof(uint32_t) * keys.size());
+		for (auto i = 0u; i < header.NumBricks; ++i)
+			file.write(reinterpret_cast<const char*>(getBrick(i)), sizeof(uint32_t) * SparseGrid::VoxelsPerBrick);
+		if (!file.good())
+		{
+			file.close();
+			remove(tempName.c_str());
+
+			return false;
+		}
+	}
+
+	remove(fileName);
+	if (rename(tempName.c_str(), fileName) != 0)
+	{
+		remove(tempName.c_str());
+
+		return false;
+	}
+
+	if (pFileSize) *pFileSize = sizeof(Header) + static_cast<uint64_t>(header.NumBricks) *
+		(SparseGrid::VoxelsPerBrick + 1) * sizeof(uint32_t);
+
+	return true;
+}
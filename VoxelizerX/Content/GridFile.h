@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "SparseGrid.h"
+
+//--------------------------------------------------------------------------------------
+// Binary voxel grid file: a header, the brick keys, then the BrickSize^3 bricks.
+// Only non-empty bricks are stored; keys are linear brick-map indices in ascending order.
+//--------------------------------------------------------------------------------------
+class GridFile
+{
+public:
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t GridSize;
+		uint32_t BrickSize;
+		uint32_t NumBricks;
+		uint32_t Reserved;
+		uint64_t NumVoxels;		// Occupied voxels
+	};
+
+	static bool Write(const char *fileName, const SparseGrid &grid, uint64_t *pFileSize = nullptr);
+	static bool Write(const char *fileName, const std::vector<uint32_t> &grid, uint32_t gridSize,	// Dense
+		uint64_t *pFileSize = nullptr);
+	static bool Read(const char *fileName, std::vector<uint32_t> &grid, uint32_t &gridSize);
+
+	static const uint32_t Magic = 0x44524758;	// "XGRD"
+	static const uint32_t Version = 1;
+
+protected:
+	// Writes atomically through a temporary file; getBrick(i) returns the i-th stored brick
+	static bool writeFile(const char *fileName, const Header &header, const std::vector<uint32_t> &keys,
+		const std::function<const uint32_t*(uint32_t)> &getBrick, uint64_t *pFileSize);
+};
@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "MappedFile.h"
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() :
+#ifdef _WIN32
+	m_hFile(INVALID_HANDLE_VALUE),
+	m_hMapping(nullptr),
+#else
+	m_fd(-1),
+#endif
+	m_pData(nullptr),
+	m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char *fileName)
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize))
+	{
+		Close();
+
+		return false;
+	}
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files cannot be mapped
+	if (m_size == 0) return true;
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping) m_pData = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_fd = open(fileName, O_RDONLY);
+	if (m_fd < 0) return false;
+
+	struct stat fileStat;
+	if (fstat(m_fd, &fileStat) != 0)
+	{
+		Close();
+
+		return false;
+	}
+	m_size = static_cast<size_t>(fileStat.st_size);
+
+	// Empty files cannot be mapped
+	if (m_size == 0) return true;
+
+	const auto pData = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (pData != MAP_FAILED)
+	{
+		m_pData = reinterpret_cast<const uint8_t*>(pData);
+		madvise(pData, m_size, MADV_SEQUENTIAL);
+	}
+#endif
+
+	if (!m_pData)
+	{
+		Close();
+
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_hMapping) CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData) munmap(const_cast<uint8_t*>(m_pData), m_size);
+	if (m_fd >= 0) close(m_fd);
+	m_fd = -1;
+#endif
+
+	m_pData = nullptr;
+	m_size = 0;
+}
+
+const uint8_t *MappedFile::GetData() const
+{
+	return m_pData;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
+
+bool MappedFile::Stat(const char *fileName, uint64_t &size, uint64_t &modifiedTime)
+{
+#ifdef _WIN32
+	struct _stat64 fileStat;
+	if (_stat64(fileName, &fileStat) != 0) return false;
+#else
+	struct stat fileStat;
+	if (stat(fileName, &fileStat) != 0) return false;
+#endif
+
+	size = static_cast<uint64_t>(fileStat.st_size);
+	modifiedTime = static_cast<uint64_t>(fileStat.st_mtime);
+
+	return true;
+}
@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Read-only memory-mapped file
+//--------------------------------------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	virtual ~MappedFile();
+
+	bool Open(const char *fileName);
+	void Close();
+
+	const uint8_t *GetData() const;
+	size_t GetSize() const;
+
+	static bool Stat(const char *fileName, uint64_t &size, uint64_t &modifiedTime);
+
+protected:
+#ifdef _WIN32
+	HANDLE			m_hFile;
+	HANDLE			m_hMapping;
+#else
+	int				m_fd;
+#endif
+
+	const uint8_t	*m_pData;
+	size_t			m_size;
+};
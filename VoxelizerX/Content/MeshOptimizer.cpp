@@ -0,0 +1,257 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "MeshOptimizer.h"
+
+using namespace std;
+
+using float3 = ObjLoader::float3;
+
+void MeshOptimizer::Optimize(vVertex &vertices, vuint &indices, float epsilon, uint32_t cacheSize)
+{
+	Weld(vertices, indices, epsilon);
+	ReorderTriangles(indices, static_cast<uint32_t>(vertices.size()), cacheSize);
+	ReorderVertices(vertices, indices);
+}
+
+void MeshOptimizer::Weld(vVertex &vertices, vuint &indices, float epsilon)
+{
+	const auto numVert = static_cast<uint32_t>(vertices.size());
+	const auto invCellSize = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+	const auto range = epsilon > 0.0f ? 1 : 0;
+	const auto epsilonSq = epsilon * epsilon;
+
+	// Cells of epsilon size, or the exact bit patterns when only welding duplicates
+	const auto getCell = [&](const float3 &pos, int64_t cell[3])
+	{
+		const float coords[] = { pos.x, pos.y, pos.z };
+		for (auto i = 0u; i < 3; ++i)
+		{
+			if (epsilon > 0.0f) cell[i] = static_cast<int64_t>(floor(coords[i] * invCellSize));
+			else
+			{
+				uint32_t bits;
+				memcpy(&bits, &coords[i], sizeof(uint32_t));
+				cell[i] = bits;
+			}
+		}
+	};
+
+	// Spatial hash; collisions only cost extra distance checks
+	const auto hashCell = [](int64_t x, int64_t y, int64_t z)
+	{
+		return static_cast<uint64_t>(x * 73856093) ^ static_cast<uint64_t>(y * 19349663) ^ static_cast<uint64_t>(z * 83492791);
+	};
+
+	unordered_map<uint64_t, uint32_t> cellHeads;	// First welded vertex of each hashed cell
+	vuint nexts, remap(numVert), numMerged;
+	vVertex welded;
+	cellHeads.reserve(numVert);
+	nexts.reserve(numVert);
+	numMerged.reserve(numVert);
+	welded.reserve(numVert);
+
+	for (auto i = 0u; i < numVert; ++i)
+	{
+		const auto &vertex = vertices[i];
+		int64_t cell[3];
+		getCell(vertex.m_vPosition, cell);
+
+		auto found = UINT32_MAX;
+		for (auto z = -range; z <= range && found == UINT32_MAX; ++z)
+		{
+			for (auto y = -range; y <= range && found == UINT32_MAX; ++y)
+			{
+				for (auto x = -range; x <= range && found == UINT32_MAX; ++x)
+				{
+					const auto it = cellHeads.find(hashCell(cell[0] + x, cell[1] + y, cell[2] + z));
+					if (it == cellHeads.end()) continue;
+
+					for (auto j = it->second; j != UINT32_MAX; j = nexts[j])
+					{
+						const auto &pos = welded[j].m_vPosition;
+						const auto dx = pos.x - vertex.m_vPosition.x;
+						const auto dy = pos.y - vertex.m_vPosition.y;
+						const auto dz = pos.z - vertex.m_vPosition.z;
+						if (dx * dx + dy * dy + dz * dz <= epsilonSq)
+						{
+							found = j;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if (found == UINT32_MAX)
+		{
+			found = static_cast<uint32_t>(welded.size());
+			auto &head = cellHeads.emplace(hashCell(cell[0], cell[1], cell[2]), UINT32_MAX).first->second;
+			nexts.push_back(head);
+			head = found;
+			numMerged.push_back(1);
+			welded.push_back(vertex);
+		}
+		else
+		{
+			auto &normal = welded[found].m_vNormal;
+			normal.x += vertex.m_vNormal.x;
+			normal.y += vertex.m_vNormal.y;
+			normal.z += vertex.m_vNormal.z;
+			++numMerged[found];
+		}
+
+		remap[i] = found;
+	}
+
+	for (size_t i = 0; i < welded.size(); ++i)
+	{
+		if (numMerged[i] < 2) continue;
+
+		auto &n = welded[i].m_vNormal;
+		const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (l > 0.0f) n = float3(n.x / l, n.y / l, n.z / l);
+	}
+
+	// Remap the triangles, dropping the ones that collapsed
+	const auto numTri = indices.size() / 3;
+	vuint weldedIndices;
+	weldedIndices.reserve(numTri * 3);
+	for (size_t i = 0; i < numTri; ++i)
+	{
+		if (indices[i * 3] >= numVert || indices[i * 3 + 1] >= numVert || indices[i * 3 + 2] >= numVert) continue;
+
+		const uint32_t tri[] = { remap[indices[i * 3]], remap[indices[i * 3 + 1]], remap[indices[i * 3 + 2]] };
+		if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) continue;
+		weldedIndices.insert(weldedIndices.end(), tri, tri + 3);
+	}
+
+	vertices.swap(welded);
+	indices.swap(weldedIndices);
+}
+
+void MeshOptimizer::ReorderTriangles(vuint &indices, uint32_t numVertices, uint32_t cacheSize)
+{
+	const auto numTri = static_cast<uint32_t>(indices.size() / 3);
+
+	// Vertex-triangle adjacency as CSR
+	vuint offsets(numVertices + 1, 0);
+	for (auto i = 0u; i < numTri * 3; ++i) ++offsets[indices[i] + 1];
+	for (auto i = 0u; i < numVertices; ++i) offsets[i + 1] += offsets[i];
+
+	vuint adjacency(numTri * 3);
+	vuint cursors(offsets.cbegin(), offsets.cend() - 1);
+	for (auto i = 0u; i < numTri * 3; ++i) adjacency[cursors[indices[i]]++] = i / 3;
+
+	// Live triangle counts, cache time stamps and the dead-end stack
+	vector<int32_t> liveCounts(numVertices);
+	for (auto i = 0u; i < numVertices; ++i) liveCounts[i] = static_cast<int32_t>(offsets[i + 1] - offsets[i]);
+
+	vector<uint64_t> cacheTimes(numVertices, 0);
+	vector<uint8_t> emitted(numTri, 0);
+	vuint deadEnds, candidates, reordered;
+	reordered.reserve(numTri * 3);
+	auto time = static_cast<uint64_t>(cacheSize) + 1;
+	auto cursor = 0u;
+
+	const auto skipDeadEnd = [&]()
+	{
+		while (!deadEnds.empty())
+		{
+			const auto v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveCounts[v] > 0) return v;
+		}
+
+		while (cursor < numVertices)
+		{
+			const auto v = cursor++;
+			if (liveCounts[v] > 0) return v;
+		}
+
+		return UINT32_MAX;
+	};
+
+	for (auto fan = skipDeadEnd(); fan != UINT32_MAX;)
+	{
+		// Emit all the remaining triangles around the fanning vertex
+		candidates.clear();
+		for (auto j = offsets[fan]; j < offsets[fan + 1]; ++j)
+		{
+			const auto t = adjacency[j];
+			if (emitted[t]) continue;
+
+			for (auto k = 0u; k < 3; ++k)
+			{
+				const auto v = indices[t * 3 + k];
+				reordered.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--liveCounts[v];
+				if (time - cacheTimes[v] > cacheSize) cacheTimes[v] = time++;
+			}
+			emitted[t] = 1;
+		}
+
+		// Next fan: the candidate still in cache after its remaining triangles, oldest first
+		auto next = UINT32_MAX;
+		auto bestPriority = -1ll;
+		for (const auto &v : candidates)
+		{
+			if (liveCounts[v] <= 0) continue;
+
+			auto priority = 0ll;
+			const auto age = static_cast<int64_t>(time - cacheTimes[v]);
+			if (age + 2 * liveCounts[v] <= static_cast<int64_t>(cacheSize)) priority = age;
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		fan = next != UINT32_MAX ? next : skipDeadEnd();
+	}
+
+	indices.swap(reordered);
+}
+
+void MeshOptimizer::ReorderVertices(vVertex &vertices, vuint &indices)
+{
+	vuint remap(vertices.size(), UINT32_MAX);
+	vVertex reordered;
+	reordered.reserve(vertices.size());
+
+	for (auto &index : indices)
+	{
+		auto &newIndex = remap[index];
+		if (newIndex == UINT32_MAX)
+		{
+			newIndex = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = newIndex;
+	}
+
+	vertices.swap(reordered);
+}
+
+float MeshOptimizer::ComputeACMR(const uint32_t *pIndices, uint32_t numIndices, uint32_t numVertices, uint32_t cacheSize)
+{
+	// A vertex is in the FIFO cache while fewer than cacheSize misses followed its own
+	vector<uint64_t> cacheTimes(numVertices, 0);
+	auto time = static_cast<uint64_t>(cacheSize) + 1;
+	auto numMisses = 0ull;
+	for (auto i = 0u; i < numIndices; ++i)
+	{
+		const auto v = pIndices[i];
+		if (time - cacheTimes[v] > cacheSize)
+		{
+			cacheTimes[v] = time++;
+			++numMisses;
+		}
+	}
+
+	return numIndices >= 3 ? static_cast<float>(numMisses) / (numIndices / 3) : 0.0f;
+}
@@ -0,0 +1,37 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ObjLoader.h"
+
+//--------------------------------------------------------------------------------------
+// Optional CPU pass over a mesh before upload: vertex welding, Tipsify triangle order
+// for the post-transform cache, then vertex order by first use for fetch locality
+//--------------------------------------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	using vVertex	= ObjLoader::vVertex;
+	using vuint		= ObjLoader::vuint;
+
+	// All three passes in order
+	static void Optimize(vVertex &vertices, vuint &indices, float epsilon = 0.0f, uint32_t cacheSize = DefaultCacheSize);
+
+	// Merges vertices closer than epsilon (0 merges exact duplicates only), averaging their
+	// normals, and drops the triangles that collapse
+	static void Weld(vVertex &vertices, vuint &indices, float epsilon = 0.0f);
+
+	// Tipsify (Sander et al. 2007): linear-time reordering for a FIFO cache of cacheSize vertices
+	static void ReorderTriangles(vuint &indices, uint32_t numVertices, uint32_t cacheSize = DefaultCacheSize);
+
+	// Renumbers the vertices in order of first use; unused vertices are dropped
+	static void ReorderVertices(vVertex &vertices, vuint &indices);
+
+	// Average cache miss ratio: vertices transformed per triangle through a FIFO cache
+	static float ComputeACMR(const uint32_t *pIndices, uint32_t numIndices, uint32_t numVertices,
+		uint32_t cacheSize = DefaultCacheSize);
+
+	static const uint32_t DefaultCacheSize = 16;
+};
@@ -3,12 +3,162 @@
 //--------------------------------------------------------------------------------------
 
 #include "ObjLoader.h"
+#include "MappedFile.h"
+#include "BinaryMeshLoader.h"
+#include "VertexQuantizer.h"
 
 #define VEC_ALLOC(v, i)			{ v.resize(i); v.shrink_to_fit(); }
+#define CHUNK_SIZE_MIN			(1 << 20)
+#define HASH_BLOCK_SIZE			(1 << 20)
+#define FACE_GRAIN_SIZE			(1 << 14)
+#define CORNER_BLOCK_SIZE		(1 << 18)
+#define BOUND_GRAIN_SIZE		(1 << 16)
+#define VERTEX_BUCKET_BITS		13
+
+#define CACHE_FILE_EXT			".cache"
+#define CACHE_MAGIC				0x48534d58	// "XMSH"
+#define CACHE_VERSION			3
 
 using namespace std;
 
-ObjLoader::ObjLoader()
+enum IndexFlag : uint8_t
+{
+	HAS_V	= (1 << 0),
+	HAS_VT	= (1 << 1),
+	HAS_VN	= (1 << 2),
+	REL_V	= (1 << 3),
+	REL_VT	= (1 << 4),
+	REL_VN	= (1 << 5)
+};
+
+enum CacheFlag : uint32_t
+{
+	CACHE_RECOMPUTED_NORMAL	= (1 << 0),
+	CACHE_BOUND				= (1 << 1)
+};
+
+// Binary sidecar layout: header, vertex array, 32-bit index array, then the optional texcoords
+struct CacheHeader
+{
+	uint32_t			uMagic;
+	uint32_t			uVersion;
+	uint32_t			uFlags;
+	uint32_t			uVertexStride;
+	uint32_t			uNumVertices;
+	uint32_t			uNumIndices;
+	ObjLoader::float3	vCenter;
+	float				fRadius;
+	ObjLoader::float3	vExtent;
+	uint32_t			uReserved;			// Keeps the header free of padding
+	uint64_t			uSourceSize;
+	uint64_t			uSourceTime;
+	uint64_t			uSourceHash;
+	uint64_t			uVertexOffset;
+	uint64_t			uIndexOffset;
+	uint64_t			uTexcoordOffset;	// 0 if the mesh has no texcoords
+};
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char *skipSpaces(const char *p, const char *pEnd)
+{
+	while (p < pEnd && isSpace(*p)) ++p;
+
+	return p;
+}
+
+static inline const char *skipLine(const char *p, const char *pEnd)
+{
+	while (p < pEnd && *p != '\n') ++p;
+
+	return p < pEnd ? p + 1 : pEnd;
+}
+
+static const char *parseInt(const char *p, const char *pEnd, int64_t &value)
+{
+	const auto bNegative = p < pEnd && *p == '-';
+	if (p < pEnd && (*p == '-' || *p == '+')) ++p;
+
+	value = 0;
+	for (; p < pEnd && isDigit(*p); ++p) value = value * 10 + (*p - '0');
+	if (bNegative) value = -value;
+
+	return p;
+}
+
+static const char *parseFloat(const char *p, const char *pEnd, float &value)
+{
+	static const double pow10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	p = skipSpaces(p, pEnd);
+	const auto bNegative = p < pEnd && *p == '-';
+	if (p < pEnd && (*p == '-' || *p == '+')) ++p;
+
+	// Accumulate up to 19 significant digits
+	auto uMantissa = 0ull;
+	auto iExponent = 0;
+	auto uNumDigits = 0u;
+	for (; p < pEnd && isDigit(*p); ++p)
+	{
+		if (uNumDigits < 19)
+		{
+			uMantissa = uMantissa * 10 + (*p - '0');
+			if (uMantissa) ++uNumDigits;
+		}
+		else ++iExponent;
+	}
+
+	if (p < pEnd && *p == '.')
+	{
+		for (++p; p < pEnd && isDigit(*p); ++p)
+		{
+			if (uNumDigits < 19)
+			{
+				uMantissa = uMantissa * 10 + (*p - '0');
+				if (uMantissa) ++uNumDigits;
+				--iExponent;
+			}
+		}
+	}
+
+	if (p < pEnd && (*p == 'e' || *p == 'E'))
+	{
+		int64_t iExp;
+		p = parseInt(p + 1, pEnd, iExp);
+		iExponent += static_cast<int>(max<int64_t>(min<int64_t>(iExp, 1000), -1000));
+	}
+
+	auto fValue = static_cast<double>(uMantissa);
+	if (iExponent < 0) fValue = iExponent >= -22 ? fValue / pow10[-iExponent] : fValue * pow(10.0, iExponent);
+	else if (iExponent > 0) fValue = iExponent <= 22 ? fValue * pow10[iExponent] : fValue * pow(10.0, iExponent);
+	value = static_cast<float>(bNegative ? -fValue : fValue);
+
+	return p;
+}
+
+ObjLoader::ObjLoader(TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_vCenter(0.0f, 0.0f, 0.0f),
+	m_vExtent(0.0f, 0.0f, 0.0f),
+	m_fRadius(0.0f),
+	m_bHasBound(false),
+	m_pVertices(nullptr),
+	m_pIndices(nullptr),
+	m_pTexcoords(nullptr),
+	m_uNumVertices(0),
+	m_uNumIndices(0)
 {
 }
 
@@ -16,34 +166,84 @@ ObjLoader::~ObjLoader()
 {
 }
 
-bool ObjLoader::Import(const char *pszFilename, const bool bRecomputeNorm, const bool bNeedBound)
+bool ObjLoader::Import(const char *pszFilename, const bool bRecomputeNorm, const bool bNeedBound,
+	const bool bUseCache)
 {
-	FILE *pFile;
-	fopen_s(&pFile, pszFilename, "r");
+	const auto uFlags = (bRecomputeNorm ? static_cast<uint32_t>(CACHE_RECOMPUTED_NORMAL) : 0u) |
+		(bNeedBound ? static_cast<uint32_t>(CACHE_BOUND) : 0u);
+	m_vQuantizedVertices.clear();
+	m_vCenter = m_vExtent = float3(0.0f, 0.0f, 0.0f);
+	m_fRadius = 0.0f;
+	m_bHasBound = false;
+	if (bUseCache && importCache(pszFilename, uFlags))
+	{
+		m_bHasBound = bNeedBound;
 
-	if (!pFile) return false;
+		return true;
+	}
+
+	MappedFile file;
+	if (!file.Open(pszFilename)) return false;
 
-	// Import the OBJ file.
-	importGeometryFirstPass(pFile);
-	rewind(pFile);
-	importGeometrySecondPass(pFile);
-	fclose(pFile);
+	// Import the OBJ, binary STL or binary PLY file; a truncated binary file fails as a whole.
+	auto bHasNormals = false;
+	auto bImported = true;
+	vfloat2().swap(m_vTexcoords);
+	switch (BinaryMeshLoader::DetectFormat(file.GetData(), file.GetSize()))
+	{
+	case BinaryMeshLoader::STL:
+		bImported = BinaryMeshLoader::ImportStl(file.GetData(), file.GetSize(), m_vVertices, m_vIndices, m_scheduler);
+		break;
+	case BinaryMeshLoader::PLY:
+		bImported = BinaryMeshLoader::ImportPly(file.GetData(), file.GetSize(), m_vVertices, m_vIndices, bHasNormals, m_scheduler);
+		break;
+	default:
+		importGeometry(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), bHasNormals);
+	}
+	if (!bImported || m_vVertices.empty()) return false;
 
-	// Perform post import tasks.
-	if (bRecomputeNorm) computeNormal();
+	// Perform post import tasks; normals provided for every corner are kept.
+	if (bRecomputeNorm && !bHasNormals) computeNormal();
 	if (bNeedBound) computeBound();
+	m_bHasBound = bNeedBound;
+
+	m_pCache.reset();
+	m_pVertices = m_vVertices.data();
+	m_pIndices = m_vIndices.data();
+	m_pTexcoords = m_vTexcoords.empty() ? nullptr : m_vTexcoords.data();
+	m_uNumVertices = static_cast<uint32_t>(m_vVertices.size());
+	m_uNumIndices = static_cast<uint32_t>(m_vIndices.size());
+
+	if (bUseCache) exportCache(pszFilename, uFlags, hashData(file.GetData(), file.GetSize(), m_scheduler));
+
+	return true;
+}
+
+bool ObjLoader::Quantize(const bool bKeepVertices)
+{
+	// The quantization grid is the bound
+	if (!m_bHasBound || !m_uNumVertices) return false;
+
+	m_vQuantizedVertices.resize(m_uNumVertices);
+	VertexQuantizer::Quantize(GetVertices(), m_uNumVertices, GetVertexStride(), m_vCenter, m_vExtent,
+		m_vQuantizedVertices.data(), m_scheduler);
+	if (bKeepVertices) return true;
+
+	// Only the compressed stream stays resident; a cache mapping holds the indices anyway
+	vVertex().swap(m_vVertices);
+	m_pVertices = nullptr;
 
 	return true;
 }
 
 const uint32_t ObjLoader::GetNumVertices() const
 {
-	return static_cast<uint32_t>(m_vVertices.size());
+	return m_uNumVertices;
 }
 
 const uint32_t ObjLoader::GetNumIndices() const
 {
-	return static_cast<uint32_t>(m_vIndices.size());
+	return m_uNumIndices;
 }
 
 const uint32_t ObjLoader::GetVertexStride() const
@@ -53,12 +253,22 @@ const uint32_t ObjLoader::GetVertexStride() const
 
 const uint8_t *ObjLoader::GetVertices() const
 {
-	return reinterpret_cast<const uint8_t*>(m_vVertices.data());
+	return reinterpret_cast<const uint8_t*>(m_pVertices);
 }
 
 const uint32_t *ObjLoader::GetIndices() const
 {
-	return m_vIndices.data();
+	return m_pIndices;
+}
+
+const ObjLoader::float2 *ObjLoader::GetTexcoords() const
+{
+	return m_pTexcoords;
+}
+
+const ObjLoader::QuantizedVertex *ObjLoader::GetQuantizedVertices() const
+{
+	return m_vQuantizedVertices.empty() ? nullptr : m_vQuantizedVertices.data();
 }
 
 const ObjLoader::float3 &ObjLoader::GetCenter() const
@@ -71,284 +281,662 @@ const float ObjLoader::GetRadius() const
 	return m_fRadius;
 }
 
-void ObjLoader::importGeometryFirstPass(FILE *pFile)
+const ObjLoader::float3 &ObjLoader::GetExtent() const
 {
-	auto v = 0u;
-	auto vt = 0u;
-	auto vn = 0u;
-	char buffer[256] = { 0 };
+	return m_vExtent;
+}
 
-	auto uNumVert = 0u;
-	auto uNumTri = 0u;
-	auto bHasTexcoord = false;
-	auto bHasNormal = false;
+bool ObjLoader::importCache(const char *pszFilename, uint32_t uFlags)
+{
+	uint64_t uSourceSize, uSourceTime;
+	if (!MappedFile::Stat(pszFilename, uSourceSize, uSourceTime)) return false;
+
+	const auto pCache = make_shared<MappedFile>();
+	if (!pCache->Open((string(pszFilename) + CACHE_FILE_EXT).c_str())) return false;
+	if (pCache->GetSize() < sizeof(CacheHeader)) return false;
+
+	// Validate the header against the current build and the import options
+	const auto &header = *reinterpret_cast<const CacheHeader*>(pCache->GetData());
+	const auto uVertexBytes = static_cast<uint64_t>(header.uNumVertices) * sizeof(Vertex);
+	const auto uIndexBytes = static_cast<uint64_t>(header.uNumIndices) * sizeof(uint32_t);
+	if (header.uMagic != CACHE_MAGIC || header.uVersion != CACHE_VERSION) return false;
+	if (header.uFlags != uFlags || header.uVertexStride != sizeof(Vertex)) return false;
+	if (header.uSourceSize != uSourceSize) return false;
+	if (header.uVertexOffset != sizeof(CacheHeader)) return false;
+	if (header.uIndexOffset != header.uVertexOffset + uVertexBytes) return false;
+	if (header.uIndexOffset + uIndexBytes > pCache->GetSize()) return false;
+	if (header.uTexcoordOffset && (header.uTexcoordOffset != header.uIndexOffset + uIndexBytes ||
+		header.uTexcoordOffset + header.uNumVertices * sizeof(float2) > pCache->GetSize())) return false;
+
+	// A touched but unchanged source is still accepted by its content hash
+	if (header.uSourceTime != uSourceTime)
+	{
+		MappedFile source;
+		if (!source.Open(pszFilename)) return false;
+		if (hashData(source.GetData(), source.GetSize(), m_scheduler) != header.uSourceHash) return false;
+	}
 
-	while (fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer))) != EOF)
+	// Zero-copy: hand out pointers into the mapping
+	m_pCache = pCache;
+	m_pVertices = reinterpret_cast<const Vertex*>(pCache->GetData() + header.uVertexOffset);
+	m_pIndices = reinterpret_cast<const uint32_t*>(pCache->GetData() + header.uIndexOffset);
+	m_pTexcoords = header.uTexcoordOffset ? reinterpret_cast<const float2*>(pCache->GetData() + header.uTexcoordOffset) : nullptr;
+	m_uNumVertices = header.uNumVertices;
+	m_uNumIndices = header.uNumIndices;
+	m_vCenter = header.vCenter;
+	m_fRadius = header.fRadius;
+	m_vExtent = header.vExtent;
+
+	vVertex().swap(m_vVertices);
+	vuint().swap(m_vIndices);
+	vfloat2().swap(m_vTexcoords);
+	vuint().swap(m_vTIndices);
+	vuint().swap(m_vNIndices);
+
+	return true;
+}
+
+void ObjLoader::exportCache(const char *pszFilename, uint32_t uFlags, uint64_t uSourceHash) const
+{
+	CacheHeader header = {};
+	header.uMagic = CACHE_MAGIC;
+	header.uVersion = CACHE_VERSION;
+	header.uFlags = uFlags;
+	header.uVertexStride = sizeof(Vertex);
+	header.uNumVertices = m_uNumVertices;
+	header.uNumIndices = m_uNumIndices;
+	header.vCenter = m_vCenter;
+	header.fRadius = m_fRadius;
+	header.vExtent = m_vExtent;
+	header.uSourceHash = uSourceHash;
+	header.uVertexOffset = sizeof(CacheHeader);
+	header.uIndexOffset = header.uVertexOffset + static_cast<uint64_t>(m_uNumVertices) * sizeof(Vertex);
+	header.uTexcoordOffset = m_pTexcoords ? header.uIndexOffset + static_cast<uint64_t>(m_uNumIndices) * sizeof(uint32_t) : 0;
+	if (!MappedFile::Stat(pszFilename, header.uSourceSize, header.uSourceTime)) return;
+
+	// Write to a temporary file first so that readers never see a partial cache
+	const auto cacheName = string(pszFilename) + CACHE_FILE_EXT;
+	const auto tempName = cacheName + ".tmp";
 	{
-		switch (buffer[0])
+		ofstream file(tempName, ios::binary | ios::trunc);
+		if (!file) return;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+		file.write(reinterpret_cast<const char*>(m_pVertices), sizeof(Vertex) * m_uNumVertices);
+		file.write(reinterpret_cast<const char*>(m_pIndices), sizeof(uint32_t) * m_uNumIndices);
+		if (m_pTexcoords) file.write(reinterpret_cast<const char*>(m_pTexcoords), sizeof(float2) * m_uNumVertices);
+		if (!file.good())
 		{
-		case 'f':   // v, v//vn, v/vt, v/vt/vn.
-			fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer)));
+			file.close();
+			remove(tempName.c_str());
 
-			if (strstr(buffer, "//")) // v//vn
-			{
-				sscanf_s(buffer, "%u//%u", &v, &vn);
-				fscanf_s(pFile, "%u//%u", &v, &vn);
-				fscanf_s(pFile, "%u//%u", &v, &vn);
-				++uNumTri;
+			return;
+		}
+	}
 
-				while (fscanf_s(pFile, "%u//%u", &v, &vn) > 0) ++uNumTri;
+	// The cache is optional; silently give up if the directory is read-only
+	remove(cacheName.c_str());
+	if (rename(tempName.c_str(), cacheName.c_str()) != 0) remove(tempName.c_str());
+}
 
-				bHasNormal = true;
-			}
-			else if (sscanf_s(buffer, "%u/%u/%u", &v, &vt, &vn) == 3) // v/vt/vn
-			{
-				fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn);
-				fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn);
-				++uNumTri;
+void ObjLoader::importGeometry(const char *pData, size_t uSize, bool &bHasNormals)
+{
+	// Split the file into newline-aligned chunks
+	const auto uNumChunks = static_cast<uint32_t>(max<size_t>(min<size_t>(uSize / CHUNK_SIZE_MIN,
+		m_scheduler.GetNumWorkers() * 4), 1));
+	const auto pEnd = pData + uSize;
+	vector<const char*> vChunkBegs(uNumChunks + 1);
+	vChunkBegs[0] = pData;
+	vChunkBegs[uNumChunks] = pEnd;
+	for (auto i = 1u; i < uNumChunks; ++i)
+	{
+		auto p = max(pData + uSize * i / uNumChunks, vChunkBegs[i - 1]);
+		while (p < pEnd && p > pData && p[-1] != '\n') ++p;
+		vChunkBegs[i] = p;
+	}
 
-				while (fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn) > 0) ++uNumTri;
+	// Parse the chunks in parallel
+	vector<Chunk> vChunks(uNumChunks);
+	m_scheduler.ParallelFor(0, uNumChunks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+			parseChunk(vChunkBegs[i], vChunkBegs[i + 1], vChunks[i]);
+	});
+
+	// Compute the chunk offsets
+	vector<uint32_t> vVertBases(uNumChunks), vIdxBases(uNumChunks);
+	vector<uint32_t> vTexBases(uNumChunks), vNrmBases(uNumChunks);
+	auto uNumVert = 0u, uNumIdx = 0u, uNumTex = 0u, uNumNrm = 0u;
+	auto bHasTexcoord = false;
+	auto bHasNormal = false;
+	for (auto i = 0u; i < uNumChunks; ++i)
+	{
+		const auto &chunk = vChunks[i];
+		vVertBases[i] = uNumVert;
+		vIdxBases[i] = uNumIdx;
+		vTexBases[i] = uNumTex;
+		vNrmBases[i] = uNumNrm;
+		uNumVert += static_cast<uint32_t>(chunk.vPositions.size());
+		uNumIdx += static_cast<uint32_t>(chunk.vIndices.size());
+		uNumTex += static_cast<uint32_t>(chunk.vTexcoords.size());
+		uNumNrm += static_cast<uint32_t>(chunk.vNormals.size());
+		bHasTexcoord = bHasTexcoord || !chunk.vTIndices.empty();
+		bHasNormal = bHasNormal || !chunk.vNIndices.empty();
+	}
 
-				bHasTexcoord = true;
-				bHasNormal = true;
-			}
-			else if (sscanf_s(buffer, "%u/%u", &v, &vt) == 2) // v/vt
-			{
-				fscanf_s(pFile, "%u/%u", &v, &vt);
-				fscanf_s(pFile, "%u/%u", &v, &vt);
-				++uNumTri;
+	// Allocate memory for the OBJ model data.
+	VEC_ALLOC(m_vVertices, uNumVert);
+	VEC_ALLOC(m_vIndices, uNumIdx);
+	if (bHasTexcoord) VEC_ALLOC(m_vTIndices, uNumIdx);
+	if (bHasNormal) VEC_ALLOC(m_vNIndices, uNumIdx);
 
-				while (fscanf_s(pFile, "%u/%u", &v, &vt) > 0) ++uNumTri;
+	// Attributes are only kept if some face refers to them
+	vfloat2 vTexcoords(bHasTexcoord ? uNumTex : 0);
+	vfloat3 vNormals(bHasNormal ? uNumNrm : 0);
 
-				bHasTexcoord = true;
-			}
-			else // v
-			{
-				fscanf_s(pFile, "%u", &v);
-				fscanf_s(pFile, "%u", &v);
-				++uNumTri;
+	// Gather the chunks and resolve the relative indices
+	const auto gather = [](vuint &vDst, const vuint &vSrc, const vuint &vFixups, uint32_t uIdxBase,
+		uint32_t uBase, size_t uNumIdx)
+	{
+		if (vSrc.empty()) fill_n(vDst.begin() + uIdxBase, uNumIdx, UINT32_MAX);
+		else copy(vSrc.cbegin(), vSrc.cend(), vDst.begin() + uIdxBase);
+		for (const auto &i : vFixups) vDst[uIdxBase + i] += uBase;
+	};
 
-				while (fscanf_s(pFile, "%u", &v) > 0)
-					++uNumTri;
-			}
-			break;
+	m_scheduler.ParallelFor(0, uNumChunks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			auto &chunk = vChunks[i];
+			for (size_t j = 0; j < chunk.vPositions.size(); ++j)
+				m_vVertices[vVertBases[i] + j].m_vPosition = chunk.vPositions[j];
+			if (bHasTexcoord) copy(chunk.vTexcoords.cbegin(), chunk.vTexcoords.cend(), vTexcoords.begin() + vTexBases[i]);
+			if (bHasNormal) copy(chunk.vNormals.cbegin(), chunk.vNormals.cend(), vNormals.begin() + vNrmBases[i]);
+
+			const auto uNumChunkIdx = chunk.vIndices.size();
+			gather(m_vIndices, chunk.vIndices, chunk.vIndexFixups, vIdxBases[i], vVertBases[i], uNumChunkIdx);
+			if (bHasTexcoord) gather(m_vTIndices, chunk.vTIndices, chunk.vTIndexFixups, vIdxBases[i], vTexBases[i], uNumChunkIdx);
+			if (bHasNormal) gather(m_vNIndices, chunk.vNIndices, chunk.vNIndexFixups, vIdxBases[i], vNrmBases[i], uNumChunkIdx);
+
+			chunk = Chunk();
+		}
+	});
 
-		case 'v':   // v, vt, or vn
-			switch (buffer[1])
-			{
-			case '\0':
-				fgets(buffer, sizeof(buffer), pFile);
-				++uNumVert;
-				break;
-			default:
-				break;
-			}
-			break;
+	// Drop the faces referring to positions past the end, with their attribute indices
+	auto uNumKept = 0u;
+	for (auto i = 0u; i + 3 <= uNumIdx; i += 3)
+	{
+		if (m_vIndices[i] >= uNumVert || m_vIndices[i + 1] >= uNumVert || m_vIndices[i + 2] >= uNumVert) continue;
+		if (uNumKept != i)
+		{
+			copy_n(&m_vIndices[i], 3, &m_vIndices[uNumKept]);
+			if (bHasTexcoord) copy_n(&m_vTIndices[i], 3, &m_vTIndices[uNumKept]);
+			if (bHasNormal) copy_n(&m_vNIndices[i], 3, &m_vNIndices[uNumKept]);
+		}
+		uNumKept += 3;
+	}
+	if (uNumKept != uNumIdx)
+	{
+		m_vIndices.resize(uNumKept);
+		if (bHasTexcoord) m_vTIndices.resize(uNumKept);
+		if (bHasNormal) m_vNIndices.resize(uNumKept);
+	}
+
+	// Split the vertices by attribute so that a single index addresses all of them
+	vfloat2().swap(m_vTexcoords);
+	bHasNormals = (bHasTexcoord || bHasNormal) && deindex(vTexcoords, vNormals);
+	vuint().swap(m_vTIndices);
+	vuint().swap(m_vNIndices);
+}
+
+bool ObjLoader::deindex(const vfloat2 &vTexcoords, const vfloat3 &vNormals)
+{
+	// Vertex cache keyed by the position index: each position heads a short chain of the
+	// unified vertices sharing it, told apart by their texcoord and normal indices
+	const auto uNumPos = static_cast<uint32_t>(m_vVertices.size());
+	const auto uNumTex = static_cast<uint32_t>(vTexcoords.size());
+	const auto uNumNrm = static_cast<uint32_t>(vNormals.size());
+	const auto uNumIdx = static_cast<uint32_t>(m_vIndices.size());
+
+	vuint vHeads(uNumPos, UINT32_MAX);
+	vuint vNexts, vKeyT, vKeyN;
+	vVertex vVertices;
+	vNexts.reserve(uNumPos);
+	vKeyT.reserve(uNumPos);
+	vKeyN.reserve(uNumPos);
+	vVertices.reserve(uNumPos);
+	if (uNumTex) m_vTexcoords.reserve(uNumPos);
+
+	// Positions are in range: importGeometry() has dropped the faces past them
+	auto bHasNormals = true;
+	for (auto i = 0u; i < uNumIdx; ++i)
+	{
+		// Out-of-range attribute indices count as missing
+		const auto uPos = m_vIndices[i];
+		const auto uTex = uNumTex && m_vTIndices[i] < uNumTex ? m_vTIndices[i] : UINT32_MAX;
+		const auto uNrm = uNumNrm && m_vNIndices[i] < uNumNrm ? m_vNIndices[i] : UINT32_MAX;
+		bHasNormals = bHasNormals && uNrm != UINT32_MAX;
 
-		default:
-			fgets(buffer, sizeof(buffer), pFile);
-			break;
+		auto uVert = vHeads[uPos];
+		while (uVert != UINT32_MAX && (vKeyT[uVert] != uTex || vKeyN[uVert] != uNrm)) uVert = vNexts[uVert];
+
+		if (uVert == UINT32_MAX)
+		{
+			uVert = static_cast<uint32_t>(vVertices.size());
+			vNexts.push_back(vHeads[uPos]);
+			vKeyT.push_back(uTex);
+			vKeyN.push_back(uNrm);
+			vHeads[uPos] = uVert;
+
+			// File normals are not guaranteed to be unit length
+			Vertex vertex;
+			vertex.m_vPosition = m_vVertices[uPos].m_vPosition;
+			vertex.m_vNormal = uNrm != UINT32_MAX ? vNormals[uNrm] : float3(0.0f, 0.0f, 0.0f);
+			const auto &n = vertex.m_vNormal;
+			const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			if (l > 0.0f) vertex.m_vNormal = float3(n.x / l, n.y / l, n.z / l);
+			vVertices.push_back(vertex);
+			if (uNumTex) m_vTexcoords.push_back(uTex != UINT32_MAX ? vTexcoords[uTex] : float2(0.0f, 0.0f));
 		}
+
+		m_vIndices[i] = uVert;
 	}
 
-	// Allocate memory for the OBJ model data.
-	const auto uNumIdx = uNumTri * 3;
-	VEC_ALLOC(m_vVertices, uNumVert);
-	VEC_ALLOC(m_vIndices, uNumIdx);
-	if (bHasTexcoord) VEC_ALLOC(m_vTIndices, uNumIdx);
-	if (bHasNormal) VEC_ALLOC(m_vNIndices, uNumIdx);
+	m_vVertices.swap(vVertices);
+
+	return bHasNormals && uNumNrm > 0;
 }
 
-void ObjLoader::importGeometrySecondPass(FILE *pFile)
+void ObjLoader::parseChunk(const char *p, const char *pEnd, Chunk &chunk)
 {
-	auto uNumVert = 0u;
-	auto uNumTri = 0u;
-	char buffer[256] = { 0 };
+	// Rough estimate from bytes per line to avoid most reallocations
+	chunk.vPositions.reserve((pEnd - p) / 64);
+	chunk.vIndices.reserve((pEnd - p) / 32);
 
-	while (fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer))) != EOF)
+	while (p < pEnd)
 	{
-		switch (buffer[0])
+		p = skipSpaces(p, pEnd);
+		if (p + 1 < pEnd)
 		{
-		case 'f': // v, v//vn, v/vt, or v/vt/vn.
-			loadIndex(pFile, uNumTri);
-			break;
-		case 'v': // v, vn, or vt.
-			switch (buffer[1])
+			switch (p[0])
 			{
-			case '\0': // v
-				fscanf_s(pFile, "%f %f %f",
-					&m_vVertices[uNumVert].m_vPosition.x,
-					&m_vVertices[uNumVert].m_vPosition.y,
-					&m_vVertices[uNumVert].m_vPosition.z);
-				++uNumVert;
+			case 'f': // v, v//vn, v/vt, or v/vt/vn.
+				if (isSpace(p[1])) p = loadIndex(p + 1, pEnd, chunk);
 				break;
-			default:
+			case 'v': // v, vn, or vt.
+				switch (p[1])
+				{
+				case 't':
+					if (p + 2 < pEnd && isSpace(p[2]))
+					{
+						// A third (w) component is ignored
+						float2 vTex;
+						p = parseFloat(p + 2, pEnd, vTex.x);
+						p = parseFloat(p, pEnd, vTex.y);
+						chunk.vTexcoords.push_back(vTex);
+					}
+					break;
+				case 'n':
+					if (p + 2 < pEnd && isSpace(p[2]))
+					{
+						float3 vNrm;
+						p = parseFloat(p + 2, pEnd, vNrm.x);
+						p = parseFloat(p, pEnd, vNrm.y);
+						p = parseFloat(p, pEnd, vNrm.z);
+						chunk.vNormals.push_back(vNrm);
+					}
+					break;
+				default:
+					if (isSpace(p[1]))
+					{
+						float3 vPos;
+						p = parseFloat(p + 1, pEnd, vPos.x);
+						p = parseFloat(p, pEnd, vPos.y);
+						p = parseFloat(p, pEnd, vPos.z);
+						chunk.vPositions.push_back(vPos);
+					}
+				}
 				break;
 			}
-			break;
-
-		default:
-			fgets(buffer, sizeof(buffer), pFile);
-			break;
 		}
+		p = skipLine(p, pEnd);
 	}
 }
 
-void ObjLoader::loadIndex(FILE *pFile, uint32_t &uNumTri)
+const char *ObjLoader::loadIndex(const char *p, const char *pEnd, Chunk &chunk)
 {
 	uint32_t v[3] = { 0 };
 	uint32_t vt[3] = { 0 };
 	uint32_t vn[3] = { 0 };
+	uint8_t flags[3] = { 0 };
 
-	const auto uNumVert = static_cast<uint32_t>(m_vVertices.size());
+	const auto uNumVert = static_cast<uint32_t>(chunk.vPositions.size());
+
+	// Positive indices are global, negative ones are relative to this chunk until gathered
+	const auto resolve = [](int64_t i, uint32_t uCount, uint32_t &uIdx, uint8_t &uFlags, uint8_t present, uint8_t relative)
+	{
+		if (i == 0) return;
+		uIdx = i > 0 ? static_cast<uint32_t>(i - 1) : static_cast<uint32_t>(uCount + i);
+		uFlags |= i > 0 ? present : present | relative;
+	};
 
-	for (auto i = 0ui8; i < 3u; ++i)
+	const auto emit = [&chunk](uint32_t uIdx, uint32_t uTIdx, uint32_t uNIdx, uint8_t flags)
 	{
-		fscanf_s(pFile, "%u", &v[i]);
-		v[i] = (v[i] < 0) ? v[i] + uNumVert - 1 : v[i] - 1;
-		m_vIndices[uNumTri * 3 + i] = v[i];
+		const auto uPos = static_cast<uint32_t>(chunk.vIndices.size());
+		chunk.vIndices.push_back(uIdx);
+		if (flags & REL_V) chunk.vIndexFixups.push_back(uPos);
 
-		if (m_vTIndices.size() > 0)
+		if ((flags & HAS_VT) || !chunk.vTIndices.empty())
 		{
-			fscanf_s(pFile, "/%u", &vt[i]);
-			vt[i] = (vt[i] < 0) ? vt[i] + uNumVert - 1 : vt[i] - 1;
-			m_vTIndices[uNumTri * 3 + i] = vt[i];
+			chunk.vTIndices.resize(uPos, UINT32_MAX);
+			chunk.vTIndices.push_back(flags & HAS_VT ? uTIdx : UINT32_MAX);
+			if (flags & REL_VT) chunk.vTIndexFixups.push_back(uPos);
 		}
-		else if (m_vNIndices.size() > 0) fscanf_s(pFile, "/");
 
-		if (m_vNIndices.size() > 0)
+		if ((flags & HAS_VN) || !chunk.vNIndices.empty())
 		{
-			fscanf_s(pFile, "/%u", &vn[i]);
-			vn[i] = (vn[i] < 0) ? vn[i] + uNumVert - 1 : vn[i] - 1;
-			m_vNIndices[uNumTri * 3 + i] = vn[i];
+			chunk.vNIndices.resize(uPos, UINT32_MAX);
+			chunk.vNIndices.push_back(flags & HAS_VN ? uNIdx : UINT32_MAX);
+			if (flags & REL_VN) chunk.vNIndexFixups.push_back(uPos);
 		}
-	}
-	++uNumTri;
-
-	v[1] = v[2];
-	vt[1] = vt[2];
-	vn[1] = vn[2];
+	};
 
-	while (fscanf_s(pFile, "%u", &v[2]) > 0)
+	// Triangulate polygons as fans
+	for (auto i = 0u; ; ++i)
 	{
-		v[2] = (v[2] < 0) ? v[2] + uNumVert - 1 : v[2] - 1;
-		m_vIndices[uNumTri * 3] = v[0];
-		m_vIndices[uNumTri * 3 + 1] = v[1];
-		m_vIndices[uNumTri * 3 + 2] = v[2];
-		v[1] = v[2];
+		p = skipSpaces(p, pEnd);
+		if (p >= pEnd || !(isDigit(*p) || *p == '-' || *p == '+')) break;
 
-		if (m_vTIndices.size() > 0)
+		int64_t iv = 0, ivt = 0, ivn = 0;
+		p = parseInt(p, pEnd, iv);
+		if (p < pEnd && *p == '/')
 		{
-			fscanf_s(pFile, "/%u", &vt[2]);
-			vt[2] = (vt[2] < 0) ? vt[2] + uNumVert - 1 : vt[2] - 1;
-			m_vTIndices[uNumTri * 3] = vt[0];
-			m_vTIndices[uNumTri * 3 + 1] = vt[1];
-			m_vTIndices[uNumTri * 3 + 2] = vt[2];
-			vt[1] = vt[2];
+			if (++p < pEnd && *p != '/') p = parseInt(p, pEnd, ivt);
+			if (p < pEnd && *p == '/') p = parseInt(p + 1, pEnd, ivn);
 		}
-		else if (m_vNIndices.size() > 0) fscanf_s(pFile, "/");
 
-		if (m_vNIndices.size() > 0)
+		const auto k = i < 3 ? i : 2;
+		if (i >= 3)
 		{
-			fscanf_s(pFile, "/%u", &vn[2]);
-			vn[2] = (vn[2] < 0) ? vn[2] + uNumVert - 1 : vn[2] - 1;
-			m_vNIndices[uNumTri * 3] = vn[0];
-			m_vNIndices[uNumTri * 3 + 1] = vn[1];
-			m_vNIndices[uNumTri * 3 + 2] = vn[2];
+			v[1] = v[2];
+			vt[1] = vt[2];
 			vn[1] = vn[2];
+			flags[1] = flags[2];
 		}
 
-		++uNumTri;
+		flags[k] = 0;
+		resolve(iv, uNumVert, v[k], flags[k], HAS_V, REL_V);
+		resolve(ivt, static_cast<uint32_t>(chunk.vTexcoords.size()), vt[k], flags[k], HAS_VT, REL_VT);
+		resolve(ivn, static_cast<uint32_t>(chunk.vNormals.size()), vn[k], flags[k], HAS_VN, REL_VN);
+
+		if (i >= 2)
+			for (auto j = 0u; j < 3; ++j)
+				emit(v[j], vt[j], vn[j], flags[j]);
 	}
+
+	return p;
 }
 
 void ObjLoader::computeNormal()
 {
-	float3 e1, e2, n;
+	const auto uNumTri = static_cast<uint32_t>(m_vIndices.size()) / 3;
+	const auto uNumVert = static_cast<uint32_t>(m_vVertices.size());
 
-	/*for (i = 0; i < pMesh->m_iNumVert; ++i)
+	// Unit face normals of a range, 4 triangles at a time with the corner positions transposed
+	// to SoA. Ranges always start on a grain boundary so that both paths below agree bitwise.
+	const auto computeFaceNormals = [this](uint32_t uBeg, uint32_t uEnd, float3 *pNormals)
 	{
-		m_vVertices.m_vNormal.x = 0;
-		m_vVertices.m_vNormal.y = 0;
-		m_vVertices.m_vNormalm_vNormal.z = 0;
-	}*/
-	const auto uNumTri = static_cast<uint32_t>(m_vIndices.size()) / 3;
-	for (auto i = 0u; i < uNumTri; i++)
-	{
-		const auto pv0 = &m_vVertices[m_vIndices[i * 3]].m_vPosition;
-		const auto pv1 = &m_vVertices[m_vIndices[i * 3 + 1]].m_vPosition;
-		const auto pv2 = &m_vVertices[m_vIndices[i * 3 + 2]].m_vPosition;
-		e1.x = pv1->x - pv0->x;
-		e1.y = pv1->y - pv0->y;
-		e1.z = pv1->z - pv0->z;
-		e2.x = pv2->x - pv1->x;
-		e2.y = pv2->y - pv1->y;
-		e2.z = pv2->z - pv1->z;
-		n.x = e1.y * e2.z - e1.z * e2.y;
-		n.y = e1.z * e2.x - e1.x * e2.z;
-		n.z = e1.x * e2.y - e1.y * e2.x;
-		const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
-		n.x /= l;
-		n.y /= l;
-		n.z /= l;
-
-		const auto pvn0 = &m_vVertices[m_vIndices[i * 3]].m_vNormal;
-		const auto pvn1 = &m_vVertices[m_vIndices[i * 3 + 1]].m_vNormal;
-		const auto pvn2 = &m_vVertices[m_vIndices[i * 3 + 2]].m_vNormal;
-		pvn0->x += n.x;
-		pvn0->y += n.y;
-		pvn0->z += n.z;
-		pvn1->x += n.x;
-		pvn1->y += n.y;
-		pvn1->z += n.z;
-		pvn2->x += n.x;
-		pvn2->y += n.y;
-		pvn2->z += n.z;
+		auto i = uBeg;
+		for (; i + 4 <= uEnd; i += 4)
+		{
+			__m128 v[3][3];	// Corner, axis
+			for (auto j = 0u; j < 3; ++j)
+			{
+				const auto &p0 = m_vVertices[m_vIndices[i * 3 + j]].m_vPosition;
+				const auto &p1 = m_vVertices[m_vIndices[i * 3 + 3 + j]].m_vPosition;
+				const auto &p2 = m_vVertices[m_vIndices[i * 3 + 6 + j]].m_vPosition;
+				const auto &p3 = m_vVertices[m_vIndices[i * 3 + 9 + j]].m_vPosition;
+				v[j][0] = _mm_setr_ps(p0.x, p1.x, p2.x, p3.x);
+				v[j][1] = _mm_setr_ps(p0.y, p1.y, p2.y, p3.y);
+				v[j][2] = _mm_setr_ps(p0.z, p1.z, p2.z, p3.z);
+			}
+
+			__m128 e1[3], e2[3];
+			for (auto k = 0u; k < 3; ++k)
+			{
+				e1[k] = _mm_sub_ps(v[1][k], v[0][k]);
+				e2[k] = _mm_sub_ps(v[2][k], v[1][k]);
+			}
+			auto nx = _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1]));
+			auto ny = _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2]));
+			auto nz = _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0]));
+
+			// Degenerate triangles contribute nothing
+			const auto l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+			const auto valid = _mm_cmpgt_ps(l, _mm_setzero_ps());
+			nx = _mm_and_ps(_mm_div_ps(nx, l), valid);
+			ny = _mm_and_ps(_mm_div_ps(ny, l), valid);
+			nz = _mm_and_ps(_mm_div_ps(nz, l), valid);
+
+			// Back to AoS for the accumulation, which reads one face at a time
+			float fnx[4], fny[4], fnz[4];
+			_mm_storeu_ps(fnx, nx);
+			_mm_storeu_ps(fny, ny);
+			_mm_storeu_ps(fnz, nz);
+			for (auto k = 0u; k < 4; ++k) pNormals[i - uBeg + k] = float3(fnx[k], fny[k], fnz[k]);
+		}
+
+		for (; i < uEnd; ++i)
+		{
+			const auto &v0 = m_vVertices[m_vIndices[i * 3]].m_vPosition;
+			const auto &v1 = m_vVertices[m_vIndices[i * 3 + 1]].m_vPosition;
+			const auto &v2 = m_vVertices[m_vIndices[i * 3 + 2]].m_vPosition;
+			const float3 e1(v1.x - v0.x, v1.y - v0.y, v1.z - v0.z);
+			const float3 e2(v2.x - v1.x, v2.y - v1.y, v2.z - v1.z);
+			const float3 n(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+			const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			pNormals[i - uBeg] = l > 0.0f ? float3(n.x / l, n.y / l, n.z / l) : float3(0.0f, 0.0f, 0.0f);
+		}
+	};
+
+	const auto accumulate = [this](uint32_t uCorner, const float3 &fn)
+	{
+		auto &n = m_vVertices[m_vIndices[uCorner]].m_vNormal;
+		n.x += fn.x;
+		n.y += fn.y;
+		n.z += fn.z;
+	};
+
+	const auto normalize = [this](uint32_t uVertBeg, uint32_t uVertEnd)
+	{
+		for (auto i = uVertBeg; i < uVertEnd; ++i)
+		{
+			auto &n = m_vVertices[i].m_vNormal;
+			const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			if (l > 0.0f) n = float3(n.x / l, n.y / l, n.z / l);
+		}
+	};
+
+	// A single worker sums in face order directly, one grain of face normals at a time;
+	// the buckets below keep that order
+	const auto uNumCorners = uNumTri * 3;
+	const auto uNumGrains = (uNumTri + FACE_GRAIN_SIZE - 1) / FACE_GRAIN_SIZE;
+	if (m_scheduler.GetNumWorkers() == 1)
+	{
+		for (auto &vertex : m_vVertices) vertex.m_vNormal = float3(0.0f, 0.0f, 0.0f);
+
+		vector<float3> vFaceNormals(FACE_GRAIN_SIZE);
+		for (auto g = 0u; g < uNumGrains; ++g)
+		{
+			const auto uBeg = g * FACE_GRAIN_SIZE;
+			const auto uEnd = min(uBeg + FACE_GRAIN_SIZE, uNumTri);
+			computeFaceNormals(uBeg, uEnd, vFaceNormals.data());
+			for (auto j = uBeg * 3; j < uEnd * 3; ++j) accumulate(j, vFaceNormals[j / 3 - uBeg]);
+		}
+		normalize(0, uNumVert);
+
+		return;
 	}
 
-	const auto uNumVert = static_cast<uint32_t>(m_vVertices.size());
-	for (auto i = 0u; i < uNumVert; ++i)
+	vector<float3> vFaceNormals(uNumTri);
+	m_scheduler.ParallelFor(0, uNumGrains, 1, [&](uint32_t begin, uint32_t end, uint32_t)
 	{
-		const auto pn = &m_vVertices[i].m_vNormal;
-		const auto l = sqrt(pn->x * pn->x + pn->y * pn->y + pn->z * pn->z);
-		pn->x /= l;
-		pn->y /= l;
-		pn->z /= l;
+		for (auto g = begin; g < end; ++g)
+		{
+			const auto uBeg = g * FACE_GRAIN_SIZE;
+			computeFaceNormals(uBeg, min(uBeg + FACE_GRAIN_SIZE, uNumTri), &vFaceNormals[uBeg]);
+		}
+	});
+
+	// Counting sort of the corners into buckets of consecutive vertices, stable across the
+	// corner blocks, so that each bucket lists the faces of its vertices in face order
+	const auto uNumBlocks = max((uNumCorners + CORNER_BLOCK_SIZE - 1) / CORNER_BLOCK_SIZE, 1u);
+	const auto uNumBuckets = max((uNumVert + (1 << VERTEX_BUCKET_BITS) - 1) >> VERTEX_BUCKET_BITS, 1u);
+
+	vuint vBucketOffsets(static_cast<size_t>(uNumBlocks) * uNumBuckets);
+	m_scheduler.ParallelFor(0, uNumBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pCounts = &vBucketOffsets[static_cast<size_t>(i) * uNumBuckets];
+			const auto uEnd = min((i + 1) * CORNER_BLOCK_SIZE, uNumCorners);
+			for (auto j = i * CORNER_BLOCK_SIZE; j < uEnd; ++j) ++pCounts[m_vIndices[j] >> VERTEX_BUCKET_BITS];
+		}
+	});
+
+	// Bucket-major exclusive scan
+	vuint vBucketBases(uNumBuckets + 1);
+	auto uSum = 0u;
+	for (auto b = 0u; b < uNumBuckets; ++b)
+	{
+		vBucketBases[b] = uSum;
+		for (auto i = 0u; i < uNumBlocks; ++i)
+		{
+			auto &uOffset = vBucketOffsets[static_cast<size_t>(i) * uNumBuckets + b];
+			const auto uCount = uOffset;
+			uOffset = uSum;
+			uSum += uCount;
+		}
 	}
+	vBucketBases[uNumBuckets] = uSum;
+
+	vuint vCorners(uNumCorners);
+	m_scheduler.ParallelFor(0, uNumBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pOffsets = &vBucketOffsets[static_cast<size_t>(i) * uNumBuckets];
+			const auto uEnd = min((i + 1) * CORNER_BLOCK_SIZE, uNumCorners);
+			for (auto j = i * CORNER_BLOCK_SIZE; j < uEnd; ++j) vCorners[pOffsets[m_vIndices[j] >> VERTEX_BUCKET_BITS]++] = j;
+		}
+	});
+
+	// Gather per bucket; a bucket's vertices stay in cache, and the sums are in face order
+	// whatever the thread count
+	m_scheduler.ParallelFor(0, uNumBuckets, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			const auto uVertBeg = min(b << VERTEX_BUCKET_BITS, uNumVert);
+			const auto uVertEnd = min(uVertBeg + (1 << VERTEX_BUCKET_BITS), uNumVert);
+			for (auto i = uVertBeg; i < uVertEnd; ++i) m_vVertices[i].m_vNormal = float3(0.0f, 0.0f, 0.0f);
+			for (auto j = vBucketBases[b]; j < vBucketBases[b + 1]; ++j)
+			{
+				const auto uCorner = vCorners[j];
+				accumulate(uCorner, vFaceNormals[uCorner / 3]);
+			}
+			normalize(uVertBeg, uVertEnd);
+		}
+	});
 }
 
 void ObjLoader::computeBound()
 {
-	float xMax, xMin, yMax, yMin, zMax, zMin;
-	xMax = xMin = m_vVertices[0].m_vPosition.x;
-	yMax = yMin = m_vVertices[0].m_vPosition.y;
-	zMax = zMin = m_vVertices[0].m_vPosition.z;
+	// Per-grain SSE min/max over the positions, reduced serially; lane w is ignored.
+	// Loading 4 floats from a position stays inside the vertex since the normal follows.
+	const auto uNumVert = static_cast<uint32_t>(m_vVertices.size());
+	const auto uNumGrains = (uNumVert + BOUND_GRAIN_SIZE - 1) / BOUND_GRAIN_SIZE;
+	vector<float> vMins(uNumGrains * 4), vMaxs(uNumGrains * 4);
+	m_scheduler.ParallelFor(0, uNumGrains, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto g = begin; g < end; ++g)
+		{
+			const auto uBeg = g * BOUND_GRAIN_SIZE;
+			const auto uEnd = min(uBeg + BOUND_GRAIN_SIZE, uNumVert);
+			const auto pPos = [this](uint32_t i) { return &m_vVertices[i].m_vPosition.x; };
+
+			// Two accumulator pairs to hide the latency; NaN positions are skipped by minps/maxps
+			auto vMin0 = _mm_set1_ps(FLT_MAX), vMax0 = _mm_set1_ps(-FLT_MAX);
+			auto vMin1 = vMin0, vMax1 = vMax0;
+			auto i = uBeg;
+			for (; i + 2 <= uEnd; i += 2)
+			{
+				const auto v0 = _mm_loadu_ps(pPos(i));
+				const auto v1 = _mm_loadu_ps(pPos(i + 1));
+				vMin0 = _mm_min_ps(v0, vMin0);
+				vMax0 = _mm_max_ps(v0, vMax0);
+				vMin1 = _mm_min_ps(v1, vMin1);
+				vMax1 = _mm_max_ps(v1, vMax1);
+			}
+			if (i < uEnd)
+			{
+				const auto v = _mm_loadu_ps(pPos(i));
+				vMin0 = _mm_min_ps(v, vMin0);
+				vMax0 = _mm_max_ps(v, vMax0);
+			}
 
-	auto x = 0.0f, y = 0.0f, z = 0.0f;
+			_mm_storeu_ps(&vMins[g * 4], _mm_min_ps(vMin0, vMin1));
+			_mm_storeu_ps(&vMaxs[g * 4], _mm_max_ps(vMax0, vMax1));
+		}
+	});
 
-	for (auto i = 1u; i < m_vVertices.size(); ++i)
+	auto vMin = _mm_set1_ps(FLT_MAX), vMax = _mm_set1_ps(-FLT_MAX);
+	for (auto g = 0u; g < uNumGrains; ++g)
 	{
-		x = m_vVertices[i].m_vPosition.x;
-		y = m_vVertices[i].m_vPosition.y;
-		z = m_vVertices[i].m_vPosition.z;
+		vMin = _mm_min_ps(_mm_loadu_ps(&vMins[g * 4]), vMin);
+		vMax = _mm_max_ps(_mm_loadu_ps(&vMaxs[g * 4]), vMax);
+	}
 
-		if (x < xMin) xMin = x;
-		else if (x > xMax) xMax = x;
+	float fMin[4], fMax[4];
+	_mm_storeu_ps(fMin, vMin);
+	_mm_storeu_ps(fMax, vMax);
 
-		if (y < yMin) yMin = y;
-		else if (y > yMax) yMax = y;
+	m_vCenter = float3((fMin[0] + fMax[0]) / 2.0f, (fMin[1] + fMax[1]) / 2.0f, (fMin[2] + fMax[2]) / 2.0f);
+	m_vExtent = float3((fMax[0] - fMin[0]) / 2.0f, (fMax[1] - fMin[1]) / 2.0f, (fMax[2] - fMin[2]) / 2.0f);
+	m_fRadius = max(max(m_vExtent.x, m_vExtent.y), m_vExtent.z);
+}
 
-		if (z < zMin) zMin = z;
-		else if (z > zMax) zMax = z;
-	}
+uint64_t ObjLoader::hashData(const uint8_t *pData, size_t uSize, TaskScheduler &scheduler)
+{
+	static const auto uPrime = 0x100000001b3ull;
 
-	m_vCenter.x = (xMin + xMax) / 2.0f;
-	m_vCenter.y = (yMin + yMax) / 2.0f;
-	m_vCenter.z = (zMin + zMax) / 2.0f;
+	// Hash fixed-size blocks in parallel, then combine them in order
+	const auto uNumBlocks = static_cast<uint32_t>((uSize + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE);
+	vector<uint64_t> vBlockHashes(uNumBlocks);
+	scheduler.ParallelFor(0, uNumBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pBlock = pData + static_cast<size_t>(i) * HASH_BLOCK_SIZE;
+			const auto uBlockSize = min<size_t>(HASH_BLOCK_SIZE, uSize - static_cast<size_t>(i) * HASH_BLOCK_SIZE);
+
+			// FNV-1a over 64-bit words, then over the tail bytes
+			auto uHash = 0xcbf29ce484222325ull;
+			size_t j = 0;
+			for (; j + sizeof(uint64_t) <= uBlockSize; j += sizeof(uint64_t))
+			{
+				uint64_t uWord;
+				memcpy(&uWord, &pBlock[j], sizeof(uint64_t));
+				uHash = (uHash ^ uWord) * uPrime;
+				uHash ^= uHash >> 29;
+			}
+			for (; j < uBlockSize; ++j) uHash = (uHash ^ pBlock[j]) * uPrime;
+			vBlockHashes[i] = uHash;
+		}
+	});
 
-	const auto fWidth = xMax - xMin;
-	const auto fHeight = yMax - yMin;
-	const auto fLength = zMax - zMin;
+	auto uHash = 0xcbf29ce484222325ull ^ uSize;
+	for (const auto &uBlockHash : vBlockHashes) uHash = (uHash ^ uBlockHash) * uPrime;
 
-	m_fRadius = max(max(fWidth, fHeight), fLength) * 0.5f;
+	return uHash;
 }
@@ -4,6 +4,10 @@
 
 #pragma once
 
+#include "TaskScheduler.h"
+
+class MappedFile;
+
 class ObjLoader
 {
 public:
@@ -20,41 +24,103 @@ public:
 		float3 &operator= (const float3& Float3) { x = Float3.x; y = Float3.y; z = Float3.z; return *this; }
 	};
 
+	struct float2
+	{
+		float x;
+		float y;
+
+		float2() = default;
+		constexpr float2(float _x, float _y) : x(_x), y(_y) {}
+	};
+
 	struct Vertex
 	{
 		float3	m_vPosition;
 		float3	m_vNormal;
 	};
 
+	// See VertexQuantizer
+	struct QuantizedVertex
+	{
+		uint16_t	m_uPosition[3];	// Unorm inside the bound
+		int16_t		m_iNormal[2];	// Octahedral snorm
+	};
+
 	using vVertex	= std::vector<Vertex>;
+	using vQuantizedVertex = std::vector<QuantizedVertex>;
 	using vuint		= std::vector<uint32_t>;
+	using vfloat2	= std::vector<float2>;
+	using vfloat3	= std::vector<float3>;
 
-	ObjLoader();
+	ObjLoader(TaskScheduler &scheduler = TaskScheduler::GetDefault());
 	virtual ~ObjLoader();
 
-	bool Import(const char *pszFilename, const bool bRecomputeNorm = true, const bool bNeedBound = true);
+	bool Import(const char *pszFilename, const bool bRecomputeNorm = true, const bool bNeedBound = true,
+		const bool bUseCache = false);
+
+	// Compresses the vertices inside the bound; fails unless imported with bNeedBound.
+	// Unless kept, the float vertices are released and GetVertices() returns null.
+	bool Quantize(const bool bKeepVertices = false);
 
 	const uint32_t GetNumVertices() const;
 	const uint32_t GetNumIndices() const;
 	const uint32_t GetVertexStride() const;
 	const uint8_t *GetVertices() const;
 	const uint32_t *GetIndices() const;
+	const float2 *GetTexcoords() const;	// Per vertex, or null if the file has no vt
+	const QuantizedVertex *GetQuantizedVertices() const;	// Null until quantized
 
 	const float3& GetCenter() const;
-	const float GetRadius() const;
+	const float GetRadius() const;		// Largest half extent
+	const float3& GetExtent() const;	// Half extents per axis
 
 protected:
-	void importGeometryFirstPass(FILE *pFile);
-	void importGeometrySecondPass(FILE *pFile);
-	void loadIndex(FILE *pFile, uint32_t &uNumTri);
+	// Geometry parsed from one newline-aligned range of the file
+	struct Chunk
+	{
+		vfloat3				vPositions;
+		vfloat2				vTexcoords;
+		vfloat3				vNormals;
+		vuint				vIndices;
+		vuint				vTIndices;
+		vuint				vNIndices;
+
+		// Relative (negative) indices resolved once the preceding chunks are counted
+		vuint				vIndexFixups;
+		vuint				vTIndexFixups;
+		vuint				vNIndexFixups;
+	};
+
+	bool importCache(const char *pszFilename, uint32_t uFlags);
+	void exportCache(const char *pszFilename, uint32_t uFlags, uint64_t uSourceHash) const;
+	void importGeometry(const char *pData, size_t uSize, bool &bHasNormals);
+	bool deindex(const vfloat2 &vTexcoords, const vfloat3 &vNormals);
+	void parseChunk(const char *pBeg, const char *pEnd, Chunk &chunk);
+	const char *loadIndex(const char *p, const char *pEnd, Chunk &chunk);
 	void computeNormal();
 	void computeBound();
 
+	static uint64_t hashData(const uint8_t *pData, size_t uSize, TaskScheduler &scheduler);
+
+	TaskScheduler	&m_scheduler;
+
 	vVertex		m_vVertices;
 	vuint		m_vIndices;
+	vfloat2		m_vTexcoords;
+	vQuantizedVertex m_vQuantizedVertices;
 	vuint		m_vTIndices;
 	vuint		m_vNIndices;
 
 	float3		m_vCenter;
+	float3		m_vExtent;
 	float		m_fRadius;
+	bool		m_bHasBound;
+
+	// Either the vectors above or the memory-mapped binary cache
+	std::shared_ptr<MappedFile> m_pCache;
+	const Vertex	*m_pVertices;
+	const uint32_t	*m_pIndices;
+	const float2	*m_pTexcoords;
+	uint32_t		m_uNumVertices;
+	uint32_t		m_uNumIndices;
 };
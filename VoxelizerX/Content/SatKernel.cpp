@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "SatKernel.h"
+#include "SatKernelImpl.h"
+
+using namespace std;
+
+// 4 lanes of SSE; floor by a truncating round trip is exact for the clamped non-negative depths
+struct SimdSSE
+{
+	using V = __m128;
+	static const uint32_t Width = 4;
+
+	static V Set(float f) { return _mm_set1_ps(f); }
+	static V Ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+	static V Add(V a, V b) { return _mm_add_ps(a, b); }
+	static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V Min(V a, V b) { return _mm_min_ps(a, b); }
+	static V Max(V a, V b) { return _mm_max_ps(a, b); }
+	static V And(V a, V b) { return _mm_and_ps(a, b); }
+	static V CmpGE(V a, V b) { return _mm_cmpge_ps(a, b); }
+	static V CmpLE(V a, V b) { return _mm_cmple_ps(a, b); }
+	static V Floor(V a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+	static uint32_t Mask(V a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+	static void Store(float *p, V a) { _mm_storeu_ps(p, a); }
+};
+
+static bool supportsAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	// AVX with the YMM state saved by the OS, then AVX2
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+uint64_t SatKernel::Overlap(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3], vector<uint32_t> &voxels)
+{
+	static const auto pfnOverlap = GetIsa() == AVX2 ? overlapAVX2 : overlapSSE;
+
+	return pfnOverlap(v, boxMin, boxMax, voxels);
+}
+
+uint64_t SatKernel::Overlap(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+	vector<uint32_t> &voxels, Isa isa)
+{
+	// Never runs an instruction set the CPU lacks
+	return isa == AVX2 && GetIsa() == AVX2 ? overlapAVX2(v, boxMin, boxMax, voxels) : overlapSSE(v, boxMin, boxMax, voxels);
+}
+
+SatKernel::Isa SatKernel::GetIsa()
+{
+	static const auto isa = supportsAVX2() ? AVX2 : SSE;
+
+	return isa;
+}
+
+uint64_t SatKernel::overlapSSE(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+	vector<uint32_t> &voxels)
+{
+	return overlapTriangle<SimdSSE>(v, boxMin, boxMax, voxels);
+}
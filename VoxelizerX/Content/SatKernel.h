@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ObjLoader.h"
+
+//--------------------------------------------------------------------------------------
+// Exact triangle/voxel overlap by the separating axis theorem (Akenine-Moller 2001), with
+// the plane and edge-normal setup hoisted per triangle (Schwarz and Seidel 2010). Voxels
+// are tested 8 at a time with AVX2 or 4 at a time with SSE, selected at runtime.
+//--------------------------------------------------------------------------------------
+class SatKernel
+{
+public:
+	using float3 = ObjLoader::float3;
+
+	enum Isa : uint8_t
+	{
+		SSE,
+		AVX2,
+
+		NUM_ISA
+	};
+
+	// The triangle is in voxel units, voxel (x, y, z) spanning [x, x + 1) on each axis.
+	// Appends x, y, z of every overlapped voxel inside the inclusive box [boxMin, boxMax]
+	// to voxels and returns the number of candidate voxels tested. Zero-area triangles
+	// overlap nothing.
+	static uint64_t Overlap(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+		std::vector<uint32_t> &voxels);
+	static uint64_t Overlap(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+		std::vector<uint32_t> &voxels, Isa isa);
+
+	static Isa GetIsa();	// The best one supported by the CPU and the OS
+
+protected:
+	static uint64_t overlapSSE(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+		std::vector<uint32_t> &voxels);
+	static uint64_t overlapAVX2(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+		std::vector<uint32_t> &voxels);
+};
@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "SatKernel.h"
+
+// Only this translation unit is built for AVX2, and only reached after SatKernel::GetIsa();
+// the shared headers are included above so that none of their inline code is retargeted
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SAT_KERNEL_TARGET_PUSHED
+#endif
+
+#include "SatKernelImpl.h"
+
+using namespace std;
+
+// 8 lanes of AVX2
+struct SimdAVX2
+{
+	using V = __m256;
+	static const uint32_t Width = 8;
+
+	static V Set(float f) { return _mm256_set1_ps(f); }
+	static V Ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+	static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+	static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+	static V And(V a, V b) { return _mm256_and_ps(a, b); }
+	static V CmpGE(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static V CmpLE(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static V Floor(V a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a)); }
+	static uint32_t Mask(V a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+	static void Store(float *p, V a) { _mm256_storeu_ps(p, a); }
+};
+
+uint64_t SatKernel::overlapAVX2(const float3 v[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+	vector<uint32_t> &voxels)
+{
+	const auto numTested = overlapTriangle<SimdAVX2>(v, boxMin, boxMax, voxels);
+	_mm256_zeroupper();
+
+	return numTested;
+}
+
+#ifdef SAT_KERNEL_TARGET_PUSHED
+#pragma GCC pop_options
+#undef SAT_KERNEL_TARGET_PUSHED
+#endif
@@ -0,0 +1,174 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "SatKernel.h"
+
+//--------------------------------------------------------------------------------------
+// Lane-width independent body of SatKernel, instantiated once per instruction set by
+// SatKernel.cpp and SatKernelAVX2.cpp. Simd provides the float vector V of Width lanes.
+// Only multiplies and adds are used, never fused, so all widths agree bitwise.
+//--------------------------------------------------------------------------------------
+template<typename Simd>
+static uint64_t overlapTriangle(const SatKernel::float3 tri[3], const uint32_t boxMin[3], const uint32_t boxMax[3],
+	std::vector<uint32_t> &voxels)
+{
+	using V = typename Simd::V;
+
+	const float v[3][3] =
+	{
+		{ tri[0].x, tri[0].y, tri[0].z },
+		{ tri[1].x, tri[1].y, tri[1].z },
+		{ tri[2].x, tri[2].y, tri[2].z }
+	};
+
+	// Edge i goes from vertex i to vertex i + 1
+	float e[3][3];
+	for (auto i = 0u; i < 3; ++i)
+		for (auto a = 0u; a < 3; ++a) e[i][a] = v[(i + 1) % 3][a] - v[i][a];
+	const float n[3] =
+	{
+		e[0][1] * e[1][2] - e[0][2] * e[1][1],
+		e[0][2] * e[1][0] - e[0][0] * e[1][2],
+		e[0][0] * e[1][1] - e[0][1] * e[1][0]
+	};
+
+	// Rotate the dominant axis of the normal to local z; a cyclic permutation keeps the
+	// handedness, so the cross products hold in the local frame too
+	const auto d = std::abs(n[0]) > std::abs(n[1]) ? (std::abs(n[0]) > std::abs(n[2]) ? 0u : 2u) : (std::abs(n[1]) > std::abs(n[2]) ? 1u : 2u);
+	if (!(std::abs(n[d]) > 0.0f)) return 0;	// Also rejects NaN
+	const uint32_t axes[3] = { (d + 1) % 3, (d + 2) % 3, d };
+
+	float p[3][3], le[3][3], ln[3];
+	for (auto a = 0u; a < 3; ++a)
+	{
+		for (auto i = 0u; i < 3; ++i)
+		{
+			p[i][a] = v[i][axes[a]];
+			le[i][a] = e[i][axes[a]];
+		}
+		ln[a] = n[axes[a]];
+	}
+
+	// Candidate voxels: the AABB, clipped to the box
+	float lo[3], hi[3];
+	for (auto a = 0u; a < 3; ++a)
+	{
+		const auto clipMin = static_cast<float>(boxMin[axes[a]]);
+		const auto clipMax = static_cast<float>(boxMax[axes[a]]);
+		const auto pMin = (std::min)((std::min)(p[0][a], p[1][a]), p[2][a]);
+		const auto pMax = (std::max)((std::max)(p[0][a], p[1][a]), p[2][a]);
+		if (!(pMax >= clipMin && pMin < clipMax + 1.0f)) return 0;
+		lo[a] = static_cast<float>(static_cast<uint32_t>((std::max)(pMin, clipMin)));
+		hi[a] = static_cast<float>(static_cast<uint32_t>((std::min)(pMax, clipMax)));
+	}
+
+	// Plane through the box: n.p + d1 and n.p + d2 at the critical corners have opposite signs
+	const auto np0 = ln[0] * p[0][0] + ln[1] * p[0][1] + ln[2] * p[0][2];
+	const auto d1 = (ln[0] > 0.0f ? ln[0] : 0.0f) + (ln[1] > 0.0f ? ln[1] : 0.0f) + (ln[2] > 0.0f ? ln[2] : 0.0f) - np0;
+	const auto d2 = (ln[0] > 0.0f ? 0.0f : ln[0]) + (ln[1] > 0.0f ? 0.0f : ln[1]) + (ln[2] > 0.0f ? 0.0f : ln[2]) - np0;
+
+	// Edge normals in the 3 axis-aligned projections, facing inwards; each test passes if the
+	// farthest box corner along the normal is inside: ex * a + ey * b + ed >= 0
+	float ex[3][3], ey[3][3], ed[3][3];	// Projection onto (a, b), edge
+	for (auto k = 0u; k < 3; ++k)
+	{
+		const auto a = (k + 1) % 3;
+		const auto b = (k + 2) % 3;
+		const auto s = ln[k] >= 0.0f ? 1.0f : -1.0f;
+		for (auto i = 0u; i < 3; ++i)
+		{
+			ex[k][i] = -le[i][b] * s;
+			ey[k][i] = le[i][a] * s;
+			ed[k][i] = -(ex[k][i] * p[i][a] + ey[k][i] * p[i][b]) + (std::max)(ex[k][i], 0.0f) + (std::max)(ey[k][i], 0.0f);
+		}
+	}
+
+	// Plane depth over the [x, x + 1) x [y, y + 1) column, from its lowest to its highest corner
+	const auto dzdx = -ln[0] / ln[2];
+	const auto dzdy = -ln[1] / ln[2];
+	const auto zMinOffset = (std::min)(dzdx, 0.0f) + (std::min)(dzdy, 0.0f);
+	const auto zMaxOffset = (std::max)(dzdx, 0.0f) + (std::max)(dzdy, 0.0f);
+
+	const auto zero = Simd::Set(0.0f);
+	const auto one = Simd::Set(1.0f);
+	const auto ramp = Simd::Ramp();
+	const auto xHi = Simd::Set(hi[0]);
+	const auto zLoClip = Simd::Set(lo[2]);
+	const auto zHiClip = Simd::Set(hi[2]);
+
+	uint64_t numTested = 0;
+	float xs[Simd::Width], zs[Simd::Width];
+	for (auto y = lo[1]; y <= hi[1]; y += 1.0f)
+	{
+		// Row-invariant parts: the (y, z) edge tests are linear in z along the row
+		float yzBase[3];
+		for (auto i = 0u; i < 3; ++i) yzBase[i] = ex[0][i] * y + ed[0][i];
+		const auto zRow = p[0][2] + dzdy * (y - p[0][1]);
+
+		for (auto x0 = lo[0]; x0 <= hi[0]; x0 += static_cast<float>(Simd::Width))
+		{
+			const auto x = Simd::Add(Simd::Set(x0), ramp);
+			auto column = Simd::CmpLE(x, xHi);
+
+			// Column test: the (x, y) projection
+			for (auto i = 0u; i < 3; ++i)
+			{
+				const auto t = Simd::Add(Simd::Add(Simd::Mul(Simd::Set(ex[2][i]), x), Simd::Set(ey[2][i] * y)), Simd::Set(ed[2][i]));
+				column = Simd::And(column, Simd::CmpGE(t, zero));
+			}
+			if (!Simd::Mask(column)) continue;
+
+			// Depth range crossed by the plane, widened by a voxel against rounding
+			const auto zc = Simd::Add(Simd::Mul(Simd::Set(dzdx), Simd::Sub(x, Simd::Set(p[0][0]))), Simd::Set(zRow));
+			auto z = Simd::Sub(Simd::Floor(Simd::Max(Simd::Add(zc, Simd::Set(zMinOffset)), zero)), one);
+			z = Simd::Max(z, zLoClip);
+			const auto zHi = Simd::Min(Simd::Add(Simd::Floor(Simd::Max(Simd::Add(zc, Simd::Set(zMaxOffset)), zero)), one), zHiClip);
+
+			// Column-invariant parts of the plane and (z, x) edge tests
+			const auto nxy = Simd::Add(Simd::Mul(Simd::Set(ln[0]), x), Simd::Set(ln[1] * y));
+			const auto plane1 = Simd::Add(nxy, Simd::Set(d1));
+			const auto plane2 = Simd::Add(nxy, Simd::Set(d2));
+			V zxBase[3];
+			for (auto i = 0u; i < 3; ++i) zxBase[i] = Simd::Add(Simd::Mul(Simd::Set(ey[1][i]), x), Simd::Set(ed[1][i]));
+
+			for (auto active = Simd::And(column, Simd::CmpLE(z, zHi)); Simd::Mask(active);
+				z = Simd::Add(z, one), active = Simd::And(column, Simd::CmpLE(z, zHi)))
+			{
+				const auto nz = Simd::Mul(Simd::Set(ln[2]), z);
+				auto overlap = Simd::And(active, Simd::CmpLE(Simd::Mul(Simd::Add(plane1, nz), Simd::Add(plane2, nz)), zero));
+				for (auto i = 0u; i < 3; ++i)
+				{
+					const auto yz = Simd::Add(Simd::Mul(Simd::Set(ey[0][i]), z), Simd::Set(yzBase[i]));
+					const auto zx = Simd::Add(Simd::Mul(Simd::Set(ex[1][i]), z), zxBase[i]);
+					overlap = Simd::And(overlap, Simd::And(Simd::CmpGE(yz, zero), Simd::CmpGE(zx, zero)));
+				}
+
+				const auto activeMask = Simd::Mask(active);
+				for (auto m = activeMask; m; m &= m - 1) ++numTested;
+
+				auto mask = Simd::Mask(overlap);
+				if (!mask) continue;
+
+				// Back to the grid axes
+				Simd::Store(xs, x);
+				Simd::Store(zs, z);
+				for (; mask; mask &= mask - 1)
+				{
+					uint32_t lane = 0;
+					while (!(mask & (1 << lane))) ++lane;
+
+					uint32_t voxel[3];
+					voxel[axes[0]] = static_cast<uint32_t>(xs[lane]);
+					voxel[axes[1]] = static_cast<uint32_t>(y);
+					voxel[axes[2]] = static_cast<uint32_t>(zs[lane]);
+					voxels.insert(voxels.end(), voxel, voxel + 3);
+				}
+			}
+		}
+	}
+
+	return numTested;
+}
@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "Common\D3DX_DXGIFormatConvert.inl"
+#define	pack(x)		D3DX_FLOAT4_to_R10G10B10A2_UNORM(x)
+#define	unpack(x)	D3DX_R10G10B10A2_UNORM_to_FLOAT4(x)
+
+//--------------------------------------------------------------------------------------
+// Unordered access textures
+//--------------------------------------------------------------------------------------
+RWTexture3D<uint>	g_rwSrc;
+RWTexture3D<uint>	g_rwDst;
+
+//--------------------------------------------------------------------------------------
+// Average the normals of the occupied children; out-of-range loads return 0
+//--------------------------------------------------------------------------------------
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	float3 sum = 0.0;
+	bool occupied = false;
+
+	[unroll]
+	for (uint i = 0; i < 8; ++i)
+	{
+		const uint3 offset = { i & 1, (i >> 1) & 1, i >> 2 };
+		const float4 data = unpack(g_rwSrc[DTid * 2 + offset]);
+		if (data.w > 0.0)
+		{
+			sum += data.xyz * 2.0 - 1.0;
+			occupied = true;
+		}
+	}
+
+	const float len = length(sum);
+	const float3 nrm = len > 0.0 ? sum / len : 0.0;
+	g_rwDst[DTid] = occupied ? pack(float4(nrm * 0.5 + 0.5, 1.0)) : 0;
+}
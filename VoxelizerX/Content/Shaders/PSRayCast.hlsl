@@ -103,9 +103,9 @@ bool ComputeStartPoint(inout float3 pos, float3 rayDir)
 min16float GetSample(float3 tex)
 {
 #if	USE_MUTEX
-	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, SHOW_MIP).x);
+	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, 0).x);
 #else
-	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, SHOW_MIP).w);
+	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, 0).w);
 #endif
 
 	return min(density * 8.0, 16.0);
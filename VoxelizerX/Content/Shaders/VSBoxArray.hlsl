@@ -24,6 +24,11 @@ cbuffer cbMatrices
 	matrix	g_worldIT;
 };
 
+cbuffer cbPerMipLevel
+{
+	float	g_gridSize;
+};
+
 //--------------------------------------------------------------------------------------
 // Textures
 //--------------------------------------------------------------------------------------
@@ -63,7 +68,7 @@ VSOut main(uint vID : SV_VertexID, uint instID : SV_InstanceID)
 	float3 perBoxPos = float3(pos2D.x, -pos2D.y, 1.0);
 	perBoxPos = mul(perBoxPos, plane[planeID]);
 
-	const uint gridSize = GRID_SIZE >> SHOW_MIP;
+	const uint gridSize = g_gridSize;
 	const uint sliceSize = gridSize * gridSize;
 	const uint perSliceID = boxID % sliceSize;
 	const uint3 loc = { perSliceID % gridSize, perSliceID / gridSize, boxID / sliceSize };
@@ -73,12 +78,12 @@ VSOut main(uint vID : SV_VertexID, uint instID : SV_InstanceID)
 	
 #if	USE_MUTEX
 	min16float4 grid;
-	grid.x = g_txGrids[0].mips[SHOW_MIP][vLoc];
-	grid.y = g_txGrids[1].mips[SHOW_MIP][vLoc];
-	grid.z = g_txGrids[2].mips[SHOW_MIP][vLoc];
-	grid.w = g_txGrids[3].mips[SHOW_MIP][vLoc];
+	grid.x = g_txGrids[0][loc];
+	grid.y = g_txGrids[1][loc];
+	grid.z = g_txGrids[2][loc];
+	grid.w = g_txGrids[3][loc];
 #else
-	min16float4 grid = min16float4(g_txGrid.mips[SHOW_MIP][loc]);
+	min16float4 grid = min16float4(g_txGrid[loc]);
 	grid.xyz -= 0.5;
 #endif
 	
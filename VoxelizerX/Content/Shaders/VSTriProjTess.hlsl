@@ -25,6 +25,7 @@ cbuffer cbPerObject
 {
 	float3	g_center	: packoffset(c0);
 	float	g_radius	: packoffset(c0.w);
+	float3	g_extent	: packoffset(c1);	// Per-axis half extents, all g_radius unless anisotropic
 };
 
 //--------------------------------------------------------------------------------------
@@ -34,7 +35,7 @@ VSOut main(VSIn input)
 {
 	VSOut output;
 
-	output.Pos = (input.Pos - g_center) / g_radius;
+	output.Pos = (input.Pos - g_center) / g_extent;
 	output.PosLoc = input.Pos;
 	output.Nrm = input.Nrm;
 
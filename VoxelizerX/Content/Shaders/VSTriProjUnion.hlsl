@@ -26,6 +26,7 @@ cbuffer cbPerObject
 {
 	float3	g_center	: packoffset(c0);
 	float	g_radius	: packoffset(c0.w);
+	float3	g_extent	: packoffset(c1);	// Per-axis half extents, all g_radius unless anisotropic
 };
 
 //--------------------------------------------------------------------------------------
@@ -36,7 +37,7 @@ VSOut main(VSIn input, uint viewID : SV_InstanceID)
 	VSOut output;
 
 	// Normalize
-	const float3 pos = (input.Pos - g_center) / g_radius;
+	const float3 pos = (input.Pos - g_center) / g_extent;
 
 	// Select the view
 	output.Pos.xy = viewID == 0 ? pos.xy : (viewID == 1 ? pos.yz : pos.zx);
@@ -0,0 +1,235 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "SolidFill.h"
+#include "SharedConst.h"
+
+#define ROW_GRAIN_SIZE	1
+#define FILL_DATA		(3u << 30)	// pack(float4(0.0, 0.0, 0.0, 1.0)) of an empty voxel, as CSFillSolid
+
+using namespace std;
+
+static inline uint32_t countTrailingZeros(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	unsigned long idx;
+#if defined(_M_X64)
+	_BitScanForward64(&idx, bits);
+#else
+	if (!_BitScanForward(&idx, static_cast<uint32_t>(bits)))
+	{
+		_BitScanForward(&idx, static_cast<uint32_t>(bits >> 32));
+		idx += 32;
+	}
+#endif
+	return idx;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+// First bit index at or after from that is set (or clear); numWords * 64 if none
+static inline uint32_t findBit(const uint64_t *pBits, uint32_t numWords, uint32_t from, bool set)
+{
+	auto w = from >> 6;
+	if (w >= numWords) return numWords << 6;
+
+	auto bits = (set ? pBits[w] : ~pBits[w]) & (~0ull << (from & 63));
+	while (!bits)
+	{
+		if (++w >= numWords) return numWords << 6;
+		bits = set ? pBits[w] : ~pBits[w];
+	}
+
+	return (w << 6) + countTrailingZeros(bits);
+}
+
+// Sets the bits in [begin, end)
+static inline void setBits(uint64_t *pBits, uint32_t begin, uint32_t end)
+{
+	while (begin < end)
+	{
+		const auto w = begin >> 6;
+		const auto wordEnd = (min)((w + 1) << 6, end);
+		const auto numBits = wordEnd - begin;
+		pBits[w] |= (numBits < 64 ? (1ull << numBits) - 1 : ~0ull) << (begin & 63);
+		begin = wordEnd;
+	}
+}
+
+SolidFill::SolidFill(TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_gridSize(0),
+	m_numFilled(0)
+{
+	m_columnBits.resize(m_scheduler.GetNumWorkers());
+}
+
+SolidFill::~SolidFill()
+{
+}
+
+template<typename Layout>
+void SolidFill::Fill(VoxelGrid<Layout> &grid)
+{
+	fill<Layout>(grid.GetData(), grid.GetGridSize(), grid.GetPaddedSize());
+}
+
+void SolidFill::Fill(uint32_t *pGrid, uint32_t gridSize)
+{
+	fill<LinearLayout>(pGrid, gridSize, gridSize);
+}
+
+uint32_t SolidFill::GetRuns(uint32_t x, uint32_t y, const Run *&pRuns) const
+{
+	const auto &offsets = m_rowRunOffsets[y];
+	pRuns = m_rowRuns[y].data() + offsets[x];
+
+	return offsets[x + 1] - offsets[x];
+}
+
+uint64_t SolidFill::GetNumFilled() const
+{
+	return m_numFilled;
+}
+
+template<typename Layout>
+uint32_t SolidFill::loadRowMask(const uint32_t *pData, uint32_t paddedSize, uint32_t x, uint32_t y, uint32_t z)
+{
+	auto mask = 0u;
+	for (auto i = 0u; i < 8; ++i)
+		mask |= pData[Layout::Encode(x + i, y, z, paddedSize)] ? 1 << i : 0;
+
+	return mask;
+}
+
+// The 8 voxels are contiguous
+template<>
+uint32_t SolidFill::loadRowMask<LinearLayout>(const uint32_t *pData, uint32_t paddedSize, uint32_t x, uint32_t y, uint32_t z)
+{
+	const auto pRow = &pData[LinearLayout::Encode(x, y, z, paddedSize)];
+#if defined(__AVX2__)
+	const auto voxels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRow));
+	const auto empty = _mm256_cmpeq_epi32(voxels, _mm256_setzero_si256());
+
+	return ~_mm256_movemask_ps(_mm256_castsi256_ps(empty)) & 0xff;
+#else
+	const auto zero = _mm_setzero_si128();
+	const auto empty0 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow)), zero);
+	const auto empty1 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow + 4)), zero);
+
+	return ~(_mm_movemask_ps(_mm_castsi128_ps(empty0)) | (_mm_movemask_ps(_mm_castsi128_ps(empty1)) << 4)) & 0xff;
+#endif
+}
+
+// x is a multiple of 8, so the voxels are two tile rows of 4
+template<>
+uint32_t SolidFill::loadRowMask<TiledLayout>(const uint32_t *pData, uint32_t paddedSize, uint32_t x, uint32_t y, uint32_t z)
+{
+	const auto pRow0 = &pData[TiledLayout::Encode(x, y, z, paddedSize)];
+	const auto pRow1 = &pData[TiledLayout::Encode(x + TiledLayout::TileSize, y, z, paddedSize)];
+	const auto zero = _mm_setzero_si128();
+	const auto empty0 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0)), zero);
+	const auto empty1 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1)), zero);
+
+	return ~(_mm_movemask_ps(_mm_castsi128_ps(empty0)) | (_mm_movemask_ps(_mm_castsi128_ps(empty1)) << 4)) & 0xff;
+}
+
+template<typename Layout>
+void SolidFill::fill(uint32_t *pData, uint32_t gridSize, uint32_t paddedSize)
+{
+	const auto numWords = (gridSize + 63) / 64;
+	m_gridSize = gridSize;
+	m_numFilled = 0;
+	m_rowRuns.resize(gridSize);
+	m_rowRunOffsets.resize(gridSize);
+
+	// Each task owns whole rows of columns, so no two tasks touch the same voxel
+	m_scheduler.ParallelFor(0, gridSize, ROW_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		auto &columnBits = m_columnBits[workerIdx];
+		columnBits.resize(static_cast<size_t>(gridSize) * numWords);
+		auto numFilled = 0ull;
+
+		for (auto y = begin; y < end; ++y)
+		{
+			// Occupancy bit columns of the row, gathered 8 voxels along x at a time
+			std::fill(columnBits.begin(), columnBits.end(), 0);
+			for (auto z = 0u; z < gridSize; ++z)
+			{
+				const auto w = z >> 6;
+				const auto bit = 1ull << (z & 63);
+				auto x = 0u;
+				for (; x + 8 <= gridSize; x += 8)
+					for (auto mask = loadRowMask<Layout>(pData, paddedSize, x, y, z); mask; mask &= mask - 1)
+						columnBits[(x + countTrailingZeros(mask)) * numWords + w] |= bit;
+				for (; x < gridSize; ++x)
+					if (pData[Layout::Encode(x, y, z, paddedSize)]) columnBits[x * numWords + w] |= bit;
+			}
+
+			// Extract the runs, then reuse the bit columns for the spans to fill
+			auto &runs = m_rowRuns[y];
+			auto &offsets = m_rowRunOffsets[y];
+			runs.clear();
+			offsets.resize(gridSize + 1);
+			for (auto x = 0u; x < gridSize; ++x)
+			{
+				const auto pBits = &columnBits[x * numWords];
+				offsets[x] = static_cast<uint32_t>(runs.size());
+				for (auto z = findBit(pBits, numWords, 0, true); z < gridSize;)
+				{
+					const auto runEnd = (min)(findBit(pBits, numWords, z, false), gridSize);
+					runs.push_back({ z, runEnd - 1 });
+					z = findBit(pBits, numWords, runEnd, true);
+				}
+
+				std::fill(pBits, pBits + numWords, 0);
+				for (auto i = offsets[x]; i + 1 < runs.size(); ++i)
+				{
+					const auto &run = runs[i];
+					const auto &next = runs[i + 1];
+					const auto surfaceBeg = pData[Layout::Encode(x, y, run.End, paddedSize)];
+					const auto surfaceEnd = pData[Layout::Encode(x, y, next.Begin, paddedSize)];
+					if (!needFill(surfaceBeg, surfaceEnd, i - offsets[x] + 1)) continue;
+
+					setBits(pBits, run.End + 1, next.Begin);
+					numFilled += next.Begin - run.End - 1;
+				}
+			}
+			offsets[gridSize] = static_cast<uint32_t>(runs.size());
+
+			// Write back along x, which is the contiguous direction of the linear and tiled layouts
+			for (auto z = 0u; z < gridSize; ++z)
+			{
+				const auto w = z >> 6;
+				const auto shift = z & 63;
+				for (auto x = 0u; x < gridSize; ++x)
+					if ((columnBits[x * numWords + w] >> shift) & 1)
+						pData[Layout::Encode(x, y, z, paddedSize)] = FILL_DATA;
+			}
+		}
+
+		m_numFilled += numFilled;
+	});
+}
+
+bool SolidFill::needFill(uint32_t surfaceBeg, uint32_t surfaceEnd, uint32_t numRunsBelow)
+{
+#if	USE_NORMAL
+	// Same as CSFillSolid: the crossing below faces -z or the crossing above faces +z
+	static_cast<void>(numRunsBelow);
+
+	return ((surfaceBeg >> 20) & 0x3ff) < 512 || ((surfaceEnd >> 20) & 0x3ff) >= 512;
+#else
+	// Parity of the crossings below
+	static_cast<void>(surfaceBeg);
+	static_cast<void>(surfaceEnd);
+
+	return (numRunsBelow & 1) != 0;
+#endif
+}
+
+template void SolidFill::Fill(VoxelGrid<LinearLayout> &grid);
+template void SolidFill::Fill(VoxelGrid<MortonLayout> &grid);
+template void SolidFill::Fill(VoxelGrid<TiledLayout> &grid);
@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// CPU reference of CSFillSolid without the K-buffer layer cap: each (x, y) column keeps
+// its surface crossings as a sorted list of runs of occupied voxels along z, and the
+// gaps between consecutive runs are filled by the same USE_NORMAL rule.
+//--------------------------------------------------------------------------------------
+class SolidFill
+{
+public:
+	struct Run
+	{
+		uint32_t Begin;
+		uint32_t End;	// Inclusive
+	};
+
+	SolidFill(TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~SolidFill();
+
+	// Fills the interior voxels of a surface-voxelized grid in place
+	template<typename Layout>
+	void Fill(VoxelGrid<Layout> &grid);
+	void Fill(uint32_t *pGrid, uint32_t gridSize);	// Linear layout, as VoxelizerCPU::GetGrid()
+
+	// Surface runs of a column found by the last Fill(), sorted along z
+	uint32_t GetRuns(uint32_t x, uint32_t y, const Run *&pRuns) const;
+	uint64_t GetNumFilled() const;
+
+protected:
+	template<typename Layout>
+	void fill(uint32_t *pData, uint32_t gridSize, uint32_t paddedSize);
+
+	// Occupancy of the voxels (x..x+7, y, z) as a bit mask, x fastest
+	template<typename Layout>
+	static uint32_t loadRowMask(const uint32_t *pData, uint32_t paddedSize, uint32_t x, uint32_t y, uint32_t z);
+	static bool needFill(uint32_t surfaceBeg, uint32_t surfaceEnd, uint32_t numRunsBelow);
+
+	TaskScheduler						&m_scheduler;
+	std::vector<std::vector<uint64_t>>	m_columnBits;		// Per worker, scratch bit columns of a row
+	std::vector<std::vector<Run>>		m_rowRuns;			// Per y
+	std::vector<std::vector<uint32_t>>	m_rowRunOffsets;	// Per y, per x + 1
+
+	uint32_t							m_gridSize;
+	std::atomic<uint64_t>				m_numFilled;
+};
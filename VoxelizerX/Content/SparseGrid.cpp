@@ -0,0 +1,199 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "SparseGrid.h"
+#include "TriangleBinner.h"
+
+#define MAP_GRAIN_SIZE		(1 << 16)
+#define BRICK_GRAIN_SIZE	64
+
+using namespace std;
+
+using float3 = ObjLoader::float3;
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t), "Bricks are exposed as plain uint32_t arrays");
+
+SparseGrid::SparseGrid(uint32_t gridSize, TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_gridSize(gridSize),
+	m_bricksPerAxis((gridSize + BrickSize - 1) / BrickSize),
+	m_numBricks(0),
+	m_brickCapacity(0)
+{
+	const auto mapSize = static_cast<size_t>(m_bricksPerAxis) * m_bricksPerAxis * m_bricksPerAxis;
+	m_brickMap.reset(new atomic<uint32_t>[mapSize]);
+	Clear();
+}
+
+SparseGrid::~SparseGrid()
+{
+}
+
+void SparseGrid::Clear()
+{
+	const auto mapSize = m_bricksPerAxis * m_bricksPerAxis * m_bricksPerAxis;
+	m_scheduler.ParallelFor(0, mapSize, MAP_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i) m_brickMap[i].store(EmptyBrick, memory_order_relaxed);
+	});
+
+	m_brickKeys.clear();
+	m_numBricks = 0;
+}
+
+void SparseGrid::MarkTriangle(const float3 v[3])
+{
+	TriangleBinner::VisitBricks(v, m_gridSize, BrickShift, [this](const uint32_t brickMin[3], const uint32_t brickMax[3])
+	{
+		markBricks(brickMin[0], brickMin[1], brickMin[2], brickMax[0], brickMax[1], brickMax[2]);
+	});
+}
+
+void SparseGrid::Allocate()
+{
+	const auto mapSize = m_bricksPerAxis * m_bricksPerAxis * m_bricksPerAxis;
+	const auto numBlocks = (mapSize + MAP_GRAIN_SIZE - 1) / MAP_GRAIN_SIZE;
+
+	// Count the marked bricks per block
+	vector<uint32_t> blockOffsets(numBlocks + 1, 0);
+	m_scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto blockEnd = min((i + 1) * MAP_GRAIN_SIZE, mapSize);
+			auto count = 0u;
+			for (auto j = i * MAP_GRAIN_SIZE; j < blockEnd; ++j)
+				count += m_brickMap[j].load(memory_order_relaxed) != EmptyBrick ? 1 : 0;
+			blockOffsets[i + 1] = count;
+		}
+	});
+	for (auto i = 0u; i < numBlocks; ++i) blockOffsets[i + 1] += blockOffsets[i];
+	m_numBricks = blockOffsets[numBlocks];
+
+	// Bricks are numbered in brick-map order, so the layout is deterministic
+	const auto poolSize = static_cast<size_t>(m_numBricks) * VoxelsPerBrick;
+	if (poolSize > m_brickCapacity)
+	{
+		m_bricks.reset(new atomic<uint32_t>[poolSize]);
+		m_brickCapacity = poolSize;
+	}
+	m_brickKeys.resize(m_numBricks);
+
+	m_scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto blockEnd = min((i + 1) * MAP_GRAIN_SIZE, mapSize);
+			auto brick = blockOffsets[i];
+			for (auto j = i * MAP_GRAIN_SIZE; j < blockEnd; ++j)
+			{
+				if (m_brickMap[j].load(memory_order_relaxed) == EmptyBrick) continue;
+				m_brickMap[j].store(brick, memory_order_relaxed);
+				m_brickKeys[brick++] = j;
+			}
+		}
+	});
+
+	m_scheduler.ParallelFor(0, m_numBricks, BRICK_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = static_cast<size_t>(begin) * VoxelsPerBrick; i < static_cast<size_t>(end) * VoxelsPerBrick; ++i)
+			m_bricks[i].store(0, memory_order_relaxed);
+	});
+}
+
+void SparseGrid::Write(uint32_t x, uint32_t y, uint32_t z, uint32_t data)
+{
+	const auto brickIdx = (z / BrickSize * m_bricksPerAxis + y / BrickSize) * m_bricksPerAxis + x / BrickSize;
+	const auto brick = m_brickMap[brickIdx].load(memory_order_relaxed);
+	if (brick == EmptyBrick) return;
+
+	const auto voxelIdx = ((z % BrickSize) * BrickSize + y % BrickSize) * BrickSize + x % BrickSize;
+	auto &voxel = m_bricks[static_cast<size_t>(brick) * VoxelsPerBrick + voxelIdx];
+	auto prev = voxel.load(memory_order_relaxed);
+	while (prev < data && !voxel.compare_exchange_weak(prev, data, memory_order_relaxed));
+}
+
+uint32_t SparseGrid::Read(uint32_t x, uint32_t y, uint32_t z) const
+{
+	const auto brickIdx = (z / BrickSize * m_bricksPerAxis + y / BrickSize) * m_bricksPerAxis + x / BrickSize;
+	const auto brick = m_brickMap[brickIdx].load(memory_order_relaxed);
+	if (brick == EmptyBrick) return 0;
+
+	const auto voxelIdx = ((z % BrickSize) * BrickSize + y % BrickSize) * BrickSize + x % BrickSize;
+
+	return m_bricks[static_cast<size_t>(brick) * VoxelsPerBrick + voxelIdx].load(memory_order_relaxed);
+}
+
+void SparseGrid::ToDense(vector<uint32_t> &grid) const
+{
+	const auto gridSize = static_cast<size_t>(m_gridSize);
+	grid.assign(gridSize * gridSize * gridSize, 0);
+
+	// Each brick covers a disjoint region of the dense grid
+	m_scheduler.ParallelFor(0, m_numBricks, BRICK_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			const auto key = m_brickKeys[b];
+			const auto brickX = key % m_bricksPerAxis * BrickSize;
+			const auto brickY = key / m_bricksPerAxis % m_bricksPerAxis * BrickSize;
+			const auto brickZ = key / (m_bricksPerAxis * m_bricksPerAxis) * BrickSize;
+			const auto pBrick = GetBrick(b);
+
+			for (auto k = 0u; k < BrickSize && brickZ + k < m_gridSize; ++k)
+				for (auto j = 0u; j < BrickSize && brickY + j < m_gridSize; ++j)
+					for (auto i = 0u; i < BrickSize && brickX + i < m_gridSize; ++i)
+						grid[((brickZ + k) * gridSize + brickY + j) * gridSize + brickX + i] =
+						pBrick[(k * BrickSize + j) * BrickSize + i];
+		}
+	});
+}
+
+uint32_t SparseGrid::GetGridSize() const
+{
+	return m_gridSize;
+}
+
+uint32_t SparseGrid::GetBricksPerAxis() const
+{
+	return m_bricksPerAxis;
+}
+
+uint32_t SparseGrid::GetNumBricks() const
+{
+	return m_numBricks;
+}
+
+uint32_t SparseGrid::GetBrickKey(uint32_t brick) const
+{
+	return m_brickKeys[brick];
+}
+
+const uint32_t *SparseGrid::GetBrick(uint32_t brick) const
+{
+	return reinterpret_cast<const uint32_t*>(&m_bricks[static_cast<size_t>(brick) * VoxelsPerBrick]);
+}
+
+size_t SparseGrid::GetMemorySize() const
+{
+	const auto mapSize = static_cast<size_t>(m_bricksPerAxis) * m_bricksPerAxis * m_bricksPerAxis;
+
+	return (mapSize + m_brickCapacity + m_brickKeys.capacity()) * sizeof(uint32_t);
+}
+
+void SparseGrid::markBricks(uint32_t xMin, uint32_t yMin, uint32_t zMin, uint32_t xMax, uint32_t yMax, uint32_t zMax)
+{
+	// Any non-empty value marks the brick; Allocate() assigns the pool slots
+	for (auto z = zMin; z <= zMax; ++z)
+	{
+		for (auto y = yMin; y <= yMax; ++y)
+		{
+			for (auto x = xMin; x <= xMax; ++x)
+			{
+				auto &slot = m_brickMap[(z * m_bricksPerAxis + y) * m_bricksPerAxis + x];
+				if (slot.load(memory_order_relaxed) == EmptyBrick) slot.store(0, memory_order_relaxed);
+			}
+		}
+	}
+}
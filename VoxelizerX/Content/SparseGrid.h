@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ObjLoader.h"
+#include "TaskScheduler.h"
+
+//--------------------------------------------------------------------------------------
+// Sparse voxel grid: a top-level brick map pointing into a pool of BrickSize^3 bricks
+//--------------------------------------------------------------------------------------
+class SparseGrid
+{
+public:
+	SparseGrid(uint32_t gridSize, TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~SparseGrid();
+
+	// Allocation: Clear(), MarkTriangle() for all triangles (thread-safe), then Allocate()
+	void Clear();
+	void MarkTriangle(const ObjLoader::float3 v[3]);
+	void Allocate();
+
+	// Equivalent to InterlockedMax(); writes to unallocated bricks are discarded
+	void Write(uint32_t x, uint32_t y, uint32_t z, uint32_t data);
+	uint32_t Read(uint32_t x, uint32_t y, uint32_t z) const;
+	void ToDense(std::vector<uint32_t> &grid) const;
+
+	uint32_t GetGridSize() const;
+	uint32_t GetBricksPerAxis() const;
+	uint32_t GetNumBricks() const;
+	uint32_t GetBrickKey(uint32_t brick) const;	// Linear brick-map index of an allocated brick
+	const uint32_t *GetBrick(uint32_t brick) const;
+	size_t GetMemorySize() const;
+
+	static const uint32_t BrickShift = 3;
+	static const uint32_t BrickSize = 1 << BrickShift;
+	static const uint32_t VoxelsPerBrick = BrickSize * BrickSize * BrickSize;
+	static const uint32_t EmptyBrick = UINT32_MAX;
+
+protected:
+	void markBricks(uint32_t xMin, uint32_t yMin, uint32_t zMin, uint32_t xMax, uint32_t yMax, uint32_t zMax);
+
+	TaskScheduler							&m_scheduler;
+
+	std::unique_ptr<std::atomic<uint32_t>[]> m_brickMap;
+	std::unique_ptr<std::atomic<uint32_t>[]> m_bricks;
+	std::vector<uint32_t>					m_brickKeys;
+
+	uint32_t								m_gridSize;
+	uint32_t								m_bricksPerAxis;
+	uint32_t								m_numBricks;
+	size_t									m_brickCapacity;
+};
@@ -0,0 +1,394 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "SparseVoxelOctree.h"
+#include "VoxelizerCPU.h"
+
+#define NODE_GRAIN_SIZE		(1 << 16)
+#define BRICK_GRAIN_SIZE	64
+
+#define SVO_MAGIC			0x4f565358	// "XSVO"
+#define SVO_VERSION			1
+
+using namespace std;
+
+struct SVOHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t GridSize;
+	uint32_t NumLevels;
+	uint32_t NumNodes;
+};
+
+static inline uint32_t countBits(uint32_t mask)
+{
+	mask = mask - ((mask >> 1) & 0x55555555);
+	mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+
+	return (((mask + (mask >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+SparseVoxelOctree::SparseVoxelOctree(TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_gridSize(0),
+	m_numLevels(0)
+{
+}
+
+SparseVoxelOctree::~SparseVoxelOctree()
+{
+}
+
+void SparseVoxelOctree::Build(const SparseGrid &grid)
+{
+	const auto bricksPerAxis = grid.GetBricksPerAxis();
+	const auto getBrickCoord = [&](uint32_t brick, uint32_t &x, uint32_t &y, uint32_t &z)
+	{
+		const auto key = grid.GetBrickKey(brick);
+		x = key % bricksPerAxis;
+		y = key / bricksPerAxis % bricksPerAxis;
+		z = key / (bricksPerAxis * bricksPerAxis);
+	};
+
+	const auto getVoxel = [&](uint32_t brick, uint32_t i, uint32_t j, uint32_t k)
+	{
+		return grid.GetBrick(brick)[(k * SparseGrid::BrickSize + j) * SparseGrid::BrickSize + i];
+	};
+
+	m_gridSize = grid.GetGridSize();
+	vector<Level> levels(1);
+	buildLeaves(grid.GetNumBricks(), getBrickCoord, getVoxel, levels[0]);
+	flatten(levels);
+}
+
+void SparseVoxelOctree::Build(const vector<uint32_t> &grid, uint32_t gridSize)
+{
+	// Treat the dense grid as a full set of bricks; empty ones produce no leaves
+	const auto bricksPerAxis = (gridSize + SparseGrid::BrickSize - 1) / SparseGrid::BrickSize;
+	const auto getBrickCoord = [&](uint32_t brick, uint32_t &x, uint32_t &y, uint32_t &z)
+	{
+		x = brick % bricksPerAxis;
+		y = brick / bricksPerAxis % bricksPerAxis;
+		z = brick / (bricksPerAxis * bricksPerAxis);
+	};
+
+	const auto getVoxel = [&](uint32_t brick, uint32_t i, uint32_t j, uint32_t k)
+	{
+		uint32_t x, y, z;
+		getBrickCoord(brick, x, y, z);
+		x = x * SparseGrid::BrickSize + i;
+		y = y * SparseGrid::BrickSize + j;
+		z = z * SparseGrid::BrickSize + k;
+		if (x >= gridSize || y >= gridSize || z >= gridSize) return 0u;
+
+		return grid[(static_cast<size_t>(z) * gridSize + y) * gridSize + x];
+	};
+
+	m_gridSize = gridSize;
+	vector<Level> levels(1);
+	buildLeaves(bricksPerAxis * bricksPerAxis * bricksPerAxis, getBrickCoord, getVoxel, levels[0]);
+	flatten(levels);
+}
+
+bool SparseVoxelOctree::Save(const char *fileName) const
+{
+	ofstream file(fileName, ios::binary | ios::trunc);
+	if (!file) return false;
+
+	SVOHeader header = {};
+	header.Magic = SVO_MAGIC;
+	header.Version = SVO_VERSION;
+	header.GridSize = m_gridSize;
+	header.NumLevels = m_numLevels;
+	header.NumNodes = GetNumNodes();
+
+	// Child offsets are implied by the masks and are not stored
+	file.write(reinterpret_cast<const char*>(&header), sizeof(SVOHeader));
+	file.write(reinterpret_cast<const char*>(m_levelOffsets.data()), sizeof(uint32_t) * m_levelOffsets.size());
+	file.write(reinterpret_cast<const char*>(m_childMasks.data()), m_childMasks.size());
+	file.write(reinterpret_cast<const char*>(m_normals.data()), sizeof(uint32_t) * m_normals.size());
+
+	return file.good();
+}
+
+bool SparseVoxelOctree::Load(const char *fileName)
+{
+	ifstream file(fileName, ios::binary | ios::ate);
+	if (!file) return false;
+	const auto fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	SVOHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(SVOHeader));
+	if (!file || header.Magic != SVO_MAGIC || header.Version != SVO_VERSION) return false;
+	if (header.NumLevels == 0 || header.NumLevels > 22) return false;
+
+	// Reject truncated files before allocating anything
+	const auto numNodes = static_cast<uint64_t>(header.NumNodes);
+	if (fileSize < sizeof(SVOHeader) + sizeof(uint32_t) * (header.NumLevels + 1ull) +
+		numNodes * (sizeof(uint8_t) + sizeof(uint32_t))) return false;
+
+	vector<uint32_t> levelOffsets(header.NumLevels + 1);
+	vector<uint8_t> childMasks(header.NumNodes);
+	vector<uint32_t> normals(header.NumNodes);
+	file.read(reinterpret_cast<char*>(levelOffsets.data()), sizeof(uint32_t) * levelOffsets.size());
+	file.read(reinterpret_cast<char*>(childMasks.data()), childMasks.size());
+	file.read(reinterpret_cast<char*>(normals.data()), sizeof(uint32_t) * normals.size());
+	if (!file || levelOffsets.front() != 0 || levelOffsets.back() != header.NumNodes) return false;
+
+	// Each level must hold exactly the children its parents' masks refer to
+	for (auto i = 0u; i < header.NumLevels; ++i)
+	{
+		if (levelOffsets[i + 1] < levelOffsets[i]) return false;
+		if (i + 1 == header.NumLevels) break;
+
+		auto numChildren = 0ull;
+		for (auto node = levelOffsets[i]; node < levelOffsets[i + 1]; ++node) numChildren += countBits(childMasks[node]);
+		if (numChildren != levelOffsets[i + 2] - static_cast<uint64_t>(levelOffsets[i + 1])) return false;
+	}
+
+	m_gridSize = header.GridSize;
+	m_numLevels = header.NumLevels;
+	m_levelOffsets.swap(levelOffsets);
+	m_childMasks.swap(childMasks);
+	m_normals.swap(normals);
+	linkChildren();
+
+	return true;
+}
+
+uint32_t SparseVoxelOctree::Lookup(uint32_t x, uint32_t y, uint32_t z) const
+{
+	if (x >= m_gridSize || y >= m_gridSize || z >= m_gridSize || m_normals.empty()) return 0;
+
+	auto node = 0u;
+	for (auto level = 0u; level + 1 < m_numLevels; ++level)
+	{
+		const auto shift = m_numLevels - 2 - level;
+		const auto child = ((x >> shift) & 1) | (((y >> shift) & 1) << 1) | (((z >> shift) & 1) << 2);
+		const auto mask = m_childMasks[node];
+		if (!(mask & (1 << child))) return 0;
+
+		node = m_firstChildren[node] + countBits(mask & ((1u << child) - 1));
+	}
+
+	return m_normals[node];
+}
+
+uint32_t SparseVoxelOctree::GetGridSize() const
+{
+	return m_gridSize;
+}
+
+uint32_t SparseVoxelOctree::GetNumLevels() const
+{
+	return m_numLevels;
+}
+
+uint32_t SparseVoxelOctree::GetNumNodes() const
+{
+	return static_cast<uint32_t>(m_normals.size());
+}
+
+uint32_t SparseVoxelOctree::GetLevelOffset(uint32_t level) const
+{
+	return m_levelOffsets[level];
+}
+
+uint8_t SparseVoxelOctree::GetChildMask(uint32_t node) const
+{
+	return m_childMasks[node];
+}
+
+uint32_t SparseVoxelOctree::GetFirstChild(uint32_t node) const
+{
+	return m_firstChildren[node];
+}
+
+uint32_t SparseVoxelOctree::GetNormal(uint32_t node) const
+{
+	return m_normals[node];
+}
+
+template<typename GetBrickCoord, typename GetVoxel>
+void SparseVoxelOctree::buildLeaves(uint32_t numBricks, const GetBrickCoord &getBrickCoord,
+	const GetVoxel &getVoxel, Level &leaves)
+{
+	static const auto voxelsPerBrick = SparseGrid::VoxelsPerBrick;
+
+	// Bricks are aligned subtrees, so sorting the bricks and walking each brick
+	// in Morton order yields Morton-sorted voxels without sorting the voxels.
+	vector<pair<uint64_t, uint32_t>> bricks(numBricks);
+	m_scheduler.ParallelFor(0, numBricks, NODE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			uint32_t x, y, z;
+			getBrickCoord(b, x, y, z);
+			bricks[b] = make_pair(MortonLayout::Encode(x, y, z), b);
+		}
+	});
+	sort(bricks.begin(), bricks.end());
+
+	uint8_t localCoords[voxelsPerBrick][3];
+	for (auto i = 0u; i < voxelsPerBrick; ++i)
+		for (auto j = 0u; j < 3; ++j)
+			localCoords[i][j] = ((i >> j) & 1) | (((i >> (j + 3)) & 1) << 1) | (((i >> (j + 6)) & 1) << 2);
+
+	// Count, scan, then emit the occupied voxels of each brick
+	vector<uint32_t> offsets(numBricks + 1, 0);
+	m_scheduler.ParallelFor(0, numBricks, BRICK_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			auto count = 0u;
+			for (const auto &coord : localCoords)
+				count += getVoxel(bricks[b].second, coord[0], coord[1], coord[2]) ? 1 : 0;
+			offsets[b + 1] = count;
+		}
+	});
+	for (auto b = 0u; b < numBricks; ++b) offsets[b + 1] += offsets[b];
+
+	const auto numLeaves = offsets[numBricks];
+	leaves.Keys.resize(numLeaves);
+	leaves.ChildMasks.assign(numLeaves, 0);
+	leaves.Normals.resize(numLeaves);
+
+	m_scheduler.ParallelFor(0, numBricks, BRICK_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			auto leaf = offsets[b];
+			for (auto i = 0u; i < voxelsPerBrick; ++i)
+			{
+				const auto &coord = localCoords[i];
+				const auto voxel = getVoxel(bricks[b].second, coord[0], coord[1], coord[2]);
+				if (!voxel) continue;
+
+				leaves.Keys[leaf] = (bricks[b].first << 9) | i;
+				leaves.Normals[leaf++] = voxel;
+			}
+		}
+	});
+}
+
+void SparseVoxelOctree::buildParents(const Level &children, Level &parents)
+{
+	const auto numChildren = static_cast<uint32_t>(children.Keys.size());
+	const auto numChunks = (numChildren + NODE_GRAIN_SIZE - 1) / NODE_GRAIN_SIZE;
+
+	// Move the chunk boundaries forward so that every chunk owns whole sibling groups
+	vector<uint32_t> chunkStarts(numChunks + 1, numChildren);
+	m_scheduler.ParallelFor(0, numChunks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto c = begin; c < end; ++c)
+		{
+			auto i = c * NODE_GRAIN_SIZE;
+			while (i > 0 && i < numChildren && (children.Keys[i] >> 3) == (children.Keys[i - 1] >> 3)) ++i;
+			chunkStarts[c] = i;
+		}
+	});
+
+	vector<uint32_t> offsets(numChunks + 1, 0);
+	m_scheduler.ParallelFor(0, numChunks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto c = begin; c < end; ++c)
+		{
+			auto count = 0u;
+			for (auto i = chunkStarts[c]; i < chunkStarts[c + 1]; ++i)
+				count += i == chunkStarts[c] || (children.Keys[i] >> 3) != (children.Keys[i - 1] >> 3) ? 1 : 0;
+			offsets[c + 1] = count;
+		}
+	});
+	for (auto c = 0u; c < numChunks; ++c) offsets[c + 1] += offsets[c];
+
+	const auto numParents = offsets[numChunks];
+	parents.Keys.resize(numParents);
+	parents.ChildMasks.resize(numParents);
+	parents.Normals.resize(numParents);
+
+	m_scheduler.ParallelFor(0, numChunks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto c = begin; c < end; ++c)
+		{
+			auto parent = offsets[c];
+			for (auto i = chunkStarts[c]; i < chunkStarts[c + 1]; ++parent)
+			{
+				// Average the child normals of one sibling group
+				const auto key = children.Keys[i] >> 3;
+				uint8_t mask = 0;
+				float sum[3] = {};
+				for (; i < chunkStarts[c + 1] && (children.Keys[i] >> 3) == key; ++i)
+				{
+					float x, y, z, w;
+					VoxelizerCPU::UnpackR10G10B10A2(children.Normals[i], x, y, z, w);
+					sum[0] += x * 2.0f - 1.0f;
+					sum[1] += y * 2.0f - 1.0f;
+					sum[2] += z * 2.0f - 1.0f;
+					mask |= 1 << (children.Keys[i] & 7);
+				}
+
+				const auto len = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+				const auto scl = len > 0.0f ? 0.5f / len : 0.0f;
+				parents.Keys[parent] = key;
+				parents.ChildMasks[parent] = mask;
+				parents.Normals[parent] = VoxelizerCPU::PackR10G10B10A2(sum[0] * scl + 0.5f,
+					sum[1] * scl + 0.5f, sum[2] * scl + 0.5f, 1.0f);
+			}
+		}
+	});
+}
+
+void SparseVoxelOctree::flatten(vector<Level> &levels)
+{
+	// Reduce the leaves up to the root
+	auto paddedSize = 1u;
+	m_numLevels = 1;
+	while (paddedSize < m_gridSize)
+	{
+		paddedSize <<= 1;
+		++m_numLevels;
+	}
+
+	levels.resize(m_numLevels);
+	for (auto i = 1u; i < m_numLevels; ++i) buildParents(levels[i - 1], levels[i]);
+
+	// Breadth-first order: root first
+	m_levelOffsets.resize(m_numLevels + 1);
+	m_levelOffsets[0] = 0;
+	for (auto i = 0u; i < m_numLevels; ++i)
+		m_levelOffsets[i + 1] = m_levelOffsets[i] + static_cast<uint32_t>(levels[m_numLevels - 1 - i].Keys.size());
+
+	const auto numNodes = m_levelOffsets[m_numLevels];
+	m_childMasks.resize(numNodes);
+	m_normals.resize(numNodes);
+	m_scheduler.ParallelFor(0, m_numLevels, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			auto &level = levels[m_numLevels - 1 - i];
+			copy(level.ChildMasks.cbegin(), level.ChildMasks.cend(), m_childMasks.begin() + m_levelOffsets[i]);
+			copy(level.Normals.cbegin(), level.Normals.cend(), m_normals.begin() + m_levelOffsets[i]);
+		}
+	});
+
+	linkChildren();
+}
+
+void SparseVoxelOctree::linkChildren()
+{
+	const auto numNodes = GetNumNodes();
+	m_firstChildren.assign(numNodes, 0);
+
+	for (auto i = 0u; i + 1 < m_numLevels; ++i)
+	{
+		auto child = m_levelOffsets[i + 1];
+		for (auto node = m_levelOffsets[i]; node < m_levelOffsets[i + 1]; ++node)
+		{
+			m_firstChildren[node] = child;
+			child += countBits(m_childMasks[node]);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "SparseGrid.h"
+
+//--------------------------------------------------------------------------------------
+// Pointer-less sparse voxel octree, stored breadth-first with one child mask per node.
+// Children of a node are contiguous on the next level; their offset is the running sum
+// of the child-mask bit counts of the preceding nodes on the same level.
+//--------------------------------------------------------------------------------------
+class SparseVoxelOctree
+{
+public:
+	SparseVoxelOctree(TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~SparseVoxelOctree();
+
+	// Voxels are packed R10G10B10A2 normals as output by VoxelizerCPU; 0 is empty
+	void Build(const SparseGrid &grid);
+	void Build(const std::vector<uint32_t> &grid, uint32_t gridSize);
+
+	bool Save(const char *fileName) const;
+	bool Load(const char *fileName);
+
+	// Returns the packed normal of the leaf voxel, or 0 if empty
+	uint32_t Lookup(uint32_t x, uint32_t y, uint32_t z) const;
+
+	uint32_t GetGridSize() const;
+	uint32_t GetNumLevels() const;		// Level 0 is the root, the last level holds the voxels
+	uint32_t GetNumNodes() const;
+	uint32_t GetLevelOffset(uint32_t level) const;
+	uint8_t GetChildMask(uint32_t node) const;
+	uint32_t GetFirstChild(uint32_t node) const;
+	uint32_t GetNormal(uint32_t node) const;	// Averaged over the children for inner nodes
+
+protected:
+	struct Level
+	{
+		std::vector<uint64_t>	Keys;		// Morton codes, sorted
+		std::vector<uint8_t>	ChildMasks;
+		std::vector<uint32_t>	Normals;
+	};
+
+	template<typename GetBrickCoord, typename GetVoxel>
+	void buildLeaves(uint32_t numBricks, const GetBrickCoord &getBrickCoord,
+		const GetVoxel &getVoxel, Level &leaves);
+	void buildParents(const Level &children, Level &parents);
+	void flatten(std::vector<Level> &levels);
+	void linkChildren();
+
+	TaskScheduler			&m_scheduler;
+
+	std::vector<uint32_t>	m_levelOffsets;
+	std::vector<uint8_t>	m_childMasks;
+	std::vector<uint32_t>	m_firstChildren;
+	std::vector<uint32_t>	m_normals;
+
+	uint32_t				m_gridSize;
+	uint32_t				m_numLevels;
+};
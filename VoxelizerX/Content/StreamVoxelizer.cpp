@@ -0,0 +1,234 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "StreamVoxelizer.h"
+#include "MappedFile.h"
+#include "BinaryMeshLoader.h"
+
+#define BLOCK_SIZE_MIN		(1 << 16)
+#define BUDGET_PER_BLOCK	16	// Text, parsed chunk and triangle vertices of two batches
+
+using namespace std;
+
+template<typename T>
+static size_t vectorBytes(const vector<T> &vec)
+{
+	return sizeof(T) * vec.capacity();
+}
+
+StreamVoxelizer::StreamVoxelizer(uint32_t gridSize, size_t memoryBudget, TaskScheduler &scheduler) :
+	ObjLoader(scheduler),
+	m_voxelizer(gridSize, scheduler),
+	m_blockSize((max)(memoryBudget / BUDGET_PER_BLOCK, static_cast<size_t>(BLOCK_SIZE_MIN))),
+	m_numTriangles(0),
+	m_peakBatchMemory(0)
+{
+}
+
+StreamVoxelizer::~StreamVoxelizer()
+{
+}
+
+bool StreamVoxelizer::Voxelize(const char *fileName, VoxelizerCPU::Method voxMethod, bool anisotropic,
+	const char *spillFileName)
+{
+	ifstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	// Binary STL and PLY have no text lines to split into batches
+	uint64_t fileSize, fileTime;
+	uint8_t header[BinaryMeshLoader::HeaderSize] = {};
+	if (!MappedFile::Stat(fileName, fileSize, fileTime)) return false;
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (BinaryMeshLoader::DetectFormat(header, static_cast<size_t>(fileSize)) != BinaryMeshLoader::OBJ) return false;
+	file.clear();
+	file.seekg(0);
+
+	const auto spillName = spillFileName ? string(spillFileName) : string(fileName) + ".spill";
+
+	// Pass 1: bound and position spill, block by block
+	m_blockVertexBases.clear();
+	m_numTriangles = 0;
+	m_peakBatchMemory = 0;
+	m_uNumVertices = 0;
+	{
+		ofstream spill(spillName, ios::binary | ios::trunc);
+		if (!spill) return false;
+
+		float3 vMin(FLT_MAX, FLT_MAX, FLT_MAX), vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		vector<char> block;
+		string carry;
+		auto uMaxBlockTriangles = 0u;
+		while (readBlock(file, block, carry))
+		{
+			Chunk chunk;
+			parseChunk(block.data(), block.data() + block.size(), chunk);
+			m_blockVertexBases.push_back(m_uNumVertices);
+			for (const auto &p : chunk.vPositions)
+			{
+				vMin = float3((min)(vMin.x, p.x), (min)(vMin.y, p.y), (min)(vMin.z, p.z));
+				vMax = float3((max)(vMax.x, p.x), (max)(vMax.y, p.y), (max)(vMax.z, p.z));
+			}
+
+			spill.write(reinterpret_cast<const char*>(chunk.vPositions.data()), sizeof(float3) * chunk.vPositions.size());
+			m_uNumVertices += static_cast<uint32_t>(chunk.vPositions.size());
+
+			const auto uNumBlockTriangles = static_cast<uint32_t>(chunk.vIndices.size() / 3);
+			m_numTriangles += uNumBlockTriangles;
+			uMaxBlockTriangles = (max)(uMaxBlockTriangles, uNumBlockTriangles);
+		}
+
+		if (!spill.good() || m_uNumVertices == 0)
+		{
+			spill.close();
+			remove(spillName.c_str());
+
+			return false;
+		}
+
+		// Same bound as ObjLoader::computeBound()
+		m_vCenter = float3((vMin.x + vMax.x) / 2.0f, (vMin.y + vMax.y) / 2.0f, (vMin.z + vMax.z) / 2.0f);
+		m_vExtent = float3((vMax.x - vMin.x) / 2.0f, (vMax.y - vMin.y) / 2.0f, (vMax.z - vMin.z) / 2.0f);
+		m_fRadius = (max)((max)(m_vExtent.x, m_vExtent.y), m_vExtent.z);
+
+		m_identity.resize(static_cast<size_t>(uMaxBlockTriangles) * 3);
+		for (size_t i = 0; i < m_identity.size(); ++i) m_identity[i] = static_cast<uint32_t>(i);
+	}
+
+	MappedFile spillFile;
+	if (!spillFile.Open(spillName.c_str()))
+	{
+		remove(spillName.c_str());
+
+		return false;
+	}
+	const auto pPositions = reinterpret_cast<const float3*>(spillFile.GetData());
+
+	// Pass 2: the same blocks again, loading batch N + 1 on another thread while voxelizing batch N
+	file.clear();
+	file.seekg(0);
+	string carry;
+	Batch batches[2];
+	const auto extent = anisotropic ? m_vExtent : float3(m_fRadius, m_fRadius, m_fRadius);
+	m_voxelizer.Clear();
+
+	auto hasBatch = loadBatch(file, carry, 0, pPositions, batches[0]);
+	for (auto i = 0u; hasBatch; ++i)
+	{
+		auto &batch = batches[i & 1];
+		auto &nextBatch = batches[(i + 1) & 1];
+		auto hasNext = false;
+		thread loader([&]() { hasNext = loadBatch(file, carry, i + 1, pPositions, nextBatch); });
+
+		const auto numVert = static_cast<uint32_t>((min)(batch.Vertices.size(), m_identity.size()));
+		m_voxelizer.SetMesh(numVert, GetVertexStride(), reinterpret_cast<const uint8_t*>(batch.Vertices.data()),
+			numVert, m_identity.data(), m_vCenter, extent);
+		m_voxelizer.VoxelizeBatch(voxMethod);
+
+		loader.join();
+		m_peakBatchMemory = (max)(m_peakBatchMemory, getMemorySize(batch) + getMemorySize(nextBatch));
+		hasBatch = hasNext;
+	}
+
+	spillFile.Close();
+	remove(spillName.c_str());
+
+	return true;
+}
+
+const vector<uint32_t> &StreamVoxelizer::GetGrid() const
+{
+	return m_voxelizer.GetGrid();
+}
+
+uint32_t StreamVoxelizer::GetGridSize() const
+{
+	return m_voxelizer.GetGridSize();
+}
+
+uint32_t StreamVoxelizer::GetNumTriangles() const
+{
+	return m_numTriangles;
+}
+
+uint32_t StreamVoxelizer::GetNumBatches() const
+{
+	return static_cast<uint32_t>(m_blockVertexBases.size());
+}
+
+size_t StreamVoxelizer::GetPeakBatchMemory() const
+{
+	return m_peakBatchMemory;
+}
+
+bool StreamVoxelizer::readBlock(ifstream &file, vector<char> &block, string &carry) const
+{
+	block.assign(carry.cbegin(), carry.cend());
+	carry.clear();
+
+	while (file)
+	{
+		const auto size = block.size();
+		block.resize(size + m_blockSize);
+		file.read(block.data() + size, m_blockSize);
+		block.resize(size + static_cast<size_t>(file.gcount()));
+
+		// The partial last line goes to the next block; lines longer than a block keep growing it
+		const auto it = find(block.rbegin(), block.rend(), '\n');
+		if (it != block.rend())
+		{
+			carry.assign(it.base(), block.end());
+			block.erase(it.base(), block.end());
+			break;
+		}
+	}
+
+	return !block.empty();
+}
+
+bool StreamVoxelizer::loadBatch(ifstream &file, string &carry, uint32_t blockIdx, const float3 *pPositions,
+	Batch &batch)
+{
+	batch.Vertices.clear();
+	if (blockIdx >= m_blockVertexBases.size() || !readBlock(file, batch.Text, carry)) return false;
+
+	// Resolve the relative indices with the vertex count of the preceding blocks
+	auto &chunk = batch.Geometry;
+	chunk = Chunk();
+	parseChunk(batch.Text.data(), batch.Text.data() + batch.Text.size(), chunk);
+	for (const auto &i : chunk.vIndexFixups) chunk.vIndices[i] += m_blockVertexBases[blockIdx];
+
+	const auto numTri = chunk.vIndices.size() / 3;
+	batch.Vertices.reserve(numTri * 3);
+	for (size_t i = 0; i < numTri; ++i)
+	{
+		const auto *pIdx = &chunk.vIndices[i * 3];
+		if (pIdx[0] >= m_uNumVertices || pIdx[1] >= m_uNumVertices || pIdx[2] >= m_uNumVertices) continue;
+
+		const auto &p0 = pPositions[pIdx[0]];
+		const auto &p1 = pPositions[pIdx[1]];
+		const auto &p2 = pPositions[pIdx[2]];
+		const float3 e1(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+		const float3 e2(p2.x - p0.x, p2.y - p0.y, p2.z - p0.z);
+		float3 n(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+		const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		n = l > 0.0f ? float3(n.x / l, n.y / l, n.z / l) : float3(0.0f, 0.0f, 0.0f);
+
+		batch.Vertices.push_back({ p0, n });
+		batch.Vertices.push_back({ p1, n });
+		batch.Vertices.push_back({ p2, n });
+	}
+
+	return true;
+}
+
+size_t StreamVoxelizer::getMemorySize(const Batch &batch)
+{
+	const auto &chunk = batch.Geometry;
+
+	return vectorBytes(batch.Text) + vectorBytes(batch.Vertices) + vectorBytes(chunk.vPositions) +
+		vectorBytes(chunk.vTexcoords) + vectorBytes(chunk.vNormals) + vectorBytes(chunk.vIndices) +
+		vectorBytes(chunk.vTIndices) + vectorBytes(chunk.vNIndices) + vectorBytes(chunk.vIndexFixups) +
+		vectorBytes(chunk.vTIndexFixups) + vectorBytes(chunk.vNIndexFixups);
+}
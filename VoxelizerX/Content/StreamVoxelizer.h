@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelizerCPU.h"
+
+//--------------------------------------------------------------------------------------
+// Out-of-core voxelization of OBJ files larger than memory. A first pass computes the
+// bound and spills the positions to a binary file; a second pass streams the triangles
+// through VoxelizerCPU in newline-aligned batches, parsing batch N+1 while voxelizing N.
+// Resident memory is the grid plus two batches: the spill file is only memory-mapped.
+// Batches carry face normals, as vertex normals would need the whole mesh.
+//--------------------------------------------------------------------------------------
+class StreamVoxelizer : protected ObjLoader
+{
+public:
+	StreamVoxelizer(uint32_t gridSize = GRID_SIZE, size_t memoryBudget = DefaultMemoryBudget,
+		TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~StreamVoxelizer();
+
+	// OBJ only. The spill file defaults to the OBJ file name with ".spill" appended; it is
+	// removed afterwards.
+	bool Voxelize(const char *fileName, VoxelizerCPU::Method voxMethod, bool anisotropic = false,
+		const char *spillFileName = nullptr);
+
+	using ObjLoader::GetNumVertices;
+	using ObjLoader::GetCenter;
+	using ObjLoader::GetRadius;
+	using ObjLoader::GetExtent;
+
+	const std::vector<uint32_t> &GetGrid() const;
+	uint32_t GetGridSize() const;
+	uint32_t GetNumTriangles() const;
+	uint32_t GetNumBatches() const;
+	size_t GetPeakBatchMemory() const;	// Bytes held by the two in-flight batches at most
+
+	static const size_t DefaultMemoryBudget = 256 << 20;
+
+protected:
+	struct Batch
+	{
+		std::vector<char>	Text;
+		Chunk				Geometry;
+		vVertex				Vertices;	// Three per triangle
+	};
+
+	bool readBlock(std::ifstream &file, std::vector<char> &block, std::string &carry) const;
+	bool loadBatch(std::ifstream &file, std::string &carry, uint32_t blockIdx, const float3 *pPositions,
+		Batch &batch);
+
+	static size_t getMemorySize(const Batch &batch);
+
+	VoxelizerCPU		m_voxelizer;
+	size_t				m_blockSize;	// Text bytes per batch
+
+	vuint				m_blockVertexBases;
+	vuint				m_identity;		// Index buffer shared by all batches
+	uint32_t			m_numTriangles;
+	size_t				m_peakBatchMemory;
+};
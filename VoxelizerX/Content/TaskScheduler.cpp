@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "TaskScheduler.h"
+
+using namespace std;
+
+TaskScheduler::TaskScheduler(uint32_t numWorkers) :
+	m_numWorkers(numWorkers),
+	m_epoch(0),
+	m_quit(false),
+	m_pFunc(nullptr),
+	m_numPending(0)
+{
+	if (m_numWorkers == 0) m_numWorkers = thread::hardware_concurrency();
+	if (m_numWorkers == 0) m_numWorkers = 1;
+
+	m_queues = make_unique<WorkQueue[]>(m_numWorkers);
+
+	// Worker 0 is always the submitting thread
+	m_threads.reserve(m_numWorkers - 1);
+	for (auto i = 1u; i < m_numWorkers; ++i)
+		m_threads.emplace_back(&TaskScheduler::workerMain, this, i);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		lock_guard<mutex> lock(m_wakeMutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (auto &thread : m_threads) thread.join();
+}
+
+void TaskScheduler::ParallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const RangeFunc &func)
+{
+	if (end <= begin) return;
+
+	grainSize = grainSize > 0 ? grainSize : 1;
+	const auto numChunks = (end - begin + grainSize - 1) / grainSize;
+
+	// Not worth waking up the workers
+	if (m_numWorkers <= 1 || numChunks <= 1)
+	{
+		func(begin, end, 0);
+		return;
+	}
+
+	lock_guard<mutex> submitLock(m_submitMutex);
+
+	// The task must be published before any range becomes visible to stealers
+	m_pFunc = &func;
+	m_numPending = numChunks;
+
+	// Deal out contiguous runs of chunks so that each worker starts with local work
+	for (auto i = 0u; i < m_numWorkers; ++i)
+	{
+		const auto chunkBeg = numChunks * i / m_numWorkers;
+		const auto chunkEnd = numChunks * (i + 1) / m_numWorkers;
+
+		auto &queue = m_queues[i];
+		lock_guard<mutex> lock(queue.Mutex);
+		for (auto j = chunkBeg; j < chunkEnd; ++j)
+		{
+			const auto rangeBeg = begin + j * grainSize;
+			queue.Ranges.push_back({ rangeBeg, min(rangeBeg + grainSize, end) });
+		}
+	}
+
+	{
+		lock_guard<mutex> lock(m_wakeMutex);
+		++m_epoch;
+	}
+	m_wakeCondition.notify_all();
+
+	// Help out, then wait for the stragglers
+	runTasks(0);
+	while (m_numPending.load(memory_order_acquire) > 0) this_thread::yield();
+
+	m_pFunc = nullptr;
+}
+
+uint32_t TaskScheduler::GetNumWorkers() const
+{
+	return m_numWorkers;
+}
+
+TaskScheduler &TaskScheduler::GetDefault()
+{
+	static TaskScheduler scheduler;
+
+	return scheduler;
+}
+
+void TaskScheduler::workerMain(uint32_t workerIdx)
+{
+	auto epoch = 0ull;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> lock(m_wakeMutex);
+			m_wakeCondition.wait(lock, [&]() { return m_quit || m_epoch != epoch; });
+			if (m_quit) return;
+			epoch = m_epoch;
+		}
+
+		runTasks(workerIdx);
+	}
+}
+
+void TaskScheduler::runTasks(uint32_t workerIdx)
+{
+	Range range;
+	while (pop(workerIdx, range) || steal(workerIdx, range))
+	{
+		(*m_pFunc)(range.Begin, range.End, workerIdx);
+		m_numPending.fetch_sub(1, memory_order_release);
+	}
+}
+
+bool TaskScheduler::pop(uint32_t workerIdx, Range &range)
+{
+	auto &queue = m_queues[workerIdx];
+	lock_guard<mutex> lock(queue.Mutex);
+	if (queue.Ranges.empty()) return false;
+
+	// LIFO on the own queue for locality
+	range = queue.Ranges.back();
+	queue.Ranges.pop_back();
+
+	return true;
+}
+
+bool TaskScheduler::steal(uint32_t workerIdx, Range &range)
+{
+	for (auto i = 1u; i < m_numWorkers; ++i)
+	{
+		auto &queue = m_queues[(workerIdx + i) % m_numWorkers];
+		lock_guard<mutex> lock(queue.Mutex);
+		if (queue.Ranges.empty()) continue;
+
+		// FIFO from the victim, taking the work farthest from what it is processing
+		range = queue.Ranges.front();
+		queue.Ranges.pop_front();
+
+		return true;
+	}
+
+	return false;
+}
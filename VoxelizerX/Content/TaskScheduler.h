@@ -0,0 +1,56 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Work-stealing task scheduler for the CPU paths
+//--------------------------------------------------------------------------------------
+class TaskScheduler
+{
+public:
+	using RangeFunc = std::function<void(uint32_t begin, uint32_t end, uint32_t workerIdx)>;
+
+	TaskScheduler(uint32_t numWorkers = 0);
+	virtual ~TaskScheduler();
+
+	// Splits [begin, end) into chunks of grainSize and runs them on all workers.
+	// The calling thread participates as worker 0 and returns when all chunks are done.
+	void ParallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const RangeFunc &func);
+
+	uint32_t GetNumWorkers() const;
+
+	static TaskScheduler &GetDefault();
+
+protected:
+	struct Range
+	{
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex			Mutex;
+		std::deque<Range>	Ranges;
+	};
+
+	void workerMain(uint32_t workerIdx);
+	void runTasks(uint32_t workerIdx);
+	bool pop(uint32_t workerIdx, Range &range);
+	bool steal(uint32_t workerIdx, Range &range);
+
+	std::vector<std::thread>	m_threads;
+	std::unique_ptr<WorkQueue[]> m_queues;
+	uint32_t					m_numWorkers;
+
+	std::mutex					m_submitMutex;
+	std::mutex					m_wakeMutex;
+	std::condition_variable		m_wakeCondition;
+	uint64_t					m_epoch;
+	bool						m_quit;
+
+	const RangeFunc				*m_pFunc;
+	std::atomic<uint32_t>		m_numPending;
+};
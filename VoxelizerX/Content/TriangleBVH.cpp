@@ -0,0 +1,568 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "TriangleBVH.h"
+
+#define NUM_BINS			16
+#define MAX_LEAF_SIZE		4
+#define MAX_DEPTH			48		// Of the binary tree, bounding the traversal stack
+#define STACK_SIZE			(3 * MAX_DEPTH + 4)
+#define MIN_SUBTREE_SIZE	4096	// Smaller nodes are built by a single worker
+#define SUBTREES_PER_WORKER	16
+#define PARALLEL_BIN_SIZE	65536	// Larger nodes are binned across workers
+#define TRI_GRAIN_SIZE		4096
+
+using namespace std;
+
+using float3 = ObjLoader::float3;
+
+const uint32_t TriangleBVH::NoHit;
+
+static inline float3 operator+(const float3 &a, const float3 &b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline float3 operator-(const float3 &a, const float3 &b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline float3 operator*(const float3 &a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+static inline float dot(const float3 &a, const float3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+static inline void growBound(float boundMin[3], float boundMax[3], const float pMin[3], const float pMax[3])
+{
+	for (auto i = 0u; i < 3; ++i)
+	{
+		boundMin[i] = (min)(boundMin[i], pMin[i]);
+		boundMax[i] = (max)(boundMax[i], pMax[i]);
+	}
+}
+
+static inline float halfArea(const float boundMin[3], const float boundMax[3])
+{
+	const auto x = boundMax[0] - boundMin[0], y = boundMax[1] - boundMin[1], z = boundMax[2] - boundMin[2];
+
+	return x * y + y * z + z * x;
+}
+
+// Ericson, Real-Time Collision Detection, 5.1.5: by the Voronoi region of p; returns the squared distance
+static float closestPointTriangle(const float3 &p, const float3 v[3], float3 &q)
+{
+	const auto &a = v[0], &b = v[1], &c = v[2];
+	const auto ab = b - a, ac = c - a, ap = p - a;
+
+	const auto d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) q = a;
+	else
+	{
+		const auto bp = p - b;
+		const auto d3 = dot(ab, bp), d4 = dot(ac, bp);
+		const auto cp = p - c;
+		const auto d5 = dot(ab, cp), d6 = dot(ac, cp);
+		const auto vc = d1 * d4 - d3 * d2;
+		const auto vb = d5 * d2 - d1 * d6;
+		const auto va = d3 * d6 - d5 * d4;
+
+		if (d3 >= 0.0f && d4 <= d3) q = b;
+		else if (d6 >= 0.0f && d5 <= d6) q = c;
+		else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) q = a + ab * (d1 / (d1 - d3));
+		else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) q = a + ac * (d2 / (d2 - d6));
+		else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+			q = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		else
+		{
+			const auto denom = 1.0f / (va + vb + vc);
+			q = a + ab * (vb * denom) + ac * (vc * denom);
+		}
+	}
+
+	const auto d = p - q;
+
+	return dot(d, d);
+}
+
+TriangleBVH::TriangleBVH(TaskScheduler &scheduler) :
+	m_scheduler(scheduler)
+{
+	m_workerBins.resize(m_scheduler.GetNumWorkers());
+	for (auto &bins : m_workerBins) bins.resize(3 * NUM_BINS + 1);	// The last one bounds the centroids
+}
+
+TriangleBVH::~TriangleBVH()
+{
+}
+
+void TriangleBVH::Build(uint32_t numTri, const LoadFunc &loadFunc)
+{
+	m_triangles.resize(numTri);
+	m_primIds.resize(numTri);
+	m_buildPrims.resize(numTri);
+	m_nodes.clear();
+	if (numTri == 0) return;
+
+	// Triangles, centroids and the root bound, reduced per worker
+	const auto numWorkers = m_scheduler.GetNumWorkers();
+	vector<BuildNode> rootBounds(numWorkers);
+	for (auto &bound : rootBounds)
+		for (auto i = 0u; i < 3; ++i)
+		{
+			bound.BoundMin[i] = FLT_MAX;
+			bound.BoundMax[i] = -FLT_MAX;
+		}
+	m_scheduler.ParallelFor(0, numTri, TRI_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		auto &bound = rootBounds[workerIdx];
+		for (auto i = begin; i < end; ++i)
+		{
+			auto &tri = m_triangles[i];
+			loadFunc(i, tri.V);
+
+			auto &prim = m_buildPrims[i];
+			prim.PrimId = i;
+			for (auto a = 0u; a < 3; ++a)
+			{
+				prim.BoundMin[a] = FLT_MAX;
+				prim.BoundMax[a] = -FLT_MAX;
+			}
+			for (const auto &v : tri.V)
+			{
+				const float p[] = { v.x, v.y, v.z };
+				growBound(prim.BoundMin, prim.BoundMax, p, p);
+			}
+			growBound(bound.BoundMin, bound.BoundMax, prim.BoundMin, prim.BoundMax);
+		}
+	});
+
+	vector<BuildNode> nodes(1, rootBounds[0]);
+	for (const auto &bound : rootBounds) growBound(nodes[0].BoundMin, nodes[0].BoundMax, bound.BoundMin, bound.BoundMax);
+	nodes[0].First = 0;
+	nodes[0].Count = numTri;
+	nodes[0].Left = 0;
+
+	// Top levels, down to enough subtrees to keep all workers busy
+	const auto subtreeSize = (max)(numTri / (numWorkers * SUBTREES_PER_WORKER), static_cast<uint32_t>(MIN_SUBTREE_SIZE));
+	vector<pair<uint32_t, uint32_t>> pending(1, make_pair(0u, 0u)), subtrees;	// Node and depth
+	while (!pending.empty())
+	{
+		const auto node = pending.back();
+		pending.pop_back();
+		if (nodes[node.first].Count <= subtreeSize) subtrees.push_back(node);
+		else if (split(nodes, node.first, node.second, 0, nodes[node.first].Count >= PARALLEL_BIN_SIZE))
+		{
+			pending.emplace_back(nodes[node.first].Left, node.second + 1);
+			pending.emplace_back(nodes[node.first].Left + 1, node.second + 1);
+		}
+	}
+
+	// Subtrees by one worker each into their own nodes, then appended
+	vector<vector<BuildNode>> subtreeNodes(subtrees.size());
+	m_scheduler.ParallelFor(0, static_cast<uint32_t>(subtrees.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			subtreeNodes[i].assign(1, nodes[subtrees[i].first]);
+			buildSubtree(subtreeNodes[i], subtrees[i].second, workerIdx);
+		}
+	});
+
+	for (auto i = 0u; i < subtrees.size(); ++i)
+	{
+		// Local node j > 0 lands at base + j - 1
+		const auto base = static_cast<uint32_t>(nodes.size());
+		auto &local = subtreeNodes[i];
+		for (auto &node : local) if (node.Count == 0) node.Left += base - 1;
+		nodes[subtrees[i].first] = local[0];
+		nodes.insert(nodes.end(), local.begin() + 1, local.end());
+		vector<BuildNode>().swap(local);
+	}
+
+	collapse(nodes);
+
+	// Leaf order, so that each leaf reads contiguous triangles
+	vector<Triangle> triangles(numTri);
+	m_scheduler.ParallelFor(0, numTri, TRI_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			m_primIds[i] = m_buildPrims[i].PrimId;
+			triangles[i] = m_triangles[m_primIds[i]];
+		}
+	});
+	m_triangles.swap(triangles);
+	vector<BuildPrim>().swap(m_buildPrims);
+}
+
+void TriangleBVH::Query(const float3 *pPoints, uint32_t numPoints, float maxDist, Hit *pHits) const
+{
+	auto prevTri = NoHit;
+	for (auto i = 0u; i < numPoints; ++i)
+	{
+		const auto &p = pPoints[i];
+		auto bestDistSq = maxDist * maxDist;
+		auto triIdx = NoHit;
+		float3 point = p;
+
+		// The closest triangle of a nearby point bounds the search from the start
+		if (prevTri != NoHit)
+		{
+			float3 q;
+			const auto distSq = closestPointTriangle(p, m_triangles[prevTri].V, q);
+			if (distSq < bestDistSq)
+			{
+				bestDistSq = distSq;
+				triIdx = prevTri;
+				point = q;
+			}
+		}
+
+		if (!m_nodes.empty()) bestDistSq = closestPoint(p, bestDistSq, triIdx, point);
+
+		auto &hit = pHits[i];
+		hit.Distance = triIdx != NoHit ? sqrt(bestDistSq) : maxDist;
+		hit.PrimId = triIdx != NoHit ? m_primIds[triIdx] : NoHit;
+		hit.Point = point;
+		if (triIdx != NoHit) prevTri = triIdx;
+	}
+}
+
+uint32_t TriangleBVH::GetNumTriangles() const
+{
+	return static_cast<uint32_t>(m_triangles.size());
+}
+
+uint32_t TriangleBVH::GetNumNodes() const
+{
+	return static_cast<uint32_t>(m_nodes.size());
+}
+
+bool TriangleBVH::split(vector<BuildNode> &nodes, uint32_t nodeIdx, uint32_t depth, uint32_t workerIdx, bool parallel)
+{
+	const auto node = nodes[nodeIdx];
+	if (node.Count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH) return false;
+
+	const auto primBegin = node.First;
+	const auto primEnd = node.First + node.Count;
+	const auto resetBins = [](vector<Bin> &bins)
+	{
+		for (auto &bin : bins)
+		{
+			for (auto i = 0u; i < 3; ++i)
+			{
+				bin.BoundMin[i] = FLT_MAX;
+				bin.BoundMax[i] = -FLT_MAX;
+			}
+			bin.Count = 0;
+		}
+	};
+
+	// Runs over the triangles of the node, then merges the bins of the workers that took part
+	const auto binTriangles = [&](const TaskScheduler::RangeFunc &func)
+	{
+		auto &bins = m_workerBins[workerIdx];
+		if (parallel)
+		{
+			for (auto &workerBins : m_workerBins) resetBins(workerBins);
+			m_scheduler.ParallelFor(primBegin, primEnd, TRI_GRAIN_SIZE, func);
+			for (auto w = 0u; w < m_workerBins.size(); ++w)
+			{
+				if (w == workerIdx) continue;
+				for (auto i = 0u; i < bins.size(); ++i)
+				{
+					growBound(bins[i].BoundMin, bins[i].BoundMax, m_workerBins[w][i].BoundMin, m_workerBins[w][i].BoundMax);
+					bins[i].Count += m_workerBins[w][i].Count;
+				}
+			}
+		}
+		else
+		{
+			resetBins(bins);
+			func(primBegin, primEnd, workerIdx);
+		}
+
+		return bins;
+	};
+
+	// Centroid bound, which the bins divide; centroids are doubled box centers
+	const auto centroidBins = binTriangles([this](uint32_t begin, uint32_t end, uint32_t w)
+	{
+		auto &bound = m_workerBins[w][3 * NUM_BINS];
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto &prim = m_buildPrims[i];
+			const float c[] = { prim.BoundMin[0] + prim.BoundMax[0], prim.BoundMin[1] + prim.BoundMax[1], prim.BoundMin[2] + prim.BoundMax[2] };
+			growBound(bound.BoundMin, bound.BoundMax, c, c);
+		}
+	});
+	const auto &centroidBound = centroidBins[3 * NUM_BINS];
+
+	float binScales[3];
+	for (auto a = 0u; a < 3; ++a)
+	{
+		const auto extent = centroidBound.BoundMax[a] - centroidBound.BoundMin[a];
+		binScales[a] = extent > 0.0f ? NUM_BINS * (1.0f - 1e-6f) / extent : 0.0f;
+	}
+
+	const auto getBin = [&](const BuildPrim &prim, uint32_t axis)
+	{
+		const auto c = prim.BoundMin[axis] + prim.BoundMax[axis];
+		const auto bin = static_cast<int32_t>((c - centroidBound.BoundMin[axis]) * binScales[axis]);
+
+		return static_cast<uint32_t>((min)((max)(bin, 0), NUM_BINS - 1));
+	};
+
+	// Triangle bounds and counts per bin on all 3 axes
+	const auto bins = binTriangles([&](uint32_t begin, uint32_t end, uint32_t w)
+	{
+		auto &workerBins = m_workerBins[w];
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto &prim = m_buildPrims[i];
+			for (auto a = 0u; a < 3; ++a)
+			{
+				auto &bin = workerBins[a * NUM_BINS + getBin(prim, a)];
+				growBound(bin.BoundMin, bin.BoundMax, prim.BoundMin, prim.BoundMax);
+				++bin.Count;
+			}
+		}
+	});
+
+	// SAH sweep: the suffix from the right, then the prefix from the left
+	auto bestCost = FLT_MAX;
+	auto bestAxis = 0u, bestBin = 0u;
+	Bin left, right[NUM_BINS];
+	for (auto a = 0u; a < 3; ++a)
+	{
+		if (binScales[a] <= 0.0f) continue;
+
+		const auto pBins = &bins[a * NUM_BINS];
+		right[NUM_BINS - 1] = pBins[NUM_BINS - 1];
+		for (auto b = NUM_BINS - 1; b > 0; --b)
+		{
+			right[b - 1] = right[b];
+			growBound(right[b - 1].BoundMin, right[b - 1].BoundMax, pBins[b - 1].BoundMin, pBins[b - 1].BoundMax);
+			right[b - 1].Count += pBins[b - 1].Count;
+		}
+
+		left = pBins[0];
+		for (auto b = 0u; b + 1 < NUM_BINS; ++b)
+		{
+			if (b > 0)
+			{
+				growBound(left.BoundMin, left.BoundMax, pBins[b].BoundMin, pBins[b].BoundMax);
+				left.Count += pBins[b].Count;
+			}
+
+			if (left.Count == 0 || right[b + 1].Count == 0) continue;
+			const auto cost = halfArea(left.BoundMin, left.BoundMax) * left.Count +
+				halfArea(right[b + 1].BoundMin, right[b + 1].BoundMax) * right[b + 1].Count;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = a;
+				bestBin = b;
+			}
+		}
+	}
+
+	BuildNode children[2];
+	for (auto &child : children)
+	{
+		child.Left = 0;
+		for (auto i = 0u; i < 3; ++i)
+		{
+			child.BoundMin[i] = FLT_MAX;
+			child.BoundMax[i] = -FLT_MAX;
+		}
+	}
+
+	auto numLeft = node.Count / 2;
+	if (bestCost < FLT_MAX)
+	{
+		const auto pBins = &bins[bestAxis * NUM_BINS];
+		for (auto b = 0u; b < NUM_BINS; ++b)
+		{
+			auto &child = children[b <= bestBin ? 0 : 1];
+			growBound(child.BoundMin, child.BoundMax, pBins[b].BoundMin, pBins[b].BoundMax);
+		}
+		numLeft = static_cast<uint32_t>(partition(m_buildPrims.begin() + primBegin, m_buildPrims.begin() + primEnd,
+			[&](const BuildPrim &prim) { return getBin(prim, bestAxis) <= bestBin; }) - m_buildPrims.begin()) - primBegin;
+	}
+	else
+	{
+		// Coincident centroids: halve in place
+		for (auto i = primBegin; i < primEnd; ++i)
+		{
+			auto &child = children[i - primBegin < numLeft ? 0 : 1];
+			growBound(child.BoundMin, child.BoundMax, m_buildPrims[i].BoundMin, m_buildPrims[i].BoundMax);
+		}
+	}
+
+	children[0].First = primBegin;
+	children[0].Count = numLeft;
+	children[1].First = primBegin + numLeft;
+	children[1].Count = node.Count - numLeft;
+
+	nodes[nodeIdx].Count = 0;
+	nodes[nodeIdx].Left = static_cast<uint32_t>(nodes.size());
+	nodes.push_back(children[0]);
+	nodes.push_back(children[1]);
+
+	return true;
+}
+
+void TriangleBVH::buildSubtree(vector<BuildNode> &nodes, uint32_t depth, uint32_t workerIdx)
+{
+	vector<pair<uint32_t, uint32_t>> pending(1, make_pair(0u, depth));
+	while (!pending.empty())
+	{
+		const auto node = pending.back();
+		pending.pop_back();
+		if (split(nodes, node.first, node.second, workerIdx, false))
+		{
+			pending.emplace_back(nodes[node.first].Left, node.second + 1);
+			pending.emplace_back(nodes[node.first].Left + 1, node.second + 1);
+		}
+	}
+}
+
+void TriangleBVH::collapse(const vector<BuildNode> &nodes)
+{
+	// Each 4-wide node takes the binary children, opening the largest inner one until 4
+	vector<pair<uint32_t, uint32_t>> pending(1, make_pair(0u, 0u));	// Binary node and 4-wide node
+	m_nodes.resize(1);
+	while (!pending.empty())
+	{
+		const auto node = pending.back();
+		pending.pop_back();
+
+		uint32_t children[4];
+		auto numChildren = 0u;
+		if (nodes[node.first].Count > 0) children[numChildren++] = node.first;	// A leaf root
+		else
+		{
+			children[numChildren++] = nodes[node.first].Left;
+			children[numChildren++] = nodes[node.first].Left + 1;
+		}
+
+		while (numChildren < 4)
+		{
+			auto largest = numChildren;
+			auto largestArea = -1.0f;
+			for (auto i = 0u; i < numChildren; ++i)
+			{
+				const auto &child = nodes[children[i]];
+				const auto area = halfArea(child.BoundMin, child.BoundMax);
+				if (child.Count == 0 && area > largestArea)
+				{
+					largest = i;
+					largestArea = area;
+				}
+			}
+			if (largest == numChildren) break;
+
+			const auto left = nodes[children[largest]].Left;
+			children[largest] = left;
+			children[numChildren++] = left + 1;
+		}
+
+		for (auto i = 0u; i < 4; ++i)
+		{
+			// Empty children are never within any distance
+			auto &dst = m_nodes[node.second];
+			if (i >= numChildren)
+			{
+				for (auto a = 0u; a < 3; ++a)
+				{
+					dst.BoundMin[a][i] = FLT_MAX;
+					dst.BoundMax[a][i] = -FLT_MAX;
+				}
+				dst.Children[i] = 0;
+				dst.Counts[i] = 0;
+				continue;
+			}
+
+			const auto &child = nodes[children[i]];
+			for (auto a = 0u; a < 3; ++a)
+			{
+				dst.BoundMin[a][i] = child.BoundMin[a];
+				dst.BoundMax[a][i] = child.BoundMax[a];
+			}
+			dst.Counts[i] = child.Count;
+			if (child.Count > 0) dst.Children[i] = child.First;
+			else
+			{
+				dst.Children[i] = static_cast<uint32_t>(m_nodes.size());
+				pending.emplace_back(children[i], dst.Children[i]);
+				m_nodes.emplace_back();
+			}
+		}
+	}
+}
+
+float TriangleBVH::closestPoint(const float3 &p, float bestDistSq, uint32_t &triIdx, float3 &point) const
+{
+	const auto px = _mm_set1_ps(p.x);
+	const auto py = _mm_set1_ps(p.y);
+	const auto pz = _mm_set1_ps(p.z);
+	const auto zero = _mm_setzero_ps();
+
+	uint32_t stack[STACK_SIZE];
+	float stackDistSq[STACK_SIZE];
+	stack[0] = 0;
+	stackDistSq[0] = 0.0f;
+	auto stackSize = 1u;
+
+	while (stackSize > 0)
+	{
+		--stackSize;
+		if (stackDistSq[stackSize] >= bestDistSq) continue;
+		const auto &node = m_nodes[stack[stackSize]];
+
+		// Squared distances to the 4 child boxes at once
+		const auto dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.BoundMin[0]), px), _mm_sub_ps(px, _mm_loadu_ps(node.BoundMax[0]))), zero);
+		const auto dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.BoundMin[1]), py), _mm_sub_ps(py, _mm_loadu_ps(node.BoundMax[1]))), zero);
+		const auto dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.BoundMin[2]), pz), _mm_sub_ps(pz, _mm_loadu_ps(node.BoundMax[2]))), zero);
+		const auto distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		const auto mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(distSq, _mm_set1_ps(bestDistSq))));
+		if (!mask) continue;
+
+		float childDistSq[4];
+		_mm_storeu_ps(childDistSq, distSq);
+
+		// Nearest first
+		uint32_t order[4];
+		auto numHits = 0u;
+		for (auto child = 0u; child < 4; ++child)
+		{
+			if (!(mask & (1 << child))) continue;
+			auto i = numHits++;
+			for (; i > 0 && childDistSq[order[i - 1]] > childDistSq[child]; --i) order[i] = order[i - 1];
+			order[i] = child;
+		}
+
+		// Leaves right away, so that the bound tightens before the inner nodes are popped
+		for (auto i = 0u; i < numHits; ++i)
+		{
+			const auto child = order[i];
+			if (node.Counts[child] == 0 || childDistSq[child] >= bestDistSq) continue;
+
+			const auto triEnd = node.Children[child] + node.Counts[child];
+			for (auto t = node.Children[child]; t < triEnd; ++t)
+			{
+				float3 q;
+				const auto triDistSq = closestPointTriangle(p, m_triangles[t].V, q);
+				if (triDistSq < bestDistSq)
+				{
+					bestDistSq = triDistSq;
+					triIdx = t;
+					point = q;
+				}
+			}
+		}
+
+		for (auto i = numHits; i-- > 0;)
+		{
+			const auto child = order[i];
+			if (node.Counts[child] > 0 || childDistSq[child] >= bestDistSq) continue;
+			stack[stackSize] = node.Children[child];
+			stackDistSq[stackSize++] = childDistSq[child];
+		}
+	}
+
+	return bestDistSq;
+}
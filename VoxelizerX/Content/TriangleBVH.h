@@ -0,0 +1,103 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ObjLoader.h"
+#include "TaskScheduler.h"
+
+//--------------------------------------------------------------------------------------
+// Bounding volume hierarchy over a triangle list for closest-point queries. A binary
+// tree is built top-down with binned SAH, the large nodes binned in parallel and the
+// small subtrees built in parallel, then collapsed into 4-wide nodes whose children are
+// tested together with SSE, nearest first.
+//--------------------------------------------------------------------------------------
+class TriangleBVH
+{
+public:
+	using float3 = ObjLoader::float3;
+
+	// Loads the vertices of a triangle, in the space of the queries
+	using LoadFunc = std::function<void(uint32_t primId, float3 v[3])>;
+
+	struct Hit
+	{
+		float		Distance;
+		uint32_t	PrimId;		// NoHit if no triangle is within the distance
+		float3		Point;		// Closest point on the triangle
+	};
+
+	TriangleBVH(TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~TriangleBVH();
+
+	void Build(uint32_t numTri, const LoadFunc &loadFunc);
+
+	// Closest triangles of a batch of points, within maxDist. Each query is first bounded by the
+	// closest triangle of the previous point, so consecutive points should be near each other,
+	// as in Morton order.
+	void Query(const float3 *pPoints, uint32_t numPoints, float maxDist, Hit *pHits) const;
+
+	uint32_t GetNumTriangles() const;
+	uint32_t GetNumNodes() const;
+
+	static const uint32_t NoHit = UINT32_MAX;
+
+protected:
+	struct Triangle
+	{
+		float3		V[3];
+	};
+
+	// Partitioned in place during the build, so that binning reads sequentially
+	struct BuildPrim
+	{
+		float		BoundMin[3];
+		float		BoundMax[3];
+		uint32_t	PrimId;
+	};
+
+	struct BuildNode
+	{
+		float		BoundMin[3];
+		float		BoundMax[3];
+		uint32_t	First;	// Into m_buildPrims, then m_primIds
+		uint32_t	Count;	// 0 for inner nodes, whose children are Left and Left + 1
+		uint32_t	Left;
+	};
+
+	// 4 children in SoA for the SIMD box test; unused children have an empty box
+	struct Node
+	{
+		float		BoundMin[3][4];
+		float		BoundMax[3][4];
+		uint32_t	Children[4];	// Node index, or first triangle of a leaf
+		uint32_t	Counts[4];		// Triangles of a leaf, 0 for inner nodes
+	};
+
+	struct Bin
+	{
+		float		BoundMin[3];
+		float		BoundMax[3];
+		uint32_t	Count;
+	};
+
+	// Splits the node by binned SAH into two children appended to nodes, or returns false to
+	// keep it a leaf; bins across all workers if parallel, otherwise in those of workerIdx
+	bool split(std::vector<BuildNode> &nodes, uint32_t nodeIdx, uint32_t depth, uint32_t workerIdx, bool parallel);
+	void buildSubtree(std::vector<BuildNode> &nodes, uint32_t depth, uint32_t workerIdx);	// From nodes[0]
+	void collapse(const std::vector<BuildNode> &nodes);
+
+	// Traverses nearest first, improving on the triangle, point and squared distance given
+	float closestPoint(const float3 &p, float bestDistSq, uint32_t &triIdx, float3 &point) const;
+
+	TaskScheduler				&m_scheduler;
+
+	std::vector<Triangle>		m_triangles;	// In leaf order after the build
+	std::vector<uint32_t>		m_primIds;		// Of m_triangles
+	std::vector<Node>			m_nodes;		// The root first
+
+	// Build scratch, per triangle and per worker
+	std::vector<BuildPrim>		m_buildPrims;
+	std::vector<std::vector<Bin>> m_workerBins;
+};
@@ -0,0 +1,219 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "TriangleBinner.h"
+
+#define BINS_PER_AXIS		16	// At most; bins are powers of 2 and at least 2^MIN_BIN_SHIFT voxels wide
+#define MIN_BIN_SHIFT		3
+#define MIN_BLOCK_SIZE		4096
+#define BLOCKS_PER_WORKER	4
+
+using namespace std;
+
+const uint32_t TriangleBinner::NoBin;
+
+// Bin range packed by TriangleBinner::visitBins()
+static inline void unpackRange(uint32_t range, uint32_t rangeMin[3], uint32_t rangeMax[3])
+{
+	for (auto i = 0u; i < 3; ++i)
+	{
+		rangeMin[i] = (range >> (i * 4)) & 0xf;
+		rangeMax[i] = (range >> (i * 4 + 12)) & 0xf;
+	}
+}
+
+TriangleBinner::TriangleBinner(uint32_t gridSize, TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_gridSize(gridSize),
+	m_binShift(MIN_BIN_SHIFT)
+{
+	while ((static_cast<uint32_t>(BINS_PER_AXIS) << m_binShift) < gridSize) ++m_binShift;
+	m_binsPerAxis = (gridSize + GetBinSize() - 1) >> m_binShift;
+	m_binOffsets.push_back(0);
+}
+
+TriangleBinner::~TriangleBinner()
+{
+}
+
+void TriangleBinner::Bin(uint32_t numTri, const LoadFunc &loadFunc)
+{
+	const auto numBins = m_binsPerAxis * m_binsPerAxis * m_binsPerAxis;
+
+	// Fixed triangle blocks, so that the scatter replays the partition of the count
+	const auto maxBlocks = m_scheduler.GetNumWorkers() * BLOCKS_PER_WORKER;
+	const auto blockSize = (max)((numTri + maxBlocks - 1) / maxBlocks, static_cast<uint32_t>(MIN_BLOCK_SIZE));
+	const auto numBlocks = (numTri + blockSize - 1) / blockSize;
+
+	// Count the bin references per block, remembering the bin ranges for the scatter
+	m_blockCounts.assign(static_cast<size_t>(numBlocks) * numBins, 0);
+	m_triangleRanges.resize(numTri);
+	m_scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			const auto pCounts = &m_blockCounts[static_cast<size_t>(b) * numBins];
+			const auto triEnd = (min)((b + 1) * blockSize, numTri);
+			for (auto i = b * blockSize; i < triEnd; ++i)
+			{
+				float3 v[3];
+				loadFunc(i, v);
+				m_triangleRanges[i] = visitBins(v, [pCounts](uint32_t bin) { ++pCounts[bin]; });
+			}
+		}
+	});
+
+	// Bin-major exclusive scan, turning the counts into the scatter cursors of each block
+	m_bins.clear();
+	m_binSlots.assign(numBins, NoBin);
+	m_binOffsets.clear();
+	auto numRefs = 0u;
+	for (auto bin = 0u; bin < numBins; ++bin)
+	{
+		const auto binOffset = numRefs;
+		for (auto b = 0u; b < numBlocks; ++b)
+		{
+			auto &count = m_blockCounts[static_cast<size_t>(b) * numBins + bin];
+			const auto blockCount = count;
+			count = numRefs;
+			numRefs += blockCount;
+		}
+
+		if (numRefs > binOffset)
+		{
+			m_binSlots[bin] = static_cast<uint32_t>(m_bins.size());
+			m_bins.push_back(bin);
+			m_binOffsets.push_back(binOffset);
+		}
+	}
+	m_binOffsets.push_back(numRefs);
+
+	// Scatter in triangle order; each block owns its cursors, and only triangles
+	// spanning several bins walk their footprint again
+	m_triangles.resize(numRefs);
+	m_scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			const auto pCursors = &m_blockCounts[static_cast<size_t>(b) * numBins];
+			const auto triEnd = (min)((b + 1) * blockSize, numTri);
+			for (auto i = b * blockSize; i < triEnd; ++i)
+			{
+				const auto range = m_triangleRanges[i];
+				if (range == NoBin) continue;
+
+				if ((range & 0xfff) == (range >> 12))
+				{
+					uint32_t rangeMin[3], rangeMax[3];
+					unpackRange(range, rangeMin, rangeMax);
+					m_triangles[pCursors[(rangeMin[2] * m_binsPerAxis + rangeMin[1]) * m_binsPerAxis + rangeMin[0]]++] = i;
+				}
+				else
+				{
+					float3 v[3];
+					loadFunc(i, v);
+					visitBins(v, [&](uint32_t bin) { m_triangles[pCursors[bin]++] = i; });
+				}
+			}
+		}
+	});
+
+	m_rebinned.clear();
+	m_rebinnedTriangles.clear();
+	m_dirtyBins.clear();
+	m_dirtyFlags.assign(numBins, 0);
+}
+
+void TriangleBinner::Rebin(uint32_t firstTri, uint32_t numTri, const LoadFunc &loadFunc)
+{
+	const auto numBins = m_binsPerAxis * m_binsPerAxis * m_binsPerAxis;
+	const auto numTriTotal = static_cast<uint32_t>(m_triangleRanges.size());
+	const auto triEnd = firstTri + (min)(numTri, numTriTotal - (min)(firstTri, numTriTotal));
+	if (m_rebinned.empty())
+	{
+		m_rebinned.assign(numTriTotal, 0);
+		m_rebinnedTriangles.resize(numBins);
+	}
+
+	const auto markDirty = [this](uint32_t bin)
+	{
+		if (!m_dirtyFlags[bin]) m_dirtyBins.push_back(bin);
+		m_dirtyFlags[bin] = 1;
+	};
+
+	// Serial, as edits are expected to be small; costs only the rebinned triangles
+	for (auto i = firstTri; i < triEnd; ++i)
+	{
+		// Bins left, where the triangle may have written; conservatively its whole bin range
+		const auto range = m_triangleRanges[i];
+		if (range != NoBin)
+		{
+			uint32_t rangeMin[3], rangeMax[3];
+			unpackRange(range, rangeMin, rangeMax);
+			for (auto z = rangeMin[2]; z <= rangeMax[2]; ++z)
+				for (auto y = rangeMin[1]; y <= rangeMax[1]; ++y)
+					for (auto x = rangeMin[0]; x <= rangeMax[0]; ++x)
+					{
+						const auto bin = (z * m_binsPerAxis + y) * m_binsPerAxis + x;
+						markDirty(bin);
+						if (m_rebinned[i])
+						{
+							auto &triangles = m_rebinnedTriangles[bin];
+							triangles.erase(remove(triangles.begin(), triangles.end(), i), triangles.end());
+						}
+					}
+		}
+
+		// Bins entered
+		float3 v[3];
+		loadFunc(i, v);
+		m_triangleRanges[i] = visitBins(v, [&](uint32_t bin)
+		{
+			markDirty(bin);
+			m_rebinnedTriangles[bin].push_back(i);
+		});
+		m_rebinned[i] = 1;
+	}
+
+	sort(m_dirtyBins.begin(), m_dirtyBins.end());
+}
+
+void TriangleBinner::ClearDirtyBins()
+{
+	for (const auto bin : m_dirtyBins) m_dirtyFlags[bin] = 0;
+	m_dirtyBins.clear();
+}
+
+const vector<uint32_t> &TriangleBinner::GetBins() const
+{
+	return m_bins;
+}
+
+const vector<uint32_t> &TriangleBinner::GetDirtyBins() const
+{
+	return m_dirtyBins;
+}
+
+void TriangleBinner::GetBox(uint32_t bin, uint32_t boxMin[3], uint32_t boxMax[3]) const
+{
+	boxMin[0] = bin % m_binsPerAxis << m_binShift;
+	boxMin[1] = bin / m_binsPerAxis % m_binsPerAxis << m_binShift;
+	boxMin[2] = bin / (m_binsPerAxis * m_binsPerAxis) << m_binShift;
+	for (auto i = 0u; i < 3; ++i) boxMax[i] = (min)(boxMin[i] + GetBinSize(), m_gridSize) - 1;
+}
+
+uint64_t TriangleBinner::GetNumReferences() const
+{
+	return m_triangles.size();
+}
+
+uint32_t TriangleBinner::GetGridSize() const
+{
+	return m_gridSize;
+}
+
+uint32_t TriangleBinner::GetBinSize() const
+{
+	return 1u << m_binShift;
+}
@@ -0,0 +1,199 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ObjLoader.h"
+#include "TaskScheduler.h"
+
+//--------------------------------------------------------------------------------------
+// Sorts triangles into bins of the voxel grid by the footprint of their plane along the
+// dominant axis, with a parallel counting sort. Bins are disjoint, so the CPU voxelizer
+// hands each one to a single worker, which then writes its voxels without atomics.
+// Triangles spanning several bins are listed in each of them. Rebin() moves a range of
+// edited triangles to the bins of their new positions, without touching the others.
+//--------------------------------------------------------------------------------------
+class TriangleBinner
+{
+public:
+	using float3 = ObjLoader::float3;
+
+	// Loads the voxel-space vertices of a triangle
+	using LoadFunc = std::function<void(uint32_t primId, float3 v[3])>;
+
+	TriangleBinner(uint32_t gridSize, TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~TriangleBinner();
+
+	void Bin(uint32_t numTri, const LoadFunc &loadFunc);
+
+	// Triangles in [firstTri, firstTri + numTri) changed since binned; the bins they left or
+	// entered are added to GetDirtyBins(), the only ones needing re-voxelization
+	void Rebin(uint32_t firstTri, uint32_t numTri, const LoadFunc &loadFunc);
+	void ClearDirtyBins();
+
+	// Bins are identified by their linear index in the grid of bins
+	const std::vector<uint32_t> &GetBins() const;		// Non-empty bins of Bin(), in ascending order
+	const std::vector<uint32_t> &GetDirtyBins() const;	// Since ClearDirtyBins(), in ascending order
+	void GetBox(uint32_t bin, uint32_t boxMin[3], uint32_t boxMax[3]) const;	// Inclusive voxel range
+	uint64_t GetNumReferences() const;	// Triangles summed over the bins of Bin()
+
+	// Calls func(primId) for every triangle of the bin, rebinned ones included
+	template<typename Func>
+	void VisitTriangles(uint32_t bin, const Func &func) const;
+
+	uint32_t GetGridSize() const;
+	uint32_t GetBinSize() const;
+
+	// Calls func(brickMin, brickMax) with inclusive ranges of the 2^brickShift-wide bricks covering
+	// every voxel the triangle can write, with a 1-voxel margin; shared with SparseGrid::MarkTriangle
+	template<typename Func>
+	static void VisitBricks(const float3 v[3], uint32_t gridSize, uint32_t brickShift, const Func &func);
+
+protected:
+	// Calls func(bin) for the bins of the triangle and returns their packed bin range, or NoBin
+	template<typename Func>
+	uint32_t visitBins(const float3 v[3], const Func &func) const;
+
+	TaskScheduler			&m_scheduler;
+
+	std::vector<uint32_t>	m_blockCounts;	// Per block and bin, then the scatter cursors
+	std::vector<uint32_t>	m_triangleRanges;	// Packed bin range of each triangle, or NoBin
+	std::vector<uint32_t>	m_bins;
+	std::vector<uint32_t>	m_binSlots;		// Index into m_bins of each bin, or NoBin if empty
+	std::vector<uint32_t>	m_binOffsets;	// Into m_triangles, one past the last bin too
+	std::vector<uint32_t>	m_triangles;
+
+	// Rebinned triangles are skipped in m_triangles and listed per bin instead
+	std::vector<uint8_t>	m_rebinned;
+	std::vector<std::vector<uint32_t>> m_rebinnedTriangles;
+	std::vector<uint32_t>	m_dirtyBins;
+	std::vector<uint8_t>	m_dirtyFlags;
+
+	uint32_t				m_gridSize;
+	uint32_t				m_binShift;
+	uint32_t				m_binsPerAxis;
+
+	static const uint32_t NoBin = UINT32_MAX;
+};
+
+template<typename Func>
+void TriangleBinner::VisitTriangles(uint32_t bin, const Func &func) const
+{
+	const auto slot = m_binSlots[bin];
+	if (slot != NoBin)
+	{
+		for (auto i = m_binOffsets[slot]; i < m_binOffsets[slot + 1]; ++i)
+		{
+			const auto primId = m_triangles[i];
+			if (m_rebinned.empty() || !m_rebinned[primId]) func(primId);
+		}
+	}
+
+	if (!m_rebinnedTriangles.empty())
+		for (const auto primId : m_rebinnedTriangles[bin]) func(primId);
+}
+
+template<typename Func>
+uint32_t TriangleBinner::visitBins(const float3 v[3], const Func &func) const
+{
+	// 4 bits per coordinate, as there are at most 16 bins per axis
+	uint32_t rangeMin[3] = { UINT32_MAX, UINT32_MAX, UINT32_MAX }, rangeMax[3] = { 0, 0, 0 };
+	VisitBricks(v, m_gridSize, m_binShift, [&](const uint32_t binMin[3], const uint32_t binMax[3])
+	{
+		for (auto i = 0u; i < 3; ++i)
+		{
+			rangeMin[i] = (std::min)(rangeMin[i], binMin[i]);
+			rangeMax[i] = (std::max)(rangeMax[i], binMax[i]);
+		}
+
+		for (auto z = binMin[2]; z <= binMax[2]; ++z)
+			for (auto y = binMin[1]; y <= binMax[1]; ++y)
+				for (auto x = binMin[0]; x <= binMax[0]; ++x)
+					func((z * m_binsPerAxis + y) * m_binsPerAxis + x);
+	});
+
+	return rangeMin[0] == UINT32_MAX ? NoBin : rangeMin[0] | (rangeMin[1] << 4) | (rangeMin[2] << 8) |
+		(rangeMax[0] << 12) | (rangeMax[1] << 16) | (rangeMax[2] << 20);
+}
+
+template<typename Func>
+void TriangleBinner::VisitBricks(const float3 v[3], uint32_t gridSize, uint32_t brickShift, const Func &func)
+{
+	// In voxels, covers the 1/3-pixel extrapolation and rounding
+	const auto margin = 1.0;
+
+	const double p[3][3] =
+	{
+		{ v[0].x, v[0].y, v[0].z },
+		{ v[1].x, v[1].y, v[1].z },
+		{ v[2].x, v[2].y, v[2].z }
+	};
+
+	// Voxel-space AABB with margin
+	double lo[3], hi[3];
+	for (auto i = 0u; i < 3; ++i)
+	{
+		lo[i] = (std::min)((std::min)(p[0][i], p[1][i]), p[2][i]) - margin;
+		hi[i] = (std::max)((std::max)(p[0][i], p[1][i]), p[2][i]) + margin;
+		if (!(hi[i] >= 0.0 && lo[i] < gridSize)) return;	// Also rejects NaN
+		lo[i] = (std::max)(lo[i], 0.0);
+		hi[i] = (std::min)(hi[i], gridSize - 1.0);
+	}
+
+	uint32_t brickLo[3], brickHi[3];
+	for (auto i = 0u; i < 3; ++i)
+	{
+		brickLo[i] = static_cast<uint32_t>(lo[i]) >> brickShift;
+		brickHi[i] = static_cast<uint32_t>(hi[i]) >> brickShift;
+	}
+
+	// Most triangles are small enough to stay in one brick, margin included
+	if (brickLo[0] == brickHi[0] && brickLo[1] == brickHi[1] && brickLo[2] == brickHi[2])
+	{
+		func(brickLo, brickHi);
+		return;
+	}
+
+	// Dominant axis of the triangle plane
+	const double e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+	const double e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+	const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+	const auto d = std::abs(n[0]) > std::abs(n[1]) ? (std::abs(n[0]) > std::abs(n[2]) ? 0u : 2u) :
+		(std::abs(n[1]) > std::abs(n[2]) ? 1u : 2u);
+	const auto u = (d + 1) % 3;
+	const auto w = (d + 2) % 3;
+
+	// Degenerate triangles can still produce writes along their edges; keep the whole AABB.
+	if (!(std::abs(n[d]) > 0.0))
+	{
+		func(brickLo, brickHi);
+		return;
+	}
+
+	// Walk the brick columns of the dominant-axis footprint, keeping only the
+	// bricks crossed by the triangle plane within each column.
+	const auto du = -n[u] / n[d];
+	const auto dw = -n[w] / n[d];
+	for (auto bw = brickLo[w]; bw <= brickHi[w]; ++bw)
+	{
+		for (auto bu = brickLo[u]; bu <= brickHi[u]; ++bu)
+		{
+			// Column extent, clipped to the footprint of the triangle
+			const auto u0 = (std::max)(static_cast<double>(bu << brickShift), lo[u]) - p[0][u];
+			const auto u1 = (std::min)(static_cast<double>((bu + 1) << brickShift), hi[u] + 1.0) - p[0][u];
+			const auto w0 = (std::max)(static_cast<double>(bw << brickShift), lo[w]) - p[0][w];
+			const auto w1 = (std::min)(static_cast<double>((bw + 1) << brickShift), hi[w] + 1.0) - p[0][w];
+			const auto depthMin = p[0][d] + (std::min)(du * u0, du * u1) + (std::min)(dw * w0, dw * w1) - margin;
+			const auto depthMax = p[0][d] + (std::max)(du * u0, du * u1) + (std::max)(dw * w0, dw * w1) + margin;
+			if (depthMax < lo[d] || depthMin > hi[d]) continue;
+
+			uint32_t brickMin[3], brickMax[3];
+			brickMin[u] = brickMax[u] = bu;
+			brickMin[w] = brickMax[w] = bw;
+			brickMin[d] = static_cast<uint32_t>((std::max)(depthMin, lo[d])) >> brickShift;
+			brickMax[d] = static_cast<uint32_t>((std::min)(depthMax, hi[d])) >> brickShift;
+			func(brickMin, brickMax);
+		}
+	}
+}
@@ -0,0 +1,146 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "VertexQuantizer.h"
+
+#define QUANT_GRAIN_SIZE	(1 << 14)
+#define POSITION_MAX		65535.0f
+#define NORMAL_MAX			32767.0f
+
+using namespace std;
+
+static inline float signNotZero(float f)
+{
+	return f >= 0.0f ? 1.0f : -1.0f;
+}
+
+void VertexQuantizer::Quantize(const uint8_t *pVertices, uint32_t numVert, uint32_t stride,
+	const float3 &center, const float3 &extent, QuantizedVertex *pQuantized, TaskScheduler &scheduler)
+{
+	// Flat axes quantize to the center
+	const float3 scale(extent.x > 0.0f ? 0.5f / extent.x : 0.0f, extent.y > 0.0f ? 0.5f / extent.y : 0.0f,
+		extent.z > 0.0f ? 0.5f / extent.z : 0.0f);
+	const auto quantize = [](float pos, float center, float scale)
+	{
+		const auto f = (pos - center) * scale + 0.5f;
+		return static_cast<uint16_t>((f > 0.0f ? (f < 1.0f ? f : 1.0f) : 0.0f) * POSITION_MAX + 0.5f);
+	};
+
+	scheduler.ParallelFor(0, numVert, QUANT_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto &vertex = *reinterpret_cast<const ObjLoader::Vertex*>(&pVertices[static_cast<size_t>(stride) * i]);
+			auto &quantized = pQuantized[i];
+			quantized.m_uPosition[0] = quantize(vertex.m_vPosition.x, center.x, scale.x);
+			quantized.m_uPosition[1] = quantize(vertex.m_vPosition.y, center.y, scale.y);
+			quantized.m_uPosition[2] = quantize(vertex.m_vPosition.z, center.z, scale.z);
+			EncodeNormal(vertex.m_vNormal, quantized.m_iNormal);
+		}
+	});
+}
+
+VertexQuantizer::Error VertexQuantizer::MeasureError(const uint8_t *pVertices, uint32_t numVert, uint32_t stride,
+	const QuantizedVertex *pQuantized, const float3 &center, const float3 &extent, TaskScheduler &scheduler)
+{
+	// Per-worker maxima
+	vector<Error> errors(scheduler.GetNumWorkers(), Error{ 0.0f, 0.0f });
+	scheduler.ParallelFor(0, numVert, QUANT_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		auto &error = errors[workerIdx];
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto &vertex = *reinterpret_cast<const ObjLoader::Vertex*>(&pVertices[static_cast<size_t>(stride) * i]);
+			const auto pos = DecodePosition(pQuantized[i], center, extent);
+			error.Position = (max)(error.Position, abs(pos.x - vertex.m_vPosition.x));
+			error.Position = (max)(error.Position, abs(pos.y - vertex.m_vPosition.y));
+			error.Position = (max)(error.Position, abs(pos.z - vertex.m_vPosition.z));
+
+			// Zero normals have no direction to compare
+			const auto &n = vertex.m_vNormal;
+			const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			if (l <= 0.0f) continue;
+
+			// atan2 keeps the precision for tiny angles, unlike acos of the dot product
+			const auto nrm = DecodeNormal(pQuantized[i]);
+			const auto cx = nrm.y * n.z - nrm.z * n.y;
+			const auto cy = nrm.z * n.x - nrm.x * n.z;
+			const auto cz = nrm.x * n.y - nrm.y * n.x;
+			const auto angle = atan2(sqrt(cx * cx + cy * cy + cz * cz), nrm.x * n.x + nrm.y * n.y + nrm.z * n.z);
+			error.Normal = (max)(error.Normal, angle * 180.0f / 3.14159265f);
+		}
+	});
+
+	Error error = { 0.0f, 0.0f };
+	for (const auto &e : errors)
+	{
+		error.Position = (max)(error.Position, e.Position);
+		error.Normal = (max)(error.Normal, e.Normal);
+	}
+
+	return error;
+}
+
+VertexQuantizer::float3 VertexQuantizer::DecodePosition(const QuantizedVertex &vertex, const float3 &center, const float3 &extent)
+{
+	return float3(center.x + (vertex.m_uPosition[0] * (2.0f / POSITION_MAX) - 1.0f) * extent.x,
+		center.y + (vertex.m_uPosition[1] * (2.0f / POSITION_MAX) - 1.0f) * extent.y,
+		center.z + (vertex.m_uPosition[2] * (2.0f / POSITION_MAX) - 1.0f) * extent.z);
+}
+
+VertexQuantizer::float3 VertexQuantizer::DecodeNormal(const QuantizedVertex &vertex)
+{
+	auto x = (max)(vertex.m_iNormal[0] / NORMAL_MAX, -1.0f);
+	auto y = (max)(vertex.m_iNormal[1] / NORMAL_MAX, -1.0f);
+	const auto z = 1.0f - abs(x) - abs(y);
+
+	// Unfold the lower hemisphere
+	if (z < 0.0f)
+	{
+		const auto u = x;
+		x = (1.0f - abs(y)) * signNotZero(u);
+		y = (1.0f - abs(u)) * signNotZero(y);
+	}
+
+	const auto l = sqrt(x * x + y * y + z * z);
+
+	return float3(x / l, y / l, z / l);
+}
+
+void VertexQuantizer::EncodeNormal(const float3 &normal, int16_t oct[2])
+{
+	oct[0] = oct[1] = 0;
+	const auto l1 = abs(normal.x) + abs(normal.y) + abs(normal.z);
+	if (l1 <= 0.0f) return;
+
+	// Project onto the octahedron, folding the lower hemisphere
+	auto u = normal.x / l1;
+	auto v = normal.y / l1;
+	if (normal.z < 0.0f)
+	{
+		const auto x = u;
+		u = (1.0f - abs(v)) * signNotZero(x);
+		v = (1.0f - abs(x)) * signNotZero(v);
+	}
+
+	// Rounding each coordinate is not the closest on the sphere, so try all 4 neighbors
+	const auto fu = floor(u * NORMAL_MAX);
+	const auto fv = floor(v * NORMAL_MAX);
+	auto bestCos = -2.0f;
+	for (auto i = 0u; i < 4; ++i)
+	{
+		QuantizedVertex candidate;
+		candidate.m_iNormal[0] = static_cast<int16_t>((max)((min)(fu + (i & 1), NORMAL_MAX), -NORMAL_MAX));
+		candidate.m_iNormal[1] = static_cast<int16_t>((max)((min)(fv + (i >> 1), NORMAL_MAX), -NORMAL_MAX));
+
+		const auto n = DecodeNormal(candidate);
+		const auto cosAngle = n.x * normal.x + n.y * normal.y + n.z * normal.z;
+		if (cosAngle > bestCos)
+		{
+			bestCos = cosAngle;
+			oct[0] = candidate.m_iNormal[0];
+			oct[1] = candidate.m_iNormal[1];
+		}
+	}
+}
@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ObjLoader.h"
+
+//--------------------------------------------------------------------------------------
+// Compressed vertex stream: positions as 16-bit unorm inside the mesh bound and normals
+// as octahedral 2x16-bit snorm, 10 bytes per vertex instead of 24
+//--------------------------------------------------------------------------------------
+class VertexQuantizer
+{
+public:
+	using float3			= ObjLoader::float3;
+	using QuantizedVertex	= ObjLoader::QuantizedVertex;
+
+	// Largest deviations from the float vertices
+	struct Error
+	{
+		float	Position;	// Per axis, in object units
+		float	Normal;		// Angle in degrees
+	};
+
+	// The bound is the center and half extents, as computed by ObjLoader
+	static void Quantize(const uint8_t *pVertices, uint32_t numVert, uint32_t stride,
+		const float3 &center, const float3 &extent, QuantizedVertex *pQuantized,
+		TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	static Error MeasureError(const uint8_t *pVertices, uint32_t numVert, uint32_t stride,
+		const QuantizedVertex *pQuantized, const float3 &center, const float3 &extent,
+		TaskScheduler &scheduler = TaskScheduler::GetDefault());
+
+	static float3 DecodePosition(const QuantizedVertex &vertex, const float3 &center, const float3 &extent);
+	static float3 DecodeNormal(const QuantizedVertex &vertex);
+
+	// Keeps the nearest of the 4 surrounding codes; a zero normal decodes to +Z
+	static void EncodeNormal(const float3 &normal, int16_t oct[2]);
+};
@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "VoxelGrid.h"
+
+#define CLEAR_GRAIN_SIZE	(1 << 16)
+#define SLICE_GRAIN_SIZE	1
+
+using namespace std;
+
+template<typename Layout>
+VoxelGrid<Layout>::VoxelGrid(uint32_t gridSize, TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_gridSize(0),
+	m_paddedSize(0),
+	m_numVoxels(0)
+{
+	Resize(gridSize);
+}
+
+template<typename Layout>
+VoxelGrid<Layout>::~VoxelGrid()
+{
+}
+
+template<typename Layout>
+void VoxelGrid<Layout>::Resize(uint32_t gridSize)
+{
+	const auto paddedSize = Layout::GetPaddedSize(gridSize);
+	const auto numVoxels = static_cast<uint64_t>(paddedSize) * paddedSize * paddedSize;
+	if (numVoxels != m_numVoxels) m_voxels = make_unique<atomic<uint32_t>[]>(static_cast<size_t>(numVoxels));
+
+	m_gridSize = gridSize;
+	m_paddedSize = paddedSize;
+	m_numVoxels = numVoxels;
+	Clear();
+}
+
+template<typename Layout>
+void VoxelGrid<Layout>::Clear()
+{
+	const auto numBlocks = static_cast<uint32_t>((m_numVoxels + CLEAR_GRAIN_SIZE - 1) / CLEAR_GRAIN_SIZE);
+	m_scheduler.ParallelFor(0, numBlocks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		const auto blockEnd = (min)(static_cast<uint64_t>(end) * CLEAR_GRAIN_SIZE, m_numVoxels);
+		for (auto i = static_cast<uint64_t>(begin) * CLEAR_GRAIN_SIZE; i < blockEnd; ++i)
+			m_voxels[i].store(0, memory_order_relaxed);
+	});
+}
+
+template<typename Layout>
+void VoxelGrid<Layout>::FromLinear(const vector<uint32_t> &grid)
+{
+	const auto gridSize = static_cast<size_t>(m_gridSize);
+	if (grid.size() != gridSize * gridSize * gridSize) return;
+
+	m_scheduler.ParallelFor(0, m_gridSize, SLICE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto z = begin; z < end; ++z)
+			for (auto y = 0u; y < m_gridSize; ++y)
+				for (auto x = 0u; x < m_gridSize; ++x)
+					m_voxels[GetIndex(x, y, z)].store(grid[(z * gridSize + y) * gridSize + x], memory_order_relaxed);
+	});
+}
+
+template<typename Layout>
+void VoxelGrid<Layout>::ToLinear(vector<uint32_t> &grid) const
+{
+	const auto gridSize = static_cast<size_t>(m_gridSize);
+	grid.resize(gridSize * gridSize * gridSize);
+
+	m_scheduler.ParallelFor(0, m_gridSize, SLICE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto z = begin; z < end; ++z)
+			for (auto y = 0u; y < m_gridSize; ++y)
+				for (auto x = 0u; x < m_gridSize; ++x)
+					grid[(z * gridSize + y) * gridSize + x] = Read(x, y, z);
+	});
+}
+
+template class VoxelGrid<LinearLayout>;
+template class VoxelGrid<MortonLayout>;
+template class VoxelGrid<TiledLayout>;
@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelLayout.h"
+#include "TaskScheduler.h"
+
+//--------------------------------------------------------------------------------------
+// Dense voxel grid of packed uint32_t stored in the given layout; 0 is empty
+//--------------------------------------------------------------------------------------
+template<typename Layout>
+class VoxelGrid
+{
+public:
+	VoxelGrid(uint32_t gridSize = 0, TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~VoxelGrid();
+
+	void Resize(uint32_t gridSize);
+	void Clear();
+
+	// Equivalent to InterlockedMax()
+	void Write(uint32_t x, uint32_t y, uint32_t z, uint32_t data);
+	uint32_t Read(uint32_t x, uint32_t y, uint32_t z) const;
+
+	// Conversions from and to the linear layout of VoxelizerCPU::GetGrid()
+	void FromLinear(const std::vector<uint32_t> &grid);
+	void ToLinear(std::vector<uint32_t> &grid) const;
+
+	uint32_t GetGridSize() const { return m_gridSize; }
+	uint32_t GetPaddedSize() const { return m_paddedSize; }
+	uint64_t GetIndex(uint32_t x, uint32_t y, uint32_t z) const { return Layout::Encode(x, y, z, m_paddedSize); }
+	uint64_t GetNumVoxels() const { return m_numVoxels; }	// Including the padding
+	const uint32_t *GetData() const { return reinterpret_cast<const uint32_t*>(m_voxels.get()); }
+	uint32_t *GetData() { return reinterpret_cast<uint32_t*>(m_voxels.get()); }	// For passes owning disjoint voxels
+
+protected:
+	TaskScheduler							&m_scheduler;
+	std::unique_ptr<std::atomic<uint32_t>[]> m_voxels;
+
+	uint32_t								m_gridSize;
+	uint32_t								m_paddedSize;
+	uint64_t								m_numVoxels;
+};
+
+template<typename Layout>
+inline void VoxelGrid<Layout>::Write(uint32_t x, uint32_t y, uint32_t z, uint32_t data)
+{
+	auto &voxel = m_voxels[GetIndex(x, y, z)];
+	auto prev = voxel.load(std::memory_order_relaxed);
+	while (prev < data && !voxel.compare_exchange_weak(prev, data, std::memory_order_relaxed));
+}
+
+template<typename Layout>
+inline uint32_t VoxelGrid<Layout>::Read(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return m_voxels[GetIndex(x, y, z)].load(std::memory_order_relaxed);
+}
+
+using LinearVoxelGrid	= VoxelGrid<LinearLayout>;
+using MortonVoxelGrid	= VoxelGrid<MortonLayout>;
+using TiledVoxelGrid	= VoxelGrid<TiledLayout>;
@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// BMI2 pdep/pext encode and decode in a single instruction each. AVX2 implies BMI2 on
+// all shipping CPUs; note that pre-Zen3 AMD parts implement them in slow microcode.
+#ifndef VOXEL_LAYOUT_BMI2
+#if (defined(__BMI2__) || defined(__AVX2__)) && (defined(_M_X64) || defined(__x86_64__))
+#define VOXEL_LAYOUT_BMI2	1
+#else
+#define VOXEL_LAYOUT_BMI2	0
+#endif
+#endif
+
+//--------------------------------------------------------------------------------------
+// Voxel storage layouts: (x, y, z) <-> storage index for a grid padded to GetPaddedSize()
+//--------------------------------------------------------------------------------------
+
+// Same order as the GPU grid and VoxelizerCPU::GetGrid(): x fastest, then y, then z
+struct LinearLayout
+{
+	static const char *GetName() { return "Linear"; }
+
+	static uint32_t GetPaddedSize(uint32_t gridSize) { return gridSize; }
+
+	static uint64_t Encode(uint32_t x, uint32_t y, uint32_t z, uint32_t paddedSize)
+	{
+		return (static_cast<uint64_t>(z) * paddedSize + y) * paddedSize + x;
+	}
+
+	static void Decode(uint64_t index, uint32_t paddedSize, uint32_t &x, uint32_t &y, uint32_t &z)
+	{
+		x = static_cast<uint32_t>(index % paddedSize);
+		y = static_cast<uint32_t>(index / paddedSize % paddedSize);
+		z = static_cast<uint32_t>(index / paddedSize / paddedSize);
+	}
+};
+
+// Z-order curve with x in bit 0, y in bit 1 and z in bit 2 of each octet; 21 bits per axis
+struct MortonLayout
+{
+	static const char *GetName() { return "Morton"; }
+
+	static uint32_t GetPaddedSize(uint32_t gridSize)
+	{
+		auto paddedSize = 1u;
+		while (paddedSize < gridSize) paddedSize <<= 1;
+
+		return paddedSize;
+	}
+
+	static uint64_t Encode(uint32_t x, uint32_t y, uint32_t z, uint32_t = 0)
+	{
+#if VOXEL_LAYOUT_BMI2
+		return _pdep_u64(x, 0x1249249249249249ull) | _pdep_u64(y, 0x2492492492492492ull) |
+			_pdep_u64(z, 0x4924924924924924ull);
+#else
+		return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+#endif
+	}
+
+	static void Decode(uint64_t index, uint32_t, uint32_t &x, uint32_t &y, uint32_t &z)
+	{
+#if VOXEL_LAYOUT_BMI2
+		x = static_cast<uint32_t>(_pext_u64(index, 0x1249249249249249ull));
+		y = static_cast<uint32_t>(_pext_u64(index, 0x2492492492492492ull));
+		z = static_cast<uint32_t>(_pext_u64(index, 0x4924924924924924ull));
+#else
+		x = compactBits(index);
+		y = compactBits(index >> 1);
+		z = compactBits(index >> 2);
+#endif
+	}
+
+	// Interleaves the lower 21 bits of v with two zero bits between each
+	static uint64_t spreadBits(uint32_t v)
+	{
+		auto x = static_cast<uint64_t>(v & 0x1fffff);
+		x = (x | x << 32) & 0x1f00000000ffffull;
+		x = (x | x << 16) & 0x1f0000ff0000ffull;
+		x = (x | x << 8) & 0x100f00f00f00f00full;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+		x = (x | x << 2) & 0x1249249249249249ull;
+
+		return x;
+	}
+
+	// Inverse of spreadBits()
+	static uint32_t compactBits(uint64_t x)
+	{
+		x &= 0x1249249249249249ull;
+		x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ull;
+		x = (x ^ (x >> 4)) & 0x100f00f00f00f00full;
+		x = (x ^ (x >> 8)) & 0x1f0000ff0000ffull;
+		x = (x ^ (x >> 16)) & 0x1f00000000ffffull;
+		x = (x ^ (x >> 32)) & 0x1fffff;
+
+		return static_cast<uint32_t>(x);
+	}
+};
+
+// TileSize^3 tiles in linear order, each tile stored linearly: a tile row is one 16-byte vector
+struct TiledLayout
+{
+	static const uint32_t TileSize = 4;
+	static const uint32_t TileShift = 2;
+	static const uint32_t VoxelsPerTile = TileSize * TileSize * TileSize;
+
+	static const char *GetName() { return "Tiled4x4x4"; }
+
+	static uint32_t GetPaddedSize(uint32_t gridSize)
+	{
+		return (gridSize + TileSize - 1) & ~(TileSize - 1);
+	}
+
+	static uint64_t Encode(uint32_t x, uint32_t y, uint32_t z, uint32_t paddedSize)
+	{
+		const auto tilesPerAxis = paddedSize >> TileShift;
+		const auto tile = (static_cast<uint64_t>(z >> TileShift) * tilesPerAxis + (y >> TileShift)) *
+			tilesPerAxis + (x >> TileShift);
+		const auto mask = TileSize - 1;
+
+		return tile * VoxelsPerTile + ((((z & mask) << TileShift) | (y & mask)) << TileShift | (x & mask));
+	}
+
+	static void Decode(uint64_t index, uint32_t paddedSize, uint32_t &x, uint32_t &y, uint32_t &z)
+	{
+		const auto tilesPerAxis = paddedSize >> TileShift;
+		const auto tile = index / VoxelsPerTile;
+		const auto voxel = static_cast<uint32_t>(index % VoxelsPerTile);
+		const auto mask = TileSize - 1;
+		x = static_cast<uint32_t>(tile % tilesPerAxis) << TileShift | (voxel & mask);
+		y = static_cast<uint32_t>(tile / tilesPerAxis % tilesPerAxis) << TileShift | ((voxel >> TileShift) & mask);
+		z = static_cast<uint32_t>(tile / tilesPerAxis / tilesPerAxis) << TileShift | (voxel >> (2 * TileShift));
+	}
+};
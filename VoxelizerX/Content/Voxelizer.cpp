@@ -1,4 +1,5 @@
 #include "ObjLoader.h"
+#include "MeshOptimizer.h"
 #include "Voxelizer.h"
 
 using namespace std;
@@ -7,7 +8,10 @@ using namespace XUSG;
 
 Voxelizer::Voxelizer(const Device &device, const CommandList &commandList) :
 	m_device(device),
-	m_commandList(commandList)
+	m_commandList(commandList),
+	m_version(1),
+	m_gridVersions(),
+	m_gridModes()
 {
 	m_graphicsPipelineCache.SetDevice(device);
 	m_computePipelineCache.SetDevice(device);
@@ -20,7 +24,7 @@ Voxelizer::~Voxelizer()
 }
 
 bool Voxelizer::Init(uint32_t width, uint32_t height, Format rtFormat, Format dsFormat,
-	Resource &vbUpload, Resource &ibUpload, const char *fileName)
+	Resource &vbUpload, Resource &ibUpload, const char *fileName, uint32_t gridSize, bool anisotropic, bool optimizeMesh)
 {
 	m_viewport.x = static_cast<float>(width);
 	m_viewport.y = static_cast<float>(height);
@@ -30,28 +34,50 @@ bool Voxelizer::Init(uint32_t width, uint32_t height, Format rtFormat, Format ds
 
 	// Load inputs
 	ObjLoader objLoader;
-	if (!objLoader.Import(fileName, true, true)) return false;
+	if (!objLoader.Import(fileName, true, true, true)) return false;
 
 	createInputLayout();
-	N_RETURN(createVB(objLoader.GetNumVertices(), objLoader.GetVertexStride(), objLoader.GetVertices(), vbUpload), false);
-	N_RETURN(createIB(objLoader.GetNumIndices(), objLoader.GetIndices(), ibUpload), false);
+	if (optimizeMesh)
+	{
+		// Welded and cache-ordered copies; the bound is unchanged
+		const auto pVertices = reinterpret_cast<const ObjLoader::Vertex*>(objLoader.GetVertices());
+		ObjLoader::vVertex vertices(pVertices, pVertices + objLoader.GetNumVertices());
+		ObjLoader::vuint indices(objLoader.GetIndices(), objLoader.GetIndices() + objLoader.GetNumIndices());
+		MeshOptimizer::Optimize(vertices, indices);
+
+		N_RETURN(createVB(static_cast<uint32_t>(vertices.size()), objLoader.GetVertexStride(),
+			reinterpret_cast<const uint8_t*>(vertices.data()), vbUpload), false);
+		N_RETURN(createIB(static_cast<uint32_t>(indices.size()), indices.data(), ibUpload), false);
+	}
+	else
+	{
+		N_RETURN(createVB(objLoader.GetNumVertices(), objLoader.GetVertexStride(), objLoader.GetVertices(), vbUpload), false);
+		N_RETURN(createIB(objLoader.GetNumIndices(), objLoader.GetIndices(), ibUpload), false);
+	}
 
-	// Extract boundary
+	// Extract boundary; flat axes keep at least one voxel of thickness, as in VoxelizerCPU
 	const auto center = objLoader.GetCenter();
-	m_bound = XMFLOAT4(center.x, center.y, center.z, objLoader.GetRadius());
-
-	m_numLevels = max(static_cast<uint32_t>(log2(GRID_SIZE)), 1);
+	const auto radius = objLoader.GetRadius();
+	const auto extent = anisotropic ? objLoader.GetExtent() : ObjLoader::float3(radius, radius, radius);
+	const auto minExtent = radius / gridSize;
+	m_bound = XMFLOAT4(center.x, center.y, center.z, radius);
+	m_extent = XMFLOAT4((max)(extent.x, minExtent), (max)(extent.y, minExtent), (max)(extent.z, minExtent), 0.0f);
+
+	m_gridSize = gridSize;
+	m_numLevels = max(static_cast<uint32_t>(log2(m_gridSize)), 1);
 	N_RETURN(createCBs(), false);
 
 	for (auto &grid : m_grids)
-		N_RETURN(grid.Create(m_device, GRID_SIZE, GRID_SIZE, GRID_SIZE, DXGI_FORMAT_R10G10B10A2_UNORM, BIND_PACKED_UAV), false);
+		N_RETURN(grid.Create(m_device, m_gridSize, m_gridSize, m_gridSize, DXGI_FORMAT_R10G10B10A2_UNORM,
+			BIND_PACKED_UAV, static_cast<uint8_t>(m_numLevels)), false);
 
 	for (auto &KBufferDepth : m_KBufferDepths)
-		N_RETURN(KBufferDepth.Create(m_device, GRID_SIZE, GRID_SIZE, DXGI_FORMAT_R32_UINT, static_cast<uint32_t>(GRID_SIZE * DEPTH_SCALE),
+		N_RETURN(KBufferDepth.Create(m_device, m_gridSize, m_gridSize, DXGI_FORMAT_R32_UINT, static_cast<uint32_t>(m_gridSize * DEPTH_SCALE),
 			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), false);
 
 	// Prepare for rendering
 	N_RETURN(prevoxelize(), false);
+	N_RETURN(predownsample(), false);
 	N_RETURN(prerenderBoxArray(rtFormat, dsFormat), false);
 	N_RETURN(prerayCast(rtFormat, dsFormat), false);
 
@@ -61,7 +87,7 @@ bool Voxelizer::Init(uint32_t width, uint32_t height, Format rtFormat, Format ds
 void Voxelizer::UpdateFrame(uint32_t frameIndex, CXMVECTOR eyePt, CXMMATRIX viewProj)
 {
 	// General matrices
-	const auto world = XMMatrixScaling(m_bound.w, m_bound.w, m_bound.w) *
+	const auto world = XMMatrixScaling(m_extent.x, m_extent.y, m_extent.z) *
 		XMMatrixTranslation(m_bound.x, m_bound.y, m_bound.z);
 	const auto worldI = XMMatrixInverse(nullptr, world);
 	const auto worldViewProj = world * viewProj;
@@ -91,8 +117,17 @@ void Voxelizer::UpdateFrame(uint32_t frameIndex, CXMVECTOR eyePt, CXMMATRIX view
 	XMStoreFloat4(&pCbPerFrame->eyePos, eyePt);
 }
 
-void Voxelizer::Render(bool solid, Method voxMethod, uint32_t frameIndex, const RenderTargetTable &rtvs, const Descriptor &dsv)
+void Voxelizer::Render(bool solid, Method voxMethod, uint32_t frameIndex, const RenderTargetTable &rtvs,
+	const Descriptor &dsv, uint8_t showMip)
 {
+	showMip = min<uint8_t>(showMip, static_cast<uint8_t>(m_numLevels - 1));
+
+	// Only re-voxelize a stale grid; the mips are regenerated with it
+	const auto gridMode = static_cast<uint8_t>(voxMethod | (solid ? 0x80 : 0));
+	const auto revoxelize = m_gridVersions[frameIndex] != m_version || m_gridModes[frameIndex] != gridMode;
+	m_gridVersions[frameIndex] = m_version;
+	m_gridModes[frameIndex] = gridMode;
+
 	if (solid)
 	{
 		const DescriptorPool descriptorPools[] =
@@ -102,8 +137,12 @@ void Voxelizer::Render(bool solid, Method voxMethod, uint32_t frameIndex, const
 		};
 		m_commandList.SetDescriptorPools(static_cast<uint32_t>(size(descriptorPools)), descriptorPools);
 
-		voxelizeSolid(voxMethod, frameIndex);
-		renderRayCast(frameIndex, rtvs, dsv);
+		if (revoxelize)
+		{
+			voxelizeSolid(voxMethod, frameIndex);
+			downsample(frameIndex);
+		}
+		renderRayCast(frameIndex, showMip, rtvs, dsv);
 	}
 	else
 	{
@@ -111,11 +150,30 @@ void Voxelizer::Render(bool solid, Method voxMethod, uint32_t frameIndex, const
 		{ m_descriptorTableCache.GetDescriptorPool(CBV_SRV_UAV_POOL) };
 		m_commandList.SetDescriptorPools(static_cast<uint32_t>(size(descriptorPools)), descriptorPools);
 
-		voxelize(voxMethod, frameIndex);
-		renderBoxArray(frameIndex, rtvs, dsv);
+		if (revoxelize)
+		{
+			voxelize(voxMethod, frameIndex);
+			downsample(frameIndex);
+		}
+		renderBoxArray(frameIndex, showMip, rtvs, dsv);
 	}
 }
 
+void Voxelizer::MarkDirty()
+{
+	++m_version;
+}
+
+uint32_t Voxelizer::GetGridSize() const
+{
+	return m_gridSize;
+}
+
+uint8_t Voxelizer::GetNumLevels() const
+{
+	return static_cast<uint8_t>(m_numLevels);
+}
+
 bool Voxelizer::createShaders()
 {
 	N_RETURN(m_shaderPool.CreateShader(Shader::Stage::VS, VS_TRI_PROJ, L"VSTriProj.cso"), false);
@@ -135,6 +193,7 @@ bool Voxelizer::createShaders()
 	N_RETURN(m_shaderPool.CreateShader(Shader::Stage::PS, PS_RAY_CAST, L"PSRayCast.cso"), false);
 
 	N_RETURN(m_shaderPool.CreateShader(Shader::Stage::CS, CS_FILL_SOLID, L"CSFillSolid.cso"), false);
+	N_RETURN(m_shaderPool.CreateShader(Shader::Stage::CS, CS_DOWNSAMPLE, L"CSDownsample.cso"), false);
 
 	return true;
 }
@@ -167,10 +226,11 @@ bool Voxelizer::createCBs()
 
 	// Immutable CBs
 	{
-		N_RETURN(m_cbBound.Create(m_device, sizeof(XMFLOAT4)), false);
+		N_RETURN(m_cbBound.Create(m_device, sizeof(XMFLOAT4[2])), false);
 
 		const auto pCbBound = reinterpret_cast<XMFLOAT4*>(m_cbBound.Map());
-		*pCbBound = m_bound;
+		pCbBound[0] = m_bound;
+		pCbBound[1] = m_extent;
 		m_cbBound.Unmap();
 	}
 
@@ -178,7 +238,7 @@ bool Voxelizer::createCBs()
 	for (auto i = 0u; i < m_numLevels; ++i)
 	{
 		auto &cb = m_cbPerMipLevels[i];
-		const auto gridSize = static_cast<float>(GRID_SIZE >> i);
+		const auto gridSize = static_cast<float>(m_gridSize >> i);
 		N_RETURN(cb.Create(m_device, sizeof(XMFLOAT4)), false);
 
 		const auto pCbData = reinterpret_cast<float*>(cb.Map());
@@ -203,16 +263,37 @@ void Voxelizer::createInputLayout()
 	m_inputLayout = m_graphicsPipelineCache.CreateInputLayout(inputElementDescs);
 }
 
-bool Voxelizer::prevoxelize(uint8_t mipLevel)
+bool Voxelizer::createGridSRVTables(uint8_t frameIndex)
+{
+	if (!m_srvGridTables[frameIndex].empty()) return true;
+
+	m_srvGridTables[frameIndex].resize(m_numLevels);
+	for (auto i = 0ui8; i < m_numLevels; ++i)
+	{
+		// Per-level SRVs only exist for mipmapped grids
+		const auto srv = m_numLevels > 1 ? m_grids[frameIndex].GetSRVLevel(i) : m_grids[frameIndex].GetSRV();
+		Util::DescriptorTable utilSrvTable;
+		utilSrvTable.SetDescriptors(0, 1, &srv);
+		X_RETURN(m_srvGridTables[frameIndex][i], utilSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+	}
+
+	return true;
+}
+
+bool Voxelizer::prevoxelize()
 {
 	// Get CBVs
 	Util::DescriptorTable utilCbvTable;
 	utilCbvTable.SetDescriptors(0, 1, &m_cbBound.GetCBV());
 	X_RETURN(m_cbvTables[CBV_TABLE_VOXELIZE], utilCbvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
 
-	Util::DescriptorTable utilCbvPerMipLevelTable;
-	utilCbvPerMipLevelTable.SetDescriptors(0, 1, &m_cbPerMipLevels[mipLevel].GetCBV());
-	X_RETURN(m_cbvTables[CBV_TABLE_PER_MIP], utilCbvPerMipLevelTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+	m_cbvPerMipTables.resize(m_numLevels);
+	for (auto i = 0u; i < m_numLevels; ++i)
+	{
+		Util::DescriptorTable utilCbvPerMipLevelTable;
+		utilCbvPerMipLevelTable.SetDescriptors(0, 1, &m_cbPerMipLevels[i].GetCBV());
+		X_RETURN(m_cbvPerMipTables[i], utilCbvPerMipLevelTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+	}
 
 	// Get SRVs
 	const Descriptor srvs[] = { m_indexbuffer.GetSRV(), m_vertexBuffer.GetSRV() };
@@ -337,6 +418,36 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 	return true;
 }
 
+bool Voxelizer::predownsample()
+{
+	// Get UAVs
+	for (auto i = 0ui8; i < FrameCount; ++i)
+	{
+		m_uavDownsampleTables[i].resize(m_numLevels - 1);
+		for (auto j = 0ui8; j + 1u < m_numLevels; ++j)
+		{
+			const Descriptor uavs[] = { m_grids[i].GetUAV(j), m_grids[i].GetUAV(j + 1) };
+			Util::DescriptorTable utilUavTable;
+			utilUavTable.SetDescriptors(0, static_cast<uint32_t>(size(uavs)), uavs);
+			X_RETURN(m_uavDownsampleTables[i][j], utilUavTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		}
+	}
+
+	// Get compute pipeline layout
+	Util::PipelineLayout utilPipelineLayout;
+	utilPipelineLayout.SetRange(0, DescriptorType::UAV, 2, 0);
+	X_RETURN(m_pipelineLayouts[PASS_DOWNSAMPLE], utilPipelineLayout.GetPipelineLayout(
+		m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"DownsamplePass"), false);
+
+	// Get compute pipeline
+	Compute::State state;
+	state.SetPipelineLayout(m_pipelineLayouts[PASS_DOWNSAMPLE]);
+	state.SetShader(m_shaderPool.GetShader(Shader::Stage::CS, CS_DOWNSAMPLE));
+	X_RETURN(m_pipelines[PASS_DOWNSAMPLE], state.GetPipeline(m_computePipelineCache, L"Downsample"), false);
+
+	return true;
+}
+
 bool Voxelizer::prerenderBoxArray(Format rtFormat, Format dsFormat)
 {
 	for (auto i = 0ui8; i < FrameCount; ++i)
@@ -346,21 +457,18 @@ bool Voxelizer::prerenderBoxArray(Format rtFormat, Format dsFormat)
 		utilCbvTable.SetDescriptors(0, 1, &m_cbMatrices.GetCBV(i));
 		X_RETURN(m_cbvTables[CBV_TABLE_MATRICES + i], utilCbvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
 
-		// Get SRV
-		if (!m_srvTables[SRV_TABLE_GRID + i])
-		{
-			Util::DescriptorTable utilSrvTable;
-			utilSrvTable.SetDescriptors(0, 1, &m_grids[i].GetSRV());
-			X_RETURN(m_srvTables[SRV_TABLE_GRID + i], utilSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
-		}
+		// Get SRVs
+		N_RETURN(createGridSRVTables(i), false);
 	}
 
 	// Get pipeline layout
 	Util::PipelineLayout utilPipelineLayout;
 	utilPipelineLayout.SetRange(0, DescriptorType::CBV, 1, 0);
 	utilPipelineLayout.SetRange(1, DescriptorType::SRV, 1, 0);
+	utilPipelineLayout.SetRange(2, DescriptorType::CBV, 1, 1);
 	utilPipelineLayout.SetShaderStage(0, Shader::Stage::VS);
 	utilPipelineLayout.SetShaderStage(1, Shader::Stage::VS);
+	utilPipelineLayout.SetShaderStage(2, Shader::Stage::VS);
 	X_RETURN(m_pipelineLayouts[PASS_DRAW_AS_BOX], utilPipelineLayout.GetPipelineLayout(
 		m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"DrawAsBoxPass"), false);
 
@@ -386,13 +494,8 @@ bool Voxelizer::prerayCast(Format rtFormat, Format dsFormat)
 		utilCbvTable.SetDescriptors(0, 1, &m_cbPerObject.GetCBV(i));
 		X_RETURN(m_cbvTables[CBV_TABLE_PER_OBJ + i], utilCbvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
 
-		// Get SRV
-		if (!m_srvTables[SRV_TABLE_GRID + i])
-		{
-			Util::DescriptorTable utilSrvTable;
-			utilSrvTable.SetDescriptors(0, 1, &m_grids[i].GetSRV());
-			X_RETURN(m_srvTables[SRV_TABLE_GRID + i], utilSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
-		}
+		// Get SRVs
+		N_RETURN(createGridSRVTables(i), false);
 	}
 
 	// Create the sampler table
@@ -450,7 +553,7 @@ void Voxelizer::voxelize(Method voxMethod, uint32_t frameIndex, bool depthPeel,
 	m_grids[frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	if (depthPeel) m_KBufferDepths[frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	m_commandList.SetGraphicsDescriptorTable(0, m_cbvTables[CBV_TABLE_VOXELIZE]);
-	m_commandList.SetGraphicsDescriptorTable(1, m_cbvTables[CBV_TABLE_PER_MIP]);
+	m_commandList.SetGraphicsDescriptorTable(1, m_cbvPerMipTables[mipLevel]);
 	m_commandList.SetGraphicsDescriptorTable(2, m_uavTables[frameIndex][UAV_TABLE_VOXELIZE]);
 	switch (voxMethod)
 	{
@@ -458,7 +561,7 @@ void Voxelizer::voxelize(Method voxMethod, uint32_t frameIndex, bool depthPeel,
 		m_commandList.SetGraphicsDescriptorTable(3, m_srvTables[SRV_TABLE_VB_IB]);
 		break;
 	case TRI_PROJ_TESS:
-		m_commandList.SetGraphicsDescriptorTable(3, m_cbvTables[CBV_TABLE_PER_MIP]);
+		m_commandList.SetGraphicsDescriptorTable(3, m_cbvPerMipTables[mipLevel]);
 		break;
 	}
 
@@ -466,7 +569,7 @@ void Voxelizer::voxelize(Method voxMethod, uint32_t frameIndex, bool depthPeel,
 	m_commandList.SetPipelineState(m_pipelines[pipeIdx]);
 
 	// Set viewport
-	const auto gridSize = GRID_SIZE >> mipLevel;
+	const auto gridSize = m_gridSize >> mipLevel;
 	const auto fGridSize = static_cast<float>(gridSize);
 	Viewport viewport(0.0f, 0.0f, fGridSize, fGridSize);
 	RectRange scissorRect(0, 0, gridSize, gridSize);
@@ -504,7 +607,7 @@ void Voxelizer::voxelizeSolid(Method voxMethod, uint32_t frameIndex, uint8_t mip
 	m_commandList.SetComputePipelineLayout(m_pipelineLayouts[PASS_FILL_SOLID]);
 	m_grids[frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	m_KBufferDepths[frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	m_commandList.SetComputeDescriptorTable(0, m_cbvTables[CBV_TABLE_PER_MIP]);
+	m_commandList.SetComputeDescriptorTable(0, m_cbvPerMipTables[mipLevel]);
 	m_commandList.SetComputeDescriptorTable(1, m_srvTables[SRV_K_DEPTH + frameIndex]);
 	m_commandList.SetComputeDescriptorTable(2, m_uavTables[frameIndex][UAV_TABLE_VOXELIZE]);
 
@@ -512,22 +615,44 @@ void Voxelizer::voxelizeSolid(Method voxMethod, uint32_t frameIndex, uint8_t mip
 	m_commandList.SetPipelineState(m_pipelines[PASS_FILL_SOLID]);
 
 	// Record commands.
-	m_commandList.Dispatch(GRID_SIZE / 32, GRID_SIZE / 16, GRID_SIZE);
+	const auto gridSize = m_gridSize >> mipLevel;
+	m_commandList.Dispatch((gridSize + 31) / 32, (gridSize + 15) / 16, gridSize);
+}
+
+void Voxelizer::downsample(uint32_t frameIndex)
+{
+	if (m_numLevels <= 1) return;
+
+	// Set pipeline layout and state
+	m_commandList.SetComputePipelineLayout(m_pipelineLayouts[PASS_DOWNSAMPLE]);
+	m_commandList.SetPipelineState(m_pipelines[PASS_DOWNSAMPLE]);
+
+	// Record commands: each level reads the previous one
+	for (auto i = 1u; i < m_numLevels; ++i)
+	{
+		m_grids[frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		m_commandList.SetComputeDescriptorTable(0, m_uavDownsampleTables[frameIndex][i - 1]);
+
+		const auto numGroups = ((max)(m_gridSize >> i, 1u) + 3) / 4;
+		m_commandList.Dispatch(numGroups, numGroups, numGroups);
+	}
 }
 
-void Voxelizer::renderBoxArray(uint32_t frameIndex, const RenderTargetTable &rtvs, const Descriptor &dsv)
+void Voxelizer::renderBoxArray(uint32_t frameIndex, uint8_t mipLevel, const RenderTargetTable &rtvs,
+	const Descriptor &dsv)
 {
 	// Set descriptor tables
 	m_commandList.SetGraphicsPipelineLayout(m_pipelineLayouts[PASS_DRAW_AS_BOX]);
 	m_grids[frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	m_commandList.SetGraphicsDescriptorTable(0, m_cbvTables[CBV_TABLE_MATRICES + frameIndex]);
-	m_commandList.SetGraphicsDescriptorTable(1, m_srvTables[SRV_TABLE_GRID + frameIndex]);
+	m_commandList.SetGraphicsDescriptorTable(1, m_srvGridTables[frameIndex][mipLevel]);
+	m_commandList.SetGraphicsDescriptorTable(2, m_cbvPerMipTables[mipLevel]);
 
 	// Set pipeline state
 	m_commandList.SetPipelineState(m_pipelines[PASS_DRAW_AS_BOX]);
 
 	// Set viewport
-	const auto gridSize = GRID_SIZE >> SHOW_MIP;
+	const auto gridSize = m_gridSize >> mipLevel;
 	Viewport viewport(0.0f, 0.0f, m_viewport.x, m_viewport.y);
 	RectRange scissorRect(0, 0, static_cast<long>(m_viewport.x), static_cast<long>(m_viewport.y));
 	m_commandList.RSSetViewports(1, &viewport);
@@ -540,13 +665,14 @@ void Voxelizer::renderBoxArray(uint32_t frameIndex, const RenderTargetTable &rtv
 	m_commandList.Draw(4, 6 * gridSize * gridSize * gridSize, 0, 0);
 }
 
-void Voxelizer::renderRayCast(uint32_t frameIndex, const RenderTargetTable &rtvs, const Descriptor &dsv)
+void Voxelizer::renderRayCast(uint32_t frameIndex, uint8_t mipLevel, const RenderTargetTable &rtvs,
+	const Descriptor &dsv)
 {
 	// Set descriptor tables
 	m_commandList.SetGraphicsPipelineLayout(m_pipelineLayouts[PASS_RAY_CAST]);
 	m_grids[frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 	m_commandList.SetGraphicsDescriptorTable(0, m_cbvTables[CBV_TABLE_PER_OBJ + frameIndex]);
-	m_commandList.SetGraphicsDescriptorTable(1, m_srvTables[SRV_TABLE_GRID + frameIndex]);
+	m_commandList.SetGraphicsDescriptorTable(1, m_srvGridTables[frameIndex][mipLevel]);
 	m_commandList.SetGraphicsDescriptorTable(2, m_samplerTable);
 
 	// Set pipeline state
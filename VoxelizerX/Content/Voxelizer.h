@@ -21,10 +21,20 @@ public:
 
 	bool Init(uint32_t width, uint32_t height, XUSG::Format rtFormat, XUSG::Format dsFormat,
 		XUSG::Resource &vbUpload, XUSG::Resource &ibUpload,
-		const char *fileName = "Media\\bunny.obj");
+		const char *fileName = "Media\\bunny.obj", uint32_t gridSize = GRID_SIZE,
+		bool anisotropic = false,	// Anisotropic scales each axis to fill the grid
+		bool optimizeMesh = false);	// Welds and reorders the mesh for the vertex cache before upload
 	void UpdateFrame(uint32_t frameIndex, DirectX::CXMVECTOR eyePt, DirectX::CXMMATRIX viewProj);
 	void Render(bool solid, Method voxMethod, uint32_t frameIndex,
-		const XUSG::RenderTargetTable &rtvs, const XUSG::Descriptor &dsv);
+		const XUSG::RenderTargetTable &rtvs, const XUSG::Descriptor &dsv,
+		uint8_t showMip = SHOW_MIP);
+
+	// The grid of a frame is reused by Render() until the mesh is marked dirty,
+	// or the method or the solid mode changes
+	void MarkDirty();
+
+	uint32_t GetGridSize() const;
+	uint8_t GetNumLevels() const;
 
 	static const uint32_t FrameCount = FRAME_COUNT;
 
@@ -38,6 +48,7 @@ protected:
 		PASS_VOXELIZE_UNION,
 		PASS_VOXELIZE_UNION_SOLID,
 		PASS_FILL_SOLID,
+		PASS_DOWNSAMPLE,
 		PASS_DRAW_AS_BOX,
 		PASS_RAY_CAST,
 
@@ -47,7 +58,6 @@ protected:
 	enum CBVTable : uint8_t
 	{
 		CBV_TABLE_VOXELIZE,
-		CBV_TABLE_PER_MIP,
 		CBV_TABLE_MATRICES,
 		CBV_TABLE_PER_OBJ = CBV_TABLE_MATRICES + FrameCount,
 
@@ -58,9 +68,8 @@ protected:
 	{
 		SRV_TABLE_VB_IB,
 		SRV_K_DEPTH,
-		SRV_TABLE_GRID = SRV_K_DEPTH + FrameCount,
 
-		NUM_SRV_TABLE = SRV_TABLE_GRID + FrameCount
+		NUM_SRV_TABLE = SRV_K_DEPTH + FrameCount
 	};
 
 	enum UAVTable : uint8_t
@@ -102,7 +111,8 @@ protected:
 
 	enum ComputeShaderID : uint8_t
 	{
-		CS_FILL_SOLID
+		CS_FILL_SOLID,
+		CS_DOWNSAMPLE
 	};
 
 	struct CBMatrices
@@ -129,13 +139,18 @@ protected:
 	bool createIB(uint32_t numIndices, const uint32_t *pData, XUSG::Resource &ibUpload);
 	bool createCBs();
 	void createInputLayout();
-	bool prevoxelize(uint8_t mipLevel = 0);
+	bool createGridSRVTables(uint8_t frameIndex);
+	bool prevoxelize();
+	bool predownsample();
 	bool prerenderBoxArray(XUSG::Format rtFormat, XUSG::Format dsFormat);
 	bool prerayCast(XUSG::Format rtFormat, XUSG::Format dsFormat);
 	void voxelize(Method voxMethod, uint32_t frameIndex, bool depthPeel = false, uint8_t mipLevel = 0);
 	void voxelizeSolid(Method voxMethod, uint32_t frameIndex, uint8_t mipLevel = 0);
-	void renderBoxArray(uint32_t frameIndex, const XUSG::RenderTargetTable &rtvs, const XUSG::Descriptor &dsv);
-	void renderRayCast(uint32_t frameIndex, const XUSG::RenderTargetTable &rtvs, const XUSG::Descriptor &dsv);
+	void downsample(uint32_t frameIndex);
+	void renderBoxArray(uint32_t frameIndex, uint8_t mipLevel, const XUSG::RenderTargetTable &rtvs,
+		const XUSG::Descriptor &dsv);
+	void renderRayCast(uint32_t frameIndex, uint8_t mipLevel, const XUSG::RenderTargetTable &rtvs,
+		const XUSG::Descriptor &dsv);
 
 	XUSG::Device m_device;
 	XUSG::CommandList m_commandList;
@@ -153,6 +168,9 @@ protected:
 	XUSG::DescriptorTable	m_cbvTables[NUM_CBV_TABLE];
 	XUSG::DescriptorTable	m_srvTables[NUM_SRV_TABLE];
 	XUSG::DescriptorTable	m_uavTables[FrameCount][NUM_UAV_TABLE];
+	std::vector<XUSG::DescriptorTable> m_cbvPerMipTables;
+	std::vector<XUSG::DescriptorTable> m_srvGridTables[FrameCount];		// Per mip level
+	std::vector<XUSG::DescriptorTable> m_uavDownsampleTables[FrameCount];	// Level i and i + 1
 	XUSG::DescriptorTable	m_samplerTable;
 
 	XUSG::VertexBuffer		m_vertexBuffer;
@@ -167,9 +185,15 @@ protected:
 	XUSG::Texture3D			m_grids[FrameCount];
 	XUSG::Texture2D			m_KBufferDepths[FrameCount];
 
-	DirectX::XMFLOAT4		m_bound;
+	DirectX::XMFLOAT4		m_bound;		// Center and radius
+	DirectX::XMFLOAT4		m_extent;		// Half extents, all equal to the radius unless anisotropic
 	DirectX::XMFLOAT2		m_viewport;
 
+	uint32_t				m_gridSize;
 	uint32_t				m_numLevels;
 	uint32_t				m_numIndices;
+
+	uint32_t				m_version;					// Bumped by MarkDirty()
+	uint32_t				m_gridVersions[FrameCount];	// Version each frame's grid was voxelized from
+	uint8_t					m_gridModes[FrameCount];	// Method and solid flag of each frame's grid
 };
@@ -0,0 +1,984 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "VoxelizerCPU.h"
+#include "SolidFill.h"
+#include "WindingNumber.h"
+#include "VertexQuantizer.h"
+#include "SatKernel.h"
+
+#define SUBPIXEL_BITS		8
+#define SUBPIXEL_SCALE		(1 << SUBPIXEL_BITS)
+#define CONSERVATION_AMT	(1.0f / 3.0f)	// Same as DSTriProj.hlsli
+#define TRI_GRAIN_SIZE		64
+
+using namespace std;
+
+using float3 = ObjLoader::float3;
+
+static inline float3 operator+(const float3 &a, const float3 &b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline float3 operator-(const float3 &a, const float3 &b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline float3 operator*(const float3 &a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+
+// Same as the ftou instruction: round toward zero, negatives and NaN go to 0
+static inline uint32_t ftou(float f)
+{
+	return f > 0.0f ? static_cast<uint32_t>(f) : 0;
+}
+
+// Row-major 3x4 affine transform of a column vector
+static inline float3 transformPos(const float m[3][4], const float3 &p)
+{
+	return float3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+		m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+		m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+}
+
+// Same as the saturate intrinsic: NaN goes to 0
+static inline float saturate(float f)
+{
+	return f > 0.0f ? (f < 1.0f ? f : 1.0f) : 0.0f;
+}
+
+VoxelizerCPU::VoxelizerCPU(uint32_t gridSize, TaskScheduler &scheduler) :
+	m_scheduler(scheduler),
+	m_binner(gridSize, scheduler),
+	m_numNormalSums(0),
+	m_gridSize(gridSize),
+	m_numLevels(1),
+	m_resolve(RESOLVE_MAX),
+	m_pVertices(nullptr),
+	m_pIndices(nullptr),
+	m_numVertices(0),
+	m_numIndices(0),
+	m_stride(0),
+	m_pQuantizedVertices(nullptr),
+	m_center(0.0f, 0.0f, 0.0f),
+	m_extent(1.0f, 1.0f, 1.0f),
+	m_quantScale(0.0f, 0.0f, 0.0f),
+	m_quantBias(0.0f, 0.0f, 0.0f)
+{
+	m_satVoxels.resize(m_scheduler.GetNumWorkers());
+
+	// Same as Voxelizer::Init(): max(floor(log2(gridSize)), 1)
+	while ((gridSize >> (m_numLevels + 1)) > 0) ++m_numLevels;
+	m_grids.resize(m_numLevels);
+}
+
+VoxelizerCPU::~VoxelizerCPU()
+{
+}
+
+void VoxelizerCPU::SetMesh(uint32_t numVert, uint32_t stride, const uint8_t *pVertices,
+	uint32_t numIndices, const uint32_t *pIndices, const float3 &center, float radius)
+{
+	SetMesh(numVert, stride, pVertices, numIndices, pIndices, center, float3(radius, radius, radius));
+}
+
+void VoxelizerCPU::SetMesh(uint32_t numVert, uint32_t stride, const uint8_t *pVertices,
+	uint32_t numIndices, const uint32_t *pIndices, const float3 &center, const float3 &extent)
+{
+	m_numVertices = numVert;
+	m_stride = stride;
+	m_pVertices = pVertices;
+	m_pQuantizedVertices = nullptr;
+	m_sceneInstances.clear();
+	m_sceneBases.clear();
+	m_numIndices = numIndices;
+	m_pIndices = pIndices;
+	m_center = center;
+
+	// Flat axes keep at least one voxel of thickness
+	const auto minExtent = (max)((max)(extent.x, extent.y), extent.z) / m_gridSize;
+	m_extent = float3((max)(extent.x, minExtent), (max)(extent.y, minExtent), (max)(extent.z, minExtent));
+}
+
+void VoxelizerCPU::SetMesh(uint32_t numVert, const ObjLoader::QuantizedVertex *pVertices,
+	uint32_t numIndices, const uint32_t *pIndices, const float3 &quantCenter, const float3 &quantExtent,
+	const float3 &center, const float3 &extent)
+{
+	SetMesh(numVert, 0, nullptr, numIndices, pIndices, center, extent);
+	m_pQuantizedVertices = pVertices;
+
+	// Decoding and normalization folded into one multiply-add per axis
+	const auto scale = 2.0f / 65535.0f;
+	m_quantScale = float3(quantExtent.x * scale / m_extent.x, quantExtent.y * scale / m_extent.y, quantExtent.z * scale / m_extent.z);
+	m_quantBias = normalizePos(quantCenter - quantExtent);
+}
+
+uint32_t VoxelizerCPU::AddMesh(uint32_t numVert, uint32_t stride, const uint8_t *pVertices,
+	uint32_t numIndices, const uint32_t *pIndices)
+{
+	Mesh mesh = { pVertices, pIndices, numVert, numIndices, stride,
+		float3(FLT_MAX, FLT_MAX, FLT_MAX), float3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+	for (auto i = 0u; i < numVert; ++i)
+	{
+		const auto &pos = reinterpret_cast<const ObjLoader::Vertex*>(&pVertices[static_cast<size_t>(stride) * i])->m_vPosition;
+		mesh.BoundMin = float3((min)(mesh.BoundMin.x, pos.x), (min)(mesh.BoundMin.y, pos.y), (min)(mesh.BoundMin.z, pos.z));
+		mesh.BoundMax = float3((max)(mesh.BoundMax.x, pos.x), (max)(mesh.BoundMax.y, pos.y), (max)(mesh.BoundMax.z, pos.z));
+	}
+	m_meshes.push_back(mesh);
+
+	return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+void VoxelizerCPU::AddInstance(const Instance &instance)
+{
+	m_instances.push_back(instance);
+}
+
+void VoxelizerCPU::SetScene(bool anisotropic)
+{
+	// Instances of a mesh are consecutive, so that each bin walks shared geometry together
+	vector<uint32_t> order(m_instances.size());
+	for (auto i = 0u; i < order.size(); ++i) order[i] = i;
+	stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+	{
+		return m_instances[a].Mesh < m_instances[b].Mesh;
+	});
+
+	vector<SceneInstance> sceneInstances;
+	vector<uint32_t> sceneBases;
+	float3 boundMin(FLT_MAX, FLT_MAX, FLT_MAX), boundMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	auto numTri = 0u;
+	for (const auto i : order)
+	{
+		const auto &instance = m_instances[i];
+		if (instance.Mesh >= m_meshes.size()) continue;
+
+		SceneInstance sceneInstance;
+		sceneInstance.Mesh = instance.Mesh;
+		sceneInstance.MaterialId = instance.MaterialId;
+		memcpy(sceneInstance.Transform, instance.Transform, sizeof(instance.Transform));
+
+		// Normals take the inverse transpose, up to a positive scale that the voxelizer normalizes away
+		const auto &m = instance.Transform;
+		auto &c = sceneInstance.NormalTransform;
+		c[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+		c[0][1] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+		c[0][2] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+		c[1][0] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+		c[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+		c[1][2] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+		c[2][0] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+		c[2][1] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+		c[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+		const auto det = m[0][0] * c[0][0] + m[0][1] * c[0][1] + m[0][2] * c[0][2];
+		if (det < 0.0f) for (auto &row : c) for (auto &e : row) e = -e;
+
+		// Scene bound over the transformed corners of the mesh bounds
+		const auto &mesh = m_meshes[instance.Mesh];
+		if (mesh.NumVertices > 0)
+		{
+			for (auto j = 0u; j < 8; ++j)
+			{
+				const auto corner = float3(j & 1 ? mesh.BoundMax.x : mesh.BoundMin.x,
+					j & 2 ? mesh.BoundMax.y : mesh.BoundMin.y, j & 4 ? mesh.BoundMax.z : mesh.BoundMin.z);
+				const auto pos = transformPos(m, corner);
+				boundMin = float3((min)(boundMin.x, pos.x), (min)(boundMin.y, pos.y), (min)(boundMin.z, pos.z));
+				boundMax = float3((max)(boundMax.x, pos.x), (max)(boundMax.y, pos.y), (max)(boundMax.z, pos.z));
+			}
+		}
+
+		sceneInstances.push_back(sceneInstance);
+		sceneBases.push_back(numTri);
+		numTri += mesh.NumIndices / 3;
+	}
+	sceneBases.push_back(numTri);
+
+	if (boundMin.x > boundMax.x) boundMin = boundMax = float3(0.0f, 0.0f, 0.0f);
+	const auto center = (boundMin + boundMax) * 0.5f;
+	auto extent = (boundMax - boundMin) * 0.5f;
+	if (!anisotropic)
+	{
+		const auto radius = (max)((max)(extent.x, extent.y), extent.z);
+		extent = float3(radius, radius, radius);
+	}
+
+	SetMesh(0, 0, nullptr, numTri * 3, nullptr, center, extent);
+	m_sceneInstances.swap(sceneInstances);
+	m_sceneBases.swap(sceneBases);
+}
+
+void VoxelizerCPU::ClearScene()
+{
+	if (!m_sceneBases.empty()) SetMesh(0, 0, nullptr, 0, nullptr, m_center, m_extent);
+	m_meshes.clear();
+	m_instances.clear();
+}
+
+void VoxelizerCPU::Voxelize(Method voxMethod)
+{
+	Clear();
+	VoxelizeBatch(voxMethod);
+}
+
+void VoxelizerCPU::Clear()
+{
+	const auto sliceSize = static_cast<size_t>(m_gridSize) * m_gridSize;
+	auto &grid = m_grids[0];
+	grid.resize(sliceSize * m_gridSize);
+	if (m_sceneBases.empty()) vector<uint16_t>().swap(m_materials);
+	else m_materials.resize(grid.size());
+	if (m_resolve != RESOLVE_AVERAGE) m_normalSums.reset();
+	else if (!m_normalSums || m_numNormalSums != grid.size()) m_normalSums.reset(new atomic<uint64_t>[grid.size()]);
+	m_numNormalSums = m_normalSums ? grid.size() : 0;
+	m_scheduler.ParallelFor(0, m_gridSize, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		fill(grid.begin() + begin * sliceSize, grid.begin() + end * sliceSize, 0u);
+		if (!m_materials.empty()) fill(m_materials.begin() + begin * sliceSize, m_materials.begin() + end * sliceSize, 0);
+		if (m_normalSums)
+			for (auto i = begin * sliceSize; i < end * sliceSize; ++i)
+				m_normalSums[i].store(0, memory_order_relaxed);
+	});
+}
+
+void VoxelizerCPU::VoxelizeBatch(Method voxMethod)
+{
+	voxelizeBinned(voxMethod, [this](uint32_t x, uint32_t y, uint32_t z, uint32_t data, uint16_t materialId)
+	{
+		writeVoxel(x, y, z, data, materialId);
+	});
+	if (m_normalSums) resolveBins(m_binner.GetBins());
+}
+
+void VoxelizerCPU::Voxelize(Method voxMethod, SparseGrid &sparseGrid)
+{
+	if (sparseGrid.GetGridSize() != m_gridSize) return;
+
+	// Allocate the bricks touched by the triangles' footprints
+	const auto numTri = m_numIndices / 3;
+	sparseGrid.Clear();
+	m_scheduler.ParallelFor(0, numTri, TRI_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i) allocateBricks(i, sparseGrid);
+	});
+	sparseGrid.Allocate();
+
+	// Surface voxelization straight into the brick pool
+	voxelizeBinned(voxMethod, [&](uint32_t x, uint32_t y, uint32_t z, uint32_t data, uint16_t)
+	{
+		sparseGrid.Write(x, y, z, data);
+	});
+}
+
+template<typename Layout>
+void VoxelizerCPU::Voxelize(Method voxMethod, VoxelGrid<Layout> &grid)
+{
+	if (grid.GetGridSize() != m_gridSize) return;
+
+	// Surface voxelization straight into the grid
+	grid.Clear();
+	voxelizeBinned(voxMethod, [&](uint32_t x, uint32_t y, uint32_t z, uint32_t data, uint16_t)
+	{
+		grid.Write(x, y, z, data);
+	});
+}
+
+void VoxelizerCPU::MarkDirty(uint32_t firstTri, uint32_t numTri)
+{
+	m_binner.Rebin(firstTri, numTri, [this](uint32_t primId, float3 v[3]) { loadVoxelPositions(primId, v); });
+}
+
+void VoxelizerCPU::VoxelizeDirty(Method voxMethod)
+{
+	auto &grid = m_grids[0];
+	if (grid.empty()) return;
+
+	// Clear the dirty bins, then rebuild them from all their triangles
+	const auto &bins = m_binner.GetDirtyBins();
+	const auto gridSize = static_cast<size_t>(m_gridSize);
+	m_scheduler.ParallelFor(0, static_cast<uint32_t>(bins.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			uint32_t boxMin[3], boxMax[3];
+			m_binner.GetBox(bins[i], boxMin, boxMax);
+			for (auto z = boxMin[2]; z <= boxMax[2]; ++z)
+				for (auto y = boxMin[1]; y <= boxMax[1]; ++y)
+				{
+					const auto row = (z * gridSize + y) * gridSize;
+					fill(grid.begin() + row + boxMin[0], grid.begin() + row + boxMax[0] + 1, 0u);
+					if (!m_materials.empty())
+						fill(m_materials.begin() + row + boxMin[0], m_materials.begin() + row + boxMax[0] + 1, 0);
+					if (m_normalSums)
+						for (auto x = boxMin[0]; x <= boxMax[0]; ++x)
+							m_normalSums[row + x].store(0, memory_order_relaxed);
+				}
+		}
+	});
+
+	voxelizeBins(voxMethod, bins, [this](uint32_t x, uint32_t y, uint32_t z, uint32_t data, uint16_t materialId)
+	{
+		writeVoxel(x, y, z, data, materialId);
+	});
+	if (m_normalSums) resolveBins(bins);
+	m_binner.ClearDirtyBins();
+}
+
+void VoxelizerCPU::FillSolid()
+{
+	if (m_grids[0].empty()) return;
+
+	SolidFill solidFill(m_scheduler);
+	solidFill.Fill(m_grids[0].data(), m_gridSize);
+}
+
+void VoxelizerCPU::FillSolidWinding()
+{
+	if (m_grids[0].empty()) return;
+
+	WindingNumber windingNumber(m_scheduler);
+	windingNumber.Build(GetNumTriangles(), [this](uint32_t primId, ObjLoader::float3 v[3]) { GetTriangle(primId, v); });
+	windingNumber.Fill(m_grids[0].data(), m_gridSize);
+}
+
+void VoxelizerCPU::GenerateMips()
+{
+	for (auto i = 1u; i < m_numLevels; ++i)
+	{
+		const auto gridSize = static_cast<size_t>(GetGridSize(i));
+		m_grids[i].resize(gridSize * gridSize * gridSize);
+		Downsample(m_grids[i - 1].data(), GetGridSize(i - 1), m_grids[i].data(), m_scheduler);
+	}
+}
+
+void VoxelizerCPU::SetResolve(Resolve resolve)
+{
+	m_resolve = resolve;
+}
+
+const vector<uint32_t> &VoxelizerCPU::GetGrid(uint8_t mipLevel) const
+{
+	return m_grids[mipLevel];
+}
+
+const vector<uint16_t> &VoxelizerCPU::GetMaterials() const
+{
+	return m_materials;
+}
+
+uint32_t VoxelizerCPU::GetGridSize(uint8_t mipLevel) const
+{
+	return max(m_gridSize >> mipLevel, 1u);
+}
+
+uint8_t VoxelizerCPU::GetNumLevels() const
+{
+	return m_numLevels;
+}
+
+const TriangleBinner &VoxelizerCPU::GetBinner() const
+{
+	return m_binner;
+}
+
+uint32_t VoxelizerCPU::GetNumTriangles() const
+{
+	return m_numIndices / 3;
+}
+
+void VoxelizerCPU::GetTriangle(uint32_t primId, float3 v[3]) const
+{
+	loadVoxelPositions(primId, v);
+}
+
+void VoxelizerCPU::Downsample(const uint32_t *pSrc, uint32_t srcSize, uint32_t *pDst, TaskScheduler &scheduler)
+{
+	const auto dstSize = max(srcSize >> 1, 1u);
+	const auto srcPitch = static_cast<size_t>(srcSize);
+	const auto dstPitch = static_cast<size_t>(dstSize);
+
+	scheduler.ParallelFor(0, dstSize, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto z = begin; z < end; ++z)
+		{
+			for (auto y = 0u; y < dstSize; ++y)
+			{
+				for (auto x = 0u; x < dstSize; ++x)
+				{
+					float3 sum(0.0f, 0.0f, 0.0f);
+					auto occupied = false;
+
+					// Same child order as CSDownsample; out-of-range children are empty
+					for (auto i = 0u; i < 8; ++i)
+					{
+						const auto srcX = x * 2 + (i & 1);
+						const auto srcY = y * 2 + ((i >> 1) & 1);
+						const auto srcZ = z * 2 + (i >> 2);
+						if (srcX >= srcSize || srcY >= srcSize || srcZ >= srcSize) continue;
+
+						float nx, ny, nz, w;
+						UnpackR10G10B10A2(pSrc[(srcZ * srcPitch + srcY) * srcPitch + srcX], nx, ny, nz, w);
+						if (w > 0.0f)
+						{
+							sum = sum + float3(nx * 2.0f - 1.0f, ny * 2.0f - 1.0f, nz * 2.0f - 1.0f);
+							occupied = true;
+						}
+					}
+
+					const auto len = sqrt(sum.x * sum.x + sum.y * sum.y + sum.z * sum.z);
+					const auto nrm = len > 0.0f ? sum * (1.0f / len) : float3(0.0f, 0.0f, 0.0f);
+					pDst[(z * dstPitch + y) * dstPitch + x] = occupied ?
+						PackR10G10B10A2(nrm.x * 0.5f + 0.5f, nrm.y * 0.5f + 0.5f, nrm.z * 0.5f + 0.5f, 1.0f) : 0;
+				}
+			}
+		}
+	});
+}
+
+uint32_t VoxelizerCPU::PackR10G10B10A2(float x, float y, float z, float w)
+{
+	const auto toUint = [](float v, float scale) { return static_cast<uint32_t>(floor(saturate(v) * scale + 0.5f)); };
+
+	return toUint(x, 1023.0f) | (toUint(y, 1023.0f) << 10) | (toUint(z, 1023.0f) << 20) | (toUint(w, 3.0f) << 30);
+}
+
+uint64_t VoxelizerCPU::EncodeNormalSum(float x, float y, float z)
+{
+	// Adding the fields as one integer is exact as long as each sum fits in its 19 bits
+	const auto toField = [](float v) { return static_cast<uint64_t>(static_cast<int64_t>(floor((min)((max)(v, -1.0f), 1.0f) * 127.0f + 0.5f))); };
+
+	return toField(x) + (toField(y) << 19) + (toField(z) << 38);
+}
+
+void VoxelizerCPU::DecodeNormalSum(uint64_t sum, int32_t &x, int32_t &y, int32_t &z)
+{
+	// Sign-extend the lowest field, then remove it with the borrow it carried into the next one
+	const auto popField = [&sum]()
+	{
+		const auto field = static_cast<int32_t>(static_cast<int64_t>(sum << 45) >> 45);
+		sum = (sum - static_cast<uint64_t>(static_cast<int64_t>(field))) >> 19;
+
+		return field;
+	};
+
+	x = popField();
+	y = popField();
+	z = popField();
+}
+
+void VoxelizerCPU::UnpackR10G10B10A2(uint32_t packed, float &x, float &y, float &z, float &w)
+{
+	x = static_cast<float>(packed & 0x3ff) / 1023;
+	y = static_cast<float>((packed >> 10) & 0x3ff) / 1023;
+	z = static_cast<float>((packed >> 20) & 0x3ff) / 1023;
+	w = static_cast<float>((packed >> 30) & 0x3) / 3;
+}
+
+template<typename WriteFunc>
+void VoxelizerCPU::voxelizeBinned(Method voxMethod, const WriteFunc &writeFunc)
+{
+	m_binner.Bin(m_numIndices / 3, [this](uint32_t primId, float3 v[3]) { loadVoxelPositions(primId, v); });
+	voxelizeBins(voxMethod, m_binner.GetBins(), writeFunc);
+}
+
+template<typename WriteFunc>
+void VoxelizerCPU::voxelizeBins(Method voxMethod, const vector<uint32_t> &bins, const WriteFunc &writeFunc)
+{
+	// A whole bin per task; triangles spanning several bins are clipped to each of them
+	m_scheduler.ParallelFor(0, static_cast<uint32_t>(bins.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t workerIdx)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			uint32_t boxMin[3], boxMax[3];
+			m_binner.GetBox(bins[i], boxMin, boxMax);
+			m_binner.VisitTriangles(bins[i], [&](uint32_t primId)
+			{
+				const auto materialId = getMaterialId(primId);
+				voxelizeTri(voxMethod, primId, workerIdx, boxMin, boxMax, [&](uint32_t x, uint32_t y, uint32_t z, uint32_t data)
+				{
+					if (x < boxMin[0] || y < boxMin[1] || z < boxMin[2] || x > boxMax[0] || y > boxMax[1] || z > boxMax[2]) return;
+					writeFunc(x, y, z, data, materialId);
+				});
+			});
+		}
+	});
+}
+
+template<typename WriteFunc>
+void VoxelizerCPU::voxelizeTri(Method voxMethod, uint32_t primId, uint32_t workerIdx,
+	const uint32_t boxMin[3], const uint32_t boxMax[3], const WriteFunc &writeFunc)
+{
+	// The tessellation path runs the same VS-HS-DS math as TRI_PROJ
+	// through the fixed-function pipeline with tessellation factor 1.
+	switch (voxMethod)
+	{
+	case TRI_PROJ_UNION:
+		voxelizeTriProjUnion(primId, boxMin, boxMax, writeFunc);
+		break;
+	case TRI_SAT:
+		voxelizeTriSat(primId, boxMin, boxMax, m_satVoxels[workerIdx], writeFunc);
+		break;
+	default:
+		voxelizeTriProj(primId, boxMin, boxMax, writeFunc);
+	}
+}
+
+template<typename WriteFunc>
+void VoxelizerCPU::voxelizeTriProj(uint32_t primId, const uint32_t boxMin[3], const uint32_t boxMax[3],
+	const WriteFunc &writeFunc)
+{
+	// VS: position normalization
+	float3 pos[3], nrms[3];
+	RasterVertex patch[3];
+	loadTriangle(primId, pos, nrms);
+	for (auto i = 0u; i < 3; ++i)
+	{
+		patch[i].Nrm = nrms[i];
+
+		// Texture 3D space
+		patch[i].TexLoc = pos[i] * 0.5f + float3(0.5f, 0.5f, 0.5f);
+		patch[i].TexLoc.y = 1.0f - patch[i].TexLoc.y;
+	}
+
+	// HS: calculate projected triangle sizes (equivalent to area) for 3 views
+	const auto edge1 = pos[1] - pos[0];
+	const auto edge2 = pos[2] - pos[1];
+	const auto sizeXY = abs(edge1.x * edge2.y - edge1.y * edge2.x);
+	const auto sizeYZ = abs(edge1.y * edge2.z - edge1.z * edge2.y);
+	const auto sizeZX = abs(edge1.z * edge2.x - edge1.x * edge2.z);
+
+	// Select the view with maximal projected AABB
+	for (auto i = 0u; i < 3; ++i)
+	{
+		const auto &p = pos[i];
+		patch[i].Pos = sizeXY > sizeYZ ?
+			(sizeXY > sizeZX ? float2{ p.x, p.y } : float2{ p.z, p.x }) :
+			(sizeYZ > sizeZX ? float2{ p.y, p.z } : float2{ p.z, p.x });
+	}
+
+	// DS: calculate projected AABB in texture space
+	float bound[4];
+	bound[0] = min(min(patch[0].Pos.x, patch[1].Pos.x), patch[2].Pos.x) * 0.5f + 0.5f;
+	bound[1] = min(min(patch[0].Pos.y, patch[1].Pos.y), patch[2].Pos.y) * 0.5f + 0.5f;
+	bound[2] = max(max(patch[0].Pos.x, patch[1].Pos.x), patch[2].Pos.x) * 0.5f + 0.5f;
+	bound[3] = max(max(patch[0].Pos.y, patch[1].Pos.y), patch[2].Pos.y) * 0.5f + 0.5f;
+	const auto boundY = bound[1];
+	bound[1] = 1.0f - bound[3];
+	bound[3] = 1.0f - boundY;
+
+	// DS: perform triangle extrapolations
+	const float2 centroidPos =
+	{
+		(patch[0].Pos.x + patch[1].Pos.x + patch[2].Pos.x) / 3.0f,
+		(patch[0].Pos.y + patch[1].Pos.y + patch[2].Pos.y) / 3.0f
+	};
+
+	RasterVertex vertices[3];
+	for (auto i = 0u; i < 3; ++i)
+	{
+		// Distance to centroid in rasterizer space
+		const auto dx = patch[i].Pos.x - centroidPos.x;
+		const auto dy = patch[i].Pos.y - centroidPos.y;
+		const auto dist = sqrt(dx * dx + dy * dy) * m_gridSize * 0.5f;
+
+		// Change domain location with offset for extrapolation
+		float domain[3];
+		for (auto j = 0u; j < 3; ++j)
+		{
+			domain[j] = i == j ? 1.0f : 0.0f;
+			domain[j] += CONSERVATION_AMT * ((domain[j] - 1.0f / 3.0f) / dist);
+		}
+
+		auto &vertex = vertices[i];
+		vertex.Pos.x = patch[0].Pos.x * domain[0] + patch[1].Pos.x * domain[1] + patch[2].Pos.x * domain[2];
+		vertex.Pos.y = patch[0].Pos.y * domain[0] + patch[1].Pos.y * domain[1] + patch[2].Pos.y * domain[2];
+		vertex.Nrm = patch[0].Nrm * domain[0] + patch[1].Nrm * domain[1] + patch[2].Nrm * domain[2];
+		vertex.TexLoc = patch[0].TexLoc * domain[0] + patch[1].TexLoc * domain[1] + patch[2].TexLoc * domain[2];
+	}
+
+	// PS with _CONSERVATIVE_, in the pixels of the bin; views XY, YZ and ZX map axis k to x
+	int64_t clip[4];
+	const auto axisX = sizeXY > sizeYZ ? (sizeXY > sizeZX ? 0u : 2u) : (sizeYZ > sizeZX ? 1u : 2u);
+	getViewClip(boxMin, boxMax, axisX, (axisX + 1) % 3, clip);
+	rasterize(vertices, bound, clip, writeFunc);
+}
+
+template<typename WriteFunc>
+void VoxelizerCPU::voxelizeTriProjUnion(uint32_t primId, const uint32_t boxMin[3], const uint32_t boxMax[3],
+	const WriteFunc &writeFunc)
+{
+	float3 pos[3], nrms[3];
+	RasterVertex vertices[3];
+	loadTriangle(primId, pos, nrms);
+	for (auto i = 0u; i < 3; ++i)
+	{
+		vertices[i].Nrm = nrms[i];
+		vertices[i].TexLoc = pos[i] * 0.5f + float3(0.5f, 0.5f, 0.5f);
+		vertices[i].TexLoc.y = 1.0f - vertices[i].TexLoc.y;
+	}
+
+	// Same as the 3 instances of VSTriProjUnion
+	for (auto viewID = 0u; viewID < 3; ++viewID)
+	{
+		for (auto i = 0u; i < 3; ++i)
+		{
+			const auto &p = pos[i];
+			vertices[i].Pos = viewID == 0 ? float2{ p.x, p.y } : (viewID == 1 ? float2{ p.y, p.z } : float2{ p.z, p.x });
+		}
+
+		int64_t clip[4];
+		getViewClip(boxMin, boxMax, viewID, (viewID + 1) % 3, clip);
+		rasterize(vertices, nullptr, clip, writeFunc);
+	}
+}
+
+template<typename WriteFunc>
+void VoxelizerCPU::voxelizeTriSat(uint32_t primId, const uint32_t boxMin[3], const uint32_t boxMax[3],
+	vector<uint32_t> &voxels, const WriteFunc &writeFunc)
+{
+	// Same texture-space positions as the VS, scaled to voxels
+	float3 pos[3], texLocs[3], nrms[3];
+	loadTriangle(primId, pos, nrms);
+	for (auto i = 0u; i < 3; ++i)
+	{
+		texLocs[i] = pos[i] * 0.5f + float3(0.5f, 0.5f, 0.5f);
+		texLocs[i].y = 1.0f - texLocs[i].y;
+		texLocs[i] = texLocs[i] * static_cast<float>(m_gridSize);
+	}
+
+	voxels.clear();
+	SatKernel::Overlap(texLocs, boxMin, boxMax, voxels);
+	if (voxels.empty()) return;
+
+	// Normals are interpolated at the voxel centers projected along the dominant axis;
+	// centers outside the triangle clamp to its nearest side
+	const float p[3][3] =
+	{
+		{ texLocs[0].x, texLocs[0].y, texLocs[0].z },
+		{ texLocs[1].x, texLocs[1].y, texLocs[1].z },
+		{ texLocs[2].x, texLocs[2].y, texLocs[2].z }
+	};
+	const auto edge1 = texLocs[1] - texLocs[0];
+	const auto edge2 = texLocs[2] - texLocs[0];
+	const float n[3] =
+	{
+		abs(edge1.y * edge2.z - edge1.z * edge2.y),
+		abs(edge1.z * edge2.x - edge1.x * edge2.z),
+		abs(edge1.x * edge2.y - edge1.y * edge2.x)
+	};
+	const auto d = n[0] > n[1] ? (n[0] > n[2] ? 0u : 2u) : (n[1] > n[2] ? 1u : 2u);
+	const auto a = (d + 1) % 3;
+	const auto b = (d + 2) % 3;
+	const auto area = (p[1][a] - p[0][a]) * (p[2][b] - p[0][b]) - (p[1][b] - p[0][b]) * (p[2][a] - p[0][a]);
+	const auto rcpArea = 1.0f / area;
+
+	for (size_t i = 0; i < voxels.size(); i += 3)
+	{
+		const auto u = voxels[i + a] + 0.5f;
+		const auto v = voxels[i + b] + 0.5f;
+
+		float w[3];
+		for (auto k = 0u; k < 3; ++k)
+		{
+			const auto &p1 = p[(k + 1) % 3];
+			const auto &p2 = p[(k + 2) % 3];
+			w[k] = (max)(((p1[a] - u) * (p2[b] - v) - (p1[b] - v) * (p2[a] - u)) * rcpArea, 0.0f);
+		}
+		const auto wSum = w[0] + w[1] + w[2];
+		if (wSum > 0.0f) for (auto &wk : w) wk /= wSum;
+		else w[0] = w[1] = w[2] = 1.0f / 3.0f;
+
+		auto nrm = nrms[0] * w[0] + nrms[1] * w[1] + nrms[2] * w[2];
+		const auto l = sqrt(nrm.x * nrm.x + nrm.y * nrm.y + nrm.z * nrm.z);
+		nrm = float3(nrm.x / l, nrm.y / l, nrm.z / l);
+		const auto data = PackR10G10B10A2(nrm.x * 0.5f + 0.5f, nrm.y * 0.5f + 0.5f, nrm.z * 0.5f + 0.5f, 1.0f);
+
+		writeFunc(voxels[i], voxels[i + 1], voxels[i + 2], data);
+	}
+}
+
+template<typename WriteFunc>
+void VoxelizerCPU::rasterize(const RasterVertex vertices[3], const float *pBound, const int64_t clip[4],
+	const WriteFunc &writeFunc)
+{
+	const auto gridSize = static_cast<float>(m_gridSize);
+
+	// Viewport transform, snapped to the sub-pixel precision of the rasterizer
+	int64_t x[3], y[3];
+	for (auto i = 0u; i < 3; ++i)
+	{
+		const auto sx = (vertices[i].Pos.x * 0.5f + 0.5f) * gridSize;
+		const auto sy = (0.5f - vertices[i].Pos.y * 0.5f) * gridSize;
+		if (!(abs(sx) < 65536.0f && abs(sy) < 65536.0f)) return;
+		x[i] = llrint(sx * SUBPIXEL_SCALE);
+		y[i] = llrint(sy * SUBPIXEL_SCALE);
+	}
+
+	// Both windings are rasterized (CULL_NONE); orient the triangle to positive area
+	uint32_t v[3] = { 0, 1, 2 };
+	auto area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0) return;
+	if (area < 0)
+	{
+		swap(v[1], v[2]);
+		area = -area;
+	}
+
+	// Edge k is opposite to vertex v[k]
+	int64_t a[3], b[3], c[3];
+	bool isTopLeft[3];
+	for (auto k = 0u; k < 3; ++k)
+	{
+		const auto i0 = v[(k + 1) % 3];
+		const auto i1 = v[(k + 2) % 3];
+		const auto dx = x[i1] - x[i0];
+		const auto dy = y[i1] - y[i0];
+		a[k] = -dy;
+		b[k] = dx;
+		c[k] = dy * x[i0] - dx * y[i0];
+
+		// Top-left fill rule
+		isTopLeft[k] = dy < 0 || (dy == 0 && dx > 0);
+	}
+
+	// Pixel-center bounding box, clipped to the viewport and the bin
+	const auto half = SUBPIXEL_SCALE / 2;
+	const auto xMin = max<int64_t>((min(min(x[0], x[1]), x[2]) - half + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS, max<int64_t>(clip[0], 0));
+	const auto yMin = max<int64_t>((min(min(y[0], y[1]), y[2]) - half + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS, max<int64_t>(clip[1], 0));
+	const auto xMax = min<int64_t>((max(max(x[0], x[1]), x[2]) - half) >> SUBPIXEL_BITS, min<int64_t>(clip[2], m_gridSize - 1));
+	const auto yMax = min<int64_t>((max(max(y[0], y[1]), y[2]) - half) >> SUBPIXEL_BITS, min<int64_t>(clip[3], m_gridSize - 1));
+
+	const auto rcpArea = 1.0f / static_cast<float>(area);
+	for (auto py = yMin; py <= yMax; ++py)
+	{
+		const auto sy = py * SUBPIXEL_SCALE + half;
+		for (auto px = xMin; px <= xMax; ++px)
+		{
+			const auto sx = px * SUBPIXEL_SCALE + half;
+
+			int64_t e[3];
+			auto covered = true;
+			for (auto k = 0u; k < 3 && covered; ++k)
+			{
+				e[k] = a[k] * sx + b[k] * sy + c[k];
+				covered = e[k] > 0 || (e[k] == 0 && isTopLeft[k]);
+			}
+			if (!covered) continue;
+
+			// PS: conservative test against the projected AABB
+			if (pBound)
+			{
+				const auto posX = static_cast<float>(px) + 0.5f;
+				const auto posY = static_cast<float>(py) + 0.5f;
+				const auto needWrite = posX + 1.0f > pBound[0] * gridSize && posY + 1.0f > pBound[1] * gridSize &&
+					posX < pBound[2] * gridSize + 1.0f && posY < pBound[3] * gridSize + 1.0f;
+				if (!needWrite) continue;
+			}
+
+			// Attribute interpolation
+			const auto &v0 = vertices[v[0]];
+			const auto &v1 = vertices[v[1]];
+			const auto &v2 = vertices[v[2]];
+			const auto w0 = static_cast<float>(e[0]) * rcpArea;
+			const auto w1 = static_cast<float>(e[1]) * rcpArea;
+			const auto w2 = static_cast<float>(e[2]) * rcpArea;
+			const auto texLoc = v0.TexLoc * w0 + v1.TexLoc * w1 + v2.TexLoc * w2;
+			auto nrm = v0.Nrm * w0 + v1.Nrm * w1 + v2.Nrm * w2;
+
+			const auto locX = ftou(texLoc.x * gridSize);
+			const auto locY = ftou(texLoc.y * gridSize);
+			const auto locZ = ftou(texLoc.z * gridSize);
+
+			// Out-of-bounds UAV writes are discarded
+			if (locX >= m_gridSize || locY >= m_gridSize || locZ >= m_gridSize) continue;
+
+			const auto l = sqrt(nrm.x * nrm.x + nrm.y * nrm.y + nrm.z * nrm.z);
+			nrm = float3(nrm.x / l, nrm.y / l, nrm.z / l);
+			const auto data = PackR10G10B10A2(nrm.x * 0.5f + 0.5f, nrm.y * 0.5f + 0.5f, nrm.z * 0.5f + 0.5f, 1.0f);
+
+			writeFunc(locX, locY, locZ, data);
+		}
+	}
+}
+
+void VoxelizerCPU::getViewClip(const uint32_t boxMin[3], const uint32_t boxMax[3], uint32_t axisX, uint32_t axisY,
+	int64_t clip[4]) const
+{
+	// The VS flips texture-space y against the view's x, and the other axes against the view's y.
+	// Widened by a pixel for the rounding of the interpolated locations.
+	const auto last = static_cast<int64_t>(m_gridSize) - 1;
+	const int64_t lo[] = { boxMin[axisX], boxMin[axisY] };
+	const int64_t hi[] = { boxMax[axisX], boxMax[axisY] };
+	const bool flip[] = { axisX == 1, axisY != 1 };
+	for (auto i = 0u; i < 2; ++i)
+	{
+		clip[i] = (flip[i] ? last - hi[i] : lo[i]) - 1;
+		clip[i + 2] = (flip[i] ? last - lo[i] : hi[i]) + 1;
+	}
+}
+
+void VoxelizerCPU::loadVoxelPositions(uint32_t primId, float3 v[3]) const
+{
+	// Same texture-space positions as the VS, scaled to voxels
+	float3 pos[3];
+	loadTrianglePositions(primId, pos);
+	for (auto i = 0u; i < 3; ++i)
+	{
+		v[i] = pos[i] * 0.5f + float3(0.5f, 0.5f, 0.5f);
+		v[i].y = 1.0f - v[i].y;
+		v[i] = v[i] * static_cast<float>(m_gridSize);
+	}
+}
+
+void VoxelizerCPU::allocateBricks(uint32_t primId, SparseGrid &sparseGrid)
+{
+	float3 texLocs[3];
+	loadVoxelPositions(primId, texLocs);
+	sparseGrid.MarkTriangle(texLocs);
+}
+
+void VoxelizerCPU::writeVoxel(uint32_t x, uint32_t y, uint32_t z, uint32_t data, uint16_t materialId)
+{
+	// Equivalent to InterlockedMax(); the voxel belongs to the bin of this worker alone.
+	// The material follows the winning normal, then the larger ID on ties.
+	const auto i = (z * static_cast<size_t>(m_gridSize) + y) * m_gridSize + x;
+	auto &voxel = m_grids[0][i];
+	if (!m_materials.empty())
+	{
+		auto &material = m_materials[i];
+		if (data > voxel) material = materialId;
+		else if (data == voxel) material = max(material, materialId);
+	}
+	voxel = max(voxel, data);
+
+	// Order-independent, unlike the max; contended only on the GPU
+	if (m_normalSums)
+	{
+		float nx, ny, nz, w;
+		UnpackR10G10B10A2(data, nx, ny, nz, w);
+		m_normalSums[i].fetch_add(EncodeNormalSum(nx * 2.0f - 1.0f, ny * 2.0f - 1.0f, nz * 2.0f - 1.0f), memory_order_relaxed);
+	}
+}
+
+void VoxelizerCPU::resolveBins(const vector<uint32_t> &bins)
+{
+	// Occupancy stays that of the max; opposite normals cancelling out leave a zero normal,
+	// as in Downsample().
+	auto &grid = m_grids[0];
+	const auto gridSize = static_cast<size_t>(m_gridSize);
+	m_scheduler.ParallelFor(0, static_cast<uint32_t>(bins.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			uint32_t boxMin[3], boxMax[3];
+			m_binner.GetBox(bins[b], boxMin, boxMax);
+			for (auto z = boxMin[2]; z <= boxMax[2]; ++z)
+				for (auto y = boxMin[1]; y <= boxMax[1]; ++y)
+					for (auto x = boxMin[0]; x <= boxMax[0]; ++x)
+					{
+						const auto i = (z * gridSize + y) * gridSize + x;
+						if (!grid[i]) continue;
+
+						int32_t sumX, sumY, sumZ;
+						DecodeNormalSum(m_normalSums[i].load(memory_order_relaxed), sumX, sumY, sumZ);
+						const float3 sum(static_cast<float>(sumX), static_cast<float>(sumY), static_cast<float>(sumZ));
+						const auto len = sqrt(sum.x * sum.x + sum.y * sum.y + sum.z * sum.z);
+						const auto nrm = len > 0.0f ? sum * (1.0f / len) : float3(0.0f, 0.0f, 0.0f);
+						grid[i] = PackR10G10B10A2(nrm.x * 0.5f + 0.5f, nrm.y * 0.5f + 0.5f, nrm.z * 0.5f + 0.5f, 1.0f);
+					}
+		}
+	});
+}
+
+void VoxelizerCPU::loadTriangle(uint32_t primId, float3 pos[3], float3 nrm[3]) const
+{
+	uint32_t localPrimId;
+	const auto pInstance = getSceneInstance(primId, localPrimId);
+	if (!pInstance)
+	{
+		for (auto i = 0u; i < 3; ++i) loadVertex(m_pIndices[primId * 3 + i], pos[i], nrm[i]);
+		return;
+	}
+
+	const auto &mesh = m_meshes[pInstance->Mesh];
+	const auto &c = pInstance->NormalTransform;
+	for (auto i = 0u; i < 3; ++i)
+	{
+		const auto &vertex = *reinterpret_cast<const ObjLoader::Vertex*>(&mesh.pVertices[
+			static_cast<size_t>(mesh.Stride) * mesh.pIndices[localPrimId * 3 + i]]);
+		const auto &n = vertex.m_vNormal;
+		pos[i] = normalizePos(transformPos(pInstance->Transform, vertex.m_vPosition));
+		nrm[i] = float3(c[0][0] * n.x + c[0][1] * n.y + c[0][2] * n.z,
+			c[1][0] * n.x + c[1][1] * n.y + c[1][2] * n.z,
+			c[2][0] * n.x + c[2][1] * n.y + c[2][2] * n.z);
+	}
+}
+
+void VoxelizerCPU::loadTrianglePositions(uint32_t primId, float3 pos[3]) const
+{
+	uint32_t localPrimId;
+	const auto pInstance = getSceneInstance(primId, localPrimId);
+	if (!pInstance)
+	{
+		for (auto i = 0u; i < 3; ++i) pos[i] = loadPosition(m_pIndices[primId * 3 + i]);
+		return;
+	}
+
+	const auto &mesh = m_meshes[pInstance->Mesh];
+	for (auto i = 0u; i < 3; ++i)
+	{
+		const auto &vertex = *reinterpret_cast<const ObjLoader::Vertex*>(&mesh.pVertices[
+			static_cast<size_t>(mesh.Stride) * mesh.pIndices[localPrimId * 3 + i]]);
+		pos[i] = normalizePos(transformPos(pInstance->Transform, vertex.m_vPosition));
+	}
+}
+
+const VoxelizerCPU::SceneInstance *VoxelizerCPU::getSceneInstance(uint32_t primId, uint32_t &localPrimId) const
+{
+	if (m_sceneBases.empty()) return nullptr;
+
+	// Last instance starting at or before the triangle; empty instances share their base with the next
+	const auto i = static_cast<size_t>(upper_bound(m_sceneBases.cbegin(), m_sceneBases.cend(), primId) - m_sceneBases.cbegin()) - 1;
+	localPrimId = primId - m_sceneBases[i];
+
+	return &m_sceneInstances[i];
+}
+
+uint16_t VoxelizerCPU::getMaterialId(uint32_t primId) const
+{
+	uint32_t localPrimId;
+	const auto pInstance = getSceneInstance(primId, localPrimId);
+
+	return pInstance ? pInstance->MaterialId : 0;
+}
+
+const ObjLoader::Vertex &VoxelizerCPU::getVertex(uint32_t i) const
+{
+	return *reinterpret_cast<const ObjLoader::Vertex*>(&m_pVertices[static_cast<size_t>(m_stride) * i]);
+}
+
+float3 VoxelizerCPU::normalizePos(const float3 &pos) const
+{
+	return float3((pos.x - m_center.x) / m_extent.x, (pos.y - m_center.y) / m_extent.y, (pos.z - m_center.z) / m_extent.z);
+}
+
+void VoxelizerCPU::loadVertex(uint32_t i, float3 &pos, float3 &nrm) const
+{
+	if (m_pQuantizedVertices)
+	{
+		pos = loadPosition(i);
+		nrm = VertexQuantizer::DecodeNormal(m_pQuantizedVertices[i]);
+	}
+	else
+	{
+		const auto &vertex = getVertex(i);
+		pos = normalizePos(vertex.m_vPosition);
+		nrm = vertex.m_vNormal;
+	}
+}
+
+float3 VoxelizerCPU::loadPosition(uint32_t i) const
+{
+	if (!m_pQuantizedVertices) return normalizePos(getVertex(i).m_vPosition);
+
+	const auto &q = m_pQuantizedVertices[i].m_uPosition;
+
+	return float3(q[0] * m_quantScale.x + m_quantBias.x, q[1] * m_quantScale.y + m_quantBias.y, q[2] * m_quantScale.z + m_quantBias.z);
+}
+
+template void VoxelizerCPU::Voxelize(Method voxMethod, VoxelGrid<LinearLayout> &grid);
+template void VoxelizerCPU::Voxelize(Method voxMethod, VoxelGrid<MortonLayout> &grid);
+template void VoxelizerCPU::Voxelize(Method voxMethod, VoxelGrid<TiledLayout> &grid);
@@ -0,0 +1,211 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "SharedConst.h"
+#include "ObjLoader.h"
+#include "TaskScheduler.h"
+#include "SparseGrid.h"
+#include "VoxelGrid.h"
+#include "TriangleBinner.h"
+
+//--------------------------------------------------------------------------------------
+// CPU reference of Voxelizer::voxelize(), producing the same packed R10G10B10A2 grid.
+// Triangles are binned spatially first, and each bin is voxelized by a single worker,
+// so writes need neither atomics nor a merge.
+//--------------------------------------------------------------------------------------
+class VoxelizerCPU
+{
+public:
+	enum Method : uint8_t
+	{
+		TRI_PROJ,
+		TRI_PROJ_TESS,
+		TRI_PROJ_UNION,
+		TRI_SAT,	// Exact triangle/voxel overlap, without the over-marking of the conservative AABB
+
+		NUM_METHOD
+	};
+
+	// How concurrent writes to a voxel of the dense grid combine
+	enum Resolve : uint8_t
+	{
+		RESOLVE_MAX,		// InterlockedMax() on the packed normal, as Voxelizer does
+		RESOLVE_AVERAGE,	// Normals summed with one atomic add, then renormalized and packed
+
+		NUM_RESOLVE
+	};
+
+	struct Instance
+	{
+		uint32_t	Mesh;				// ID returned by AddMesh()
+		uint16_t	MaterialId;
+		float		Transform[3][4];	// Object to world, row-major, applied to column vectors
+	};
+
+	VoxelizerCPU(uint32_t gridSize = GRID_SIZE, TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~VoxelizerCPU();
+
+	void SetMesh(uint32_t numVert, uint32_t stride, const uint8_t *pVertices,
+		uint32_t numIndices, const uint32_t *pIndices,
+		const ObjLoader::float3 &center, float radius);
+	void SetMesh(uint32_t numVert, uint32_t stride, const uint8_t *pVertices,	// Anisotropic, scaled per axis
+		uint32_t numIndices, const uint32_t *pIndices,
+		const ObjLoader::float3 &center, const ObjLoader::float3 &extent);
+	void SetMesh(uint32_t numVert, const ObjLoader::QuantizedVertex *pVertices,	// Quantized inside the quantization bound
+		uint32_t numIndices, const uint32_t *pIndices,
+		const ObjLoader::float3 &quantCenter, const ObjLoader::float3 &quantExtent,
+		const ObjLoader::float3 &center, const ObjLoader::float3 &extent);
+	// Scene of instanced meshes, replacing the mesh of SetMesh() until the next SetMesh().
+	// Meshes are referenced, not copied. SetScene() fits the grid to the instance bounds;
+	// all instances are then voxelized in one pass, grouped by mesh.
+	uint32_t AddMesh(uint32_t numVert, uint32_t stride, const uint8_t *pVertices,
+		uint32_t numIndices, const uint32_t *pIndices);
+	void AddInstance(const Instance &instance);
+	void SetScene(bool anisotropic = false);	// Anisotropic scales each axis to fill the grid
+	void ClearScene();
+
+	void Voxelize(Method voxMethod);
+	void Clear();							// Empties the grid before streaming batches into it
+	void VoxelizeBatch(Method voxMethod);	// Adds the current mesh to the grid instead of replacing it
+	void Voxelize(Method voxMethod, SparseGrid &sparseGrid);	// The sparse grid must have the same size
+	template<typename Layout>
+	void Voxelize(Method voxMethod, VoxelGrid<Layout> &grid);	// Instantiated for the layouts in VoxelLayout.h
+	// Incremental update of the dense grid of the last Voxelize(): after editing the vertices of
+	// some triangles in place, mark them dirty, then re-voxelize only the bins they left or entered.
+	// Positions keep the normalization of SetMesh(), and mips are not regenerated.
+	void MarkDirty(uint32_t firstTri, uint32_t numTri);
+	void VoxelizeDirty(Method voxMethod);	// Same method as the last Voxelize()
+	void FillSolid();	// Same as CSFillSolid on the dense grid, without the K-buffer layer cap
+	void FillSolidWinding();	// By generalized winding numbers of the triangles, robust to holes
+	void GenerateMips();
+	void SetResolve(Resolve resolve);	// Applies to the dense grid from the next Clear() or Voxelize()
+
+	const std::vector<uint32_t> &GetGrid(uint8_t mipLevel = 0) const;
+	const std::vector<uint16_t> &GetMaterials() const;	// Per voxel of the dense scene grid; empty outside scenes
+	uint32_t GetGridSize(uint8_t mipLevel = 0) const;
+	uint8_t GetNumLevels() const;	// Same level count as Voxelizer
+
+	// Reference of CSDownsample: renormalized average of the occupied children's normals
+	static void Downsample(const uint32_t *pSrc, uint32_t srcSize, uint32_t *pDst,
+		TaskScheduler &scheduler = TaskScheduler::GetDefault());
+
+	// Same conversions as D3DX_FLOAT4_to_R10G10B10A2_UNORM and its inverse
+	static uint32_t PackR10G10B10A2(float x, float y, float z, float w);
+	static void UnpackR10G10B10A2(uint32_t packed, float &x, float &y, float &z, float &w);
+
+	// Accumulator of RESOLVE_AVERAGE, laid out for a single 64-bit atomic add, on the GPU too:
+	// x, y and z quantized to [-127, 127] and summed in 19-bit two's complement at bits 0, 19
+	// and 38; the carries out of z are ignored. Sums are exact up to 2064 writes per voxel.
+	static uint64_t EncodeNormalSum(float x, float y, float z);
+	static void DecodeNormalSum(uint64_t sum, int32_t &x, int32_t &y, int32_t &z);
+
+	const TriangleBinner &GetBinner() const;	// Bins of the last voxelization
+
+	// Triangles of the mesh or the scene, in voxels as they are voxelized, voxel (x, y, z) spanning [x, x + 1)
+	uint32_t GetNumTriangles() const;
+	void GetTriangle(uint32_t primId, ObjLoader::float3 v[3]) const;
+
+protected:
+	struct float2
+	{
+		float x;
+		float y;
+	};
+
+	struct RasterVertex
+	{
+		float2				Pos;
+		ObjLoader::float3	TexLoc;
+		ObjLoader::float3	Nrm;
+	};
+
+	struct Mesh
+	{
+		const uint8_t		*pVertices;
+		const uint32_t		*pIndices;
+		uint32_t			NumVertices;
+		uint32_t			NumIndices;
+		uint32_t			Stride;
+		ObjLoader::float3	BoundMin;
+		ObjLoader::float3	BoundMax;
+	};
+
+	struct SceneInstance
+	{
+		uint32_t			Mesh;
+		uint16_t			MaterialId;
+		float				Transform[3][4];
+		float				NormalTransform[3][3];	// Cofactors, with the sign of the determinant
+	};
+
+	// WriteFunc: void(uint32_t x, uint32_t y, uint32_t z, uint32_t data, uint16_t materialId), called
+	// only with voxels of the bin being voxelized, and by a single worker per bin
+	template<typename WriteFunc>
+	void voxelizeBinned(Method voxMethod, const WriteFunc &writeFunc);
+	template<typename WriteFunc>
+	void voxelizeBins(Method voxMethod, const std::vector<uint32_t> &bins, const WriteFunc &writeFunc);
+
+	// The box is the inclusive voxel range of the bin; writes outside it are skipped
+	template<typename WriteFunc>
+	void voxelizeTri(Method voxMethod, uint32_t primId, uint32_t workerIdx,
+		const uint32_t boxMin[3], const uint32_t boxMax[3], const WriteFunc &writeFunc);
+	template<typename WriteFunc>
+	void voxelizeTriProj(uint32_t primId, const uint32_t boxMin[3], const uint32_t boxMax[3], const WriteFunc &writeFunc);
+	template<typename WriteFunc>
+	void voxelizeTriProjUnion(uint32_t primId, const uint32_t boxMin[3], const uint32_t boxMax[3], const WriteFunc &writeFunc);
+	template<typename WriteFunc>
+	void voxelizeTriSat(uint32_t primId, const uint32_t boxMin[3], const uint32_t boxMax[3],
+		std::vector<uint32_t> &voxels, const WriteFunc &writeFunc);
+	template<typename WriteFunc>
+	void rasterize(const RasterVertex vertices[3], const float *pBound, const int64_t clip[4], const WriteFunc &writeFunc);
+	void getViewClip(const uint32_t boxMin[3], const uint32_t boxMax[3], uint32_t axisX, uint32_t axisY, int64_t clip[4]) const;
+	void loadVoxelPositions(uint32_t primId, ObjLoader::float3 v[3]) const;
+	void allocateBricks(uint32_t primId, SparseGrid &sparseGrid);
+	void writeVoxel(uint32_t x, uint32_t y, uint32_t z, uint32_t data, uint16_t materialId);	// To the dense grid
+	void resolveBins(const std::vector<uint32_t> &bins);	// Packs the normal sums of RESOLVE_AVERAGE
+
+	// Normalized positions and normals of a triangle, from the mesh or the scene
+	void loadTriangle(uint32_t primId, ObjLoader::float3 pos[3], ObjLoader::float3 nrm[3]) const;
+	void loadTrianglePositions(uint32_t primId, ObjLoader::float3 pos[3]) const;
+	const SceneInstance *getSceneInstance(uint32_t primId, uint32_t &localPrimId) const;
+	uint16_t getMaterialId(uint32_t primId) const;
+
+	const ObjLoader::Vertex &getVertex(uint32_t i) const;
+	ObjLoader::float3 normalizePos(const ObjLoader::float3 &pos) const;
+
+	// Normalized position and normal from either vertex format
+	void loadVertex(uint32_t i, ObjLoader::float3 &pos, ObjLoader::float3 &nrm) const;
+	ObjLoader::float3 loadPosition(uint32_t i) const;
+
+	TaskScheduler			&m_scheduler;
+	TriangleBinner			m_binner;
+	std::vector<std::vector<uint32_t>> m_satVoxels;	// Per-worker overlap lists of TRI_SAT
+	std::vector<std::vector<uint32_t>> m_grids;	// Per mip level
+	std::vector<uint16_t>	m_materials;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_normalSums;	// Per voxel of the dense grid, with RESOLVE_AVERAGE only
+	size_t					m_numNormalSums;
+
+	uint32_t				m_gridSize;
+	uint8_t					m_numLevels;
+	Resolve					m_resolve;
+
+	const uint8_t			*m_pVertices;
+	const uint32_t			*m_pIndices;
+	uint32_t				m_numVertices;
+	uint32_t				m_numIndices;
+	uint32_t				m_stride;
+	const ObjLoader::QuantizedVertex *m_pQuantizedVertices;	// Used instead of m_pVertices if set
+
+	ObjLoader::float3		m_center;
+	ObjLoader::float3		m_extent;		// Half extents, all equal to the radius unless anisotropic
+	ObjLoader::float3		m_quantScale;	// Quantized to normalized positions
+	ObjLoader::float3		m_quantBias;
+
+	std::vector<Mesh>		m_meshes;
+	std::vector<Instance>	m_instances;
+	std::vector<SceneInstance> m_sceneInstances;	// Sorted by mesh
+	std::vector<uint32_t>	m_sceneBases;	// First triangle of each scene instance, then the total; empty outside scenes
+};
@@ -0,0 +1,314 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "WindingNumber.h"
+
+#define ACCURACY_SCALE	2.0f	// Beta of Barill et al.: dipoles are taken beyond this many radii
+#define MAX_DEPTH		48		// Of the binary tree, as TriangleBVH
+#define STACK_SIZE		(3 * MAX_DEPTH + 4)
+#define NODE_GRAIN_SIZE	1024
+#define BRICK_SIZE		8
+#define UNIFORM_MARGIN	0.25f	// Brick corners within this of 0.5 are not trusted for the whole brick
+#define FILL_DATA		(3u << 30)	// pack(float4(0.0, 0.0, 0.0, 1.0)) of an empty voxel, as CSFillSolid
+#define FOUR_PI			12.566370614359172f
+
+using namespace std;
+
+using float3 = ObjLoader::float3;
+
+static inline float3 operator+(const float3 &a, const float3 &b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline float3 operator-(const float3 &a, const float3 &b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline float3 operator*(const float3 &a, float s) { return float3(a.x * s, a.y * s, a.z * s); }
+static inline float dot(const float3 &a, const float3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline float3 cross(const float3 &a, const float3 &b)
+{
+	return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static inline float length(const float3 &a) { return sqrt(dot(a, a)); }
+
+// Van Oosterom and Strackee: signed solid angle of the triangle seen from p
+static inline float solidAngle(const float3 &p, const float3 v[3])
+{
+	const auto a = v[0] - p, b = v[1] - p, c = v[2] - p;
+	const auto la = length(a), lb = length(b), lc = length(c);
+	const auto det = dot(a, cross(b, c));
+	const auto denom = la * lb * lc + dot(a, b) * lc + dot(a, c) * lb + dot(b, c) * la;
+
+	return 2.0f * atan2(det, denom);
+}
+
+WindingNumber::WindingNumber(TaskScheduler &scheduler) :
+	TriangleBVH(scheduler),
+	m_gridSize(0),
+	m_numFilled(0)
+{
+}
+
+WindingNumber::~WindingNumber()
+{
+}
+
+void WindingNumber::Build(uint32_t numTri, const LoadFunc &loadFunc)
+{
+	TriangleBVH::Build(numTri, loadFunc);
+
+	const auto numNodes = static_cast<uint32_t>(m_nodes.size());
+	m_dipoles.resize(numNodes);
+	m_triDipoles.resize(m_triangles.size());
+	vector<float> areas(numNodes * 4);	// Per child, to weight the centers of the parents
+
+	const auto setDipole = [&](uint32_t n, uint32_t i, const float3 &normal, float area, const float3 &center, float radius)
+	{
+		auto &dipole = m_dipoles[n];
+		dipole.Center[0][i] = center.x;
+		dipole.Center[1][i] = center.y;
+		dipole.Center[2][i] = center.z;
+		dipole.Normal[0][i] = normal.x;
+		dipole.Normal[1][i] = normal.y;
+		dipole.Normal[2][i] = normal.z;
+		dipole.FarDistSq[i] = ACCURACY_SCALE * radius * ACCURACY_SCALE * radius;
+		dipole.Children[i] = m_nodes[n].Children[i];
+		dipole.Counts[i] = m_nodes[n].Counts[i];
+		areas[n * 4 + i] = area;
+	};
+
+	// Leaves and their triangles, all independent
+	m_scheduler.ParallelFor(0, numNodes, NODE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (auto n = begin; n < end; ++n)
+		{
+			const auto &node = m_nodes[n];
+			for (auto i = 0u; i < 4; ++i)
+			{
+				if (node.Counts[i] == 0)
+				{
+					// Inner children are done bottom-up below, unused ones are never taken
+					setDipole(n, i, float3(0.0f, 0.0f, 0.0f), 0.0f, float3(0.0f, 0.0f, 0.0f), 0.0f);
+					m_dipoles[n].FarDistSq[i] = -1.0f;
+					continue;
+				}
+
+				const auto triBegin = node.Children[i];
+				const auto triEnd = triBegin + node.Counts[i];
+				float3 normal(0.0f, 0.0f, 0.0f), weighted(0.0f, 0.0f, 0.0f), centroids(0.0f, 0.0f, 0.0f);
+				auto area = 0.0f;
+				for (auto t = triBegin; t < triEnd; ++t)
+				{
+					const auto &v = m_triangles[t].V;
+					const auto areaVec = cross(v[1] - v[0], v[2] - v[0]) * 0.5f;
+					const auto centroid = (v[0] + v[1] + v[2]) * (1.0f / 3.0f);
+					const auto triArea = length(areaVec);
+					auto &triDipole = m_triDipoles[t];
+					triDipole.Center = centroid;
+					triDipole.Normal = areaVec;
+					triDipole.FarDistSq = 0.0f;
+					for (const auto &u : v) triDipole.FarDistSq = (max)(triDipole.FarDistSq, dot(u - centroid, u - centroid));
+					triDipole.FarDistSq *= ACCURACY_SCALE * ACCURACY_SCALE;
+					normal = normal + areaVec;
+					weighted = weighted + centroid * triArea;
+					centroids = centroids + centroid;
+					area += triArea;
+				}
+
+				// Degenerate triangles have no area to weight by
+				const auto center = area > 0.0f ? weighted * (1.0f / area) : centroids * (1.0f / node.Counts[i]);
+				auto radius = 0.0f;
+				for (auto t = triBegin; t < triEnd; ++t)
+					for (const auto &v : m_triangles[t].V) radius = (max)(radius, length(v - center));
+				setDipole(n, i, normal, area, center, radius);
+			}
+		}
+	});
+
+	// Inner children from the 4 of their node; children come after their parents
+	for (auto n = numNodes; n-- > 0;)
+	{
+		const auto &node = m_nodes[n];
+		for (auto i = 0u; i < 4; ++i)
+		{
+			if (node.Counts[i] > 0 || node.BoundMin[0][i] > node.BoundMax[0][i]) continue;
+
+			const auto &child = m_dipoles[node.Children[i]];
+			float3 normal(0.0f, 0.0f, 0.0f), weighted(0.0f, 0.0f, 0.0f), centers(0.0f, 0.0f, 0.0f);
+			auto area = 0.0f;
+			auto numChildren = 0u;
+			for (auto j = 0u; j < 4; ++j)
+			{
+				if (child.FarDistSq[j] < 0.0f) continue;
+				const float3 center(child.Center[0][j], child.Center[1][j], child.Center[2][j]);
+				normal = normal + float3(child.Normal[0][j], child.Normal[1][j], child.Normal[2][j]);
+				weighted = weighted + center * areas[node.Children[i] * 4 + j];
+				centers = centers + center;
+				area += areas[node.Children[i] * 4 + j];
+				++numChildren;
+			}
+
+			const auto center = area > 0.0f ? weighted * (1.0f / area) : centers * (1.0f / numChildren);
+			auto radius = 0.0f;
+			for (auto j = 0u; j < 4; ++j)
+			{
+				if (child.FarDistSq[j] < 0.0f) continue;
+				const float3 childCenter(child.Center[0][j], child.Center[1][j], child.Center[2][j]);
+				radius = (max)(radius, length(childCenter - center) + sqrt(child.FarDistSq[j]) / ACCURACY_SCALE);
+			}
+
+			// The farthest box corner is tighter once the spheres of the children stack up
+			const float3 farCorner((max)(center.x - node.BoundMin[0][i], node.BoundMax[0][i] - center.x),
+				(max)(center.y - node.BoundMin[1][i], node.BoundMax[1][i] - center.y),
+				(max)(center.z - node.BoundMin[2][i], node.BoundMax[2][i] - center.z));
+			setDipole(n, i, normal, area, center, (min)(radius, length(farCorner)));
+		}
+	}
+}
+
+float WindingNumber::Evaluate(const float3 &p) const
+{
+	if (m_nodes.empty()) return 0.0f;
+
+	const auto px = _mm_set1_ps(p.x);
+	const auto py = _mm_set1_ps(p.y);
+	const auto pz = _mm_set1_ps(p.z);
+	const auto zero = _mm_setzero_ps();
+
+	uint32_t stack[STACK_SIZE];
+	stack[0] = 0;
+	auto stackSize = 1u;
+
+	auto farSum = zero;
+	auto nearSum = 0.0f;
+	while (stackSize > 0)
+	{
+		const auto &dipole = m_dipoles[stack[--stackSize]];
+
+		// Dipoles of the 4 children at once: n . (c - p) / |c - p|^3 approximates their solid angle
+		const auto dx = _mm_sub_ps(_mm_loadu_ps(dipole.Center[0]), px);
+		const auto dy = _mm_sub_ps(_mm_loadu_ps(dipole.Center[1]), py);
+		const auto dz = _mm_sub_ps(_mm_loadu_ps(dipole.Center[2]), pz);
+		const auto distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		const auto farDistSq = _mm_loadu_ps(dipole.FarDistSq);
+		const auto isFar = _mm_and_ps(_mm_cmpgt_ps(distSq, farDistSq), _mm_cmpge_ps(farDistSq, zero));
+		const auto flux = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(dipole.Normal[0])),
+			_mm_mul_ps(dy, _mm_loadu_ps(dipole.Normal[1]))), _mm_mul_ps(dz, _mm_loadu_ps(dipole.Normal[2])));
+		// 1 / |c - p|^3 from the reciprocal square root, refined by a Newton step
+		auto invDist = _mm_rsqrt_ps(distSq);
+		invDist = _mm_mul_ps(invDist, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), distSq), _mm_mul_ps(invDist, invDist))));
+		farSum = _mm_add_ps(farSum, _mm_and_ps(isFar, _mm_mul_ps(flux, _mm_mul_ps(invDist, _mm_mul_ps(invDist, invDist)))));
+
+		// Unused children are never near either
+		const auto nearMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(distSq, farDistSq)));
+		for (auto i = 0u; i < 4; ++i)
+		{
+			if (!(nearMask & (1 << i))) continue;
+			if (dipole.Counts[i] == 0) stack[stackSize++] = dipole.Children[i];
+			else
+			{
+				const auto triEnd = dipole.Children[i] + dipole.Counts[i];
+				for (auto t = dipole.Children[i]; t < triEnd; ++t)
+				{
+					const auto &triDipole = m_triDipoles[t];
+					const auto d = triDipole.Center - p;
+					const auto distSq = dot(d, d);
+					nearSum += distSq > triDipole.FarDistSq ? dot(d, triDipole.Normal) / (distSq * sqrt(distSq)) :
+						solidAngle(p, m_triangles[t].V);
+				}
+			}
+		}
+	}
+
+	float farSums[4];
+	_mm_storeu_ps(farSums, farSum);
+
+	return (nearSum + farSums[0] + farSums[1] + farSums[2] + farSums[3]) / FOUR_PI;
+}
+
+void WindingNumber::Fill(uint32_t *pGrid, uint32_t gridSize)
+{
+	m_gridSize = gridSize;
+	m_numFilled = 0;
+
+	const auto numBricks = (gridSize + BRICK_SIZE - 1) / BRICK_SIZE;
+	m_scheduler.ParallelFor(0, numBricks * numBricks * numBricks, 1, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		uint64_t numFilled = 0;
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto x = i % numBricks;
+			const auto y = i / numBricks % numBricks;
+			const auto z = i / (numBricks * numBricks);
+			fillBlock(pGrid, x * BRICK_SIZE, y * BRICK_SIZE, z * BRICK_SIZE, BRICK_SIZE, numFilled);
+		}
+		m_numFilled += numFilled;
+	});
+}
+
+uint64_t WindingNumber::GetNumFilled() const
+{
+	return m_numFilled;
+}
+
+void WindingNumber::fillBlock(uint32_t *pGrid, uint32_t x, uint32_t y, uint32_t z, uint32_t size, uint64_t &numFilled) const
+{
+	const auto gridSize = static_cast<uint64_t>(m_gridSize);
+	const auto xEnd = (min)(x + size, m_gridSize);
+	const auto yEnd = (min)(y + size, m_gridSize);
+	const auto zEnd = (min)(z + size, m_gridSize);
+	const auto getIndex = [gridSize](uint32_t i, uint32_t j, uint32_t k) { return (k * gridSize + j) * gridSize + i; };
+	const auto getMagnitude = [this](uint32_t i, uint32_t j, uint32_t k)
+	{
+		return fabs(Evaluate(float3(i + 0.5f, j + 0.5f, k + 0.5f)));
+	};
+
+	if (size > 2)
+	{
+		// The winding number only jumps across the surface, so a block without surface voxels whose
+		// corners are clearly on one side is taken whole
+		auto hasSurface = false;
+		for (auto k = z; k < zEnd && !hasSurface; ++k)
+			for (auto j = y; j < yEnd && !hasSurface; ++j)
+				for (auto i = x; i < xEnd && !hasSurface; ++i)
+					hasSurface = pGrid[getIndex(i, j, k)] != 0;
+
+		if (!hasSurface)
+		{
+			auto numInside = 0u, numOutside = 0u;
+			for (auto c = 0u; c < 8; ++c)
+			{
+				const auto w = getMagnitude(c & 1 ? xEnd - 1 : x, c & 2 ? yEnd - 1 : y, c & 4 ? zEnd - 1 : z);
+				numInside += w >= 0.5f + UNIFORM_MARGIN ? 1 : 0;
+				numOutside += w < 0.5f - UNIFORM_MARGIN ? 1 : 0;
+			}
+
+			if (numOutside == 8) return;
+			if (numInside == 8)
+			{
+				for (auto k = z; k < zEnd; ++k)
+					for (auto j = y; j < yEnd; ++j)
+						for (auto i = x; i < xEnd; ++i) pGrid[getIndex(i, j, k)] = FILL_DATA;
+				numFilled += static_cast<uint64_t>(xEnd - x) * (yEnd - y) * (zEnd - z);
+
+				return;
+			}
+		}
+
+		const auto half = size / 2;
+		for (auto c = 0u; c < 8; ++c)
+		{
+			const auto i = x + (c & 1 ? half : 0), j = y + (c & 2 ? half : 0), k = z + (c & 4 ? half : 0);
+			if (i < xEnd && j < yEnd && k < zEnd) fillBlock(pGrid, i, j, k, half, numFilled);
+		}
+
+		return;
+	}
+
+	for (auto k = z; k < zEnd; ++k)
+		for (auto j = y; j < yEnd; ++j)
+			for (auto i = x; i < xEnd; ++i)
+			{
+				auto &voxel = pGrid[getIndex(i, j, k)];
+				if (voxel || getMagnitude(i, j, k) < 0.5f) continue;
+				voxel = FILL_DATA;
+				++numFilled;
+			}
+}
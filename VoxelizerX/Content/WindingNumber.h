@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "TriangleBVH.h"
+
+//--------------------------------------------------------------------------------------
+// Generalized winding number of a triangle soup, for solid classification of meshes
+// with holes or overlaps, where the K-buffer fill counts crossings wrongly. Each child
+// of the 4-wide BVH keeps the dipole of its triangles, taken for the whole child when
+// the query point is far enough from it, so that a query visits O(log n) nodes, and
+// the triangles of the near leaves are summed exactly by their solid angles.
+//--------------------------------------------------------------------------------------
+class WindingNumber :
+	public TriangleBVH
+{
+public:
+	WindingNumber(TaskScheduler &scheduler = TaskScheduler::GetDefault());
+	virtual ~WindingNumber();
+
+	void Build(uint32_t numTri, const LoadFunc &loadFunc);
+
+	// 1 inside a closed mesh of outward triangles, 0 outside, -1 inside if they face inward
+	float Evaluate(const float3 &p) const;
+
+	// Fills the empty voxels whose centers have a winding number of magnitude at least 0.5,
+	// in bricks classified from their corners where they hold no surface voxel. Voxels are
+	// in the linear layout, as VoxelizerCPU::GetGrid(), and triangles in its voxel space.
+	void Fill(uint32_t *pGrid, uint32_t gridSize);
+	uint64_t GetNumFilled() const;
+
+protected:
+	// Per child of the 4-wide node in SoA: area-weighted center and normal of its triangles,
+	// and the squared distance beyond which the dipole stands for them. The children are
+	// copied from the node, so that the traversal does not read the nodes.
+	struct Dipole
+	{
+		float		Center[3][4];
+		float		Normal[3][4];	// Sum of the area vectors
+		float		FarDistSq[4];	// Negative for unused children
+		uint32_t	Children[4];
+		uint32_t	Counts[4];
+	};
+
+	// Of a single triangle in a near leaf, which may still be far on its own
+	struct TriangleDipole
+	{
+		float3		Center;
+		float3		Normal;
+		float		FarDistSq;
+	};
+
+	// Fills the empty voxels of the block of size^3 at (x, y, z) in place
+	void fillBlock(uint32_t *pGrid, uint32_t x, uint32_t y, uint32_t z, uint32_t size, uint64_t &numFilled) const;
+
+	std::vector<Dipole>		m_dipoles;		// Of m_nodes
+	std::vector<TriangleDipole>	m_triDipoles;	// Of m_triangles
+
+	uint32_t				m_gridSize;
+	std::atomic<uint64_t>	m_numFilled;
+};
@@ -35,6 +35,12 @@ VoxelizerX::VoxelizerX(uint32_t width, uint32_t height, std::wstring name) :
 	m_pausing(false),
 	m_tracking(false),
 	m_voxMethod(Voxelizer::TRI_PROJ),
+	m_gridSize(GRID_SIZE),
+	m_anisotropic(false),
+	m_optimizeMesh(false),
+	m_revoxelize(false),
+	m_meshFileName("Media\\bunny.obj"),
+	m_showMip(SHOW_MIP),
 	m_voxMethodDesc(VoxMethodDescs[m_voxMethod]),
 	m_solidDesc(SolidDescs[m_solid])
 {
@@ -156,7 +162,7 @@ void VoxelizerX::LoadAssets()
 
 	Resource vbUpload, ibUpload;
 	if (!m_voxelizer->Init(m_width, m_height, m_renderTargets[0].GetResource()->GetDesc().Format,
-		m_depth.GetResource()->GetDesc().Format, vbUpload, ibUpload))
+		m_depth.GetResource()->GetDesc().Format, vbUpload, ibUpload, m_meshFileName.c_str(), m_gridSize, m_anisotropic, m_optimizeMesh))
 		ThrowIfFailed(E_FAIL);
 
 	// Close the command list and execute it to begin the initial GPU setup.
@@ -257,6 +263,9 @@ void VoxelizerX::OnKeyUp(uint8_t key)
 		m_solid = !m_solid;
 		m_solidDesc = SolidDescs[m_solid];
 		break;
+	case 'M':
+		m_showMip = (m_showMip + 1) % m_voxelizer->GetNumLevels();
+		break;
 	}
 }
 
@@ -322,6 +331,39 @@ void VoxelizerX::OnMouseLeave()
 	m_tracking = false;
 }
 
+void VoxelizerX::ParseCommandLineArgs(wchar_t *argv[], int argc)
+{
+	DXFramework::ParseCommandLineArgs(argv, argc);
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		if ((_wcsnicmp(argv[i], L"-gridSize", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/gridSize", wcslen(argv[i])) == 0) && i + 1 < argc)
+		{
+			const auto gridSize = _wtoi(argv[++i]);
+			m_gridSize = gridSize > 1 ? gridSize : m_gridSize;
+		}
+		else if (_wcsnicmp(argv[i], L"-anisotropic", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/anisotropic", wcslen(argv[i])) == 0)
+			m_anisotropic = true;
+		else if (_wcsnicmp(argv[i], L"-optimizeMesh", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/optimizeMesh", wcslen(argv[i])) == 0)
+			m_optimizeMesh = true;
+		else if (_wcsnicmp(argv[i], L"-revoxelize", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/revoxelize", wcslen(argv[i])) == 0)
+			m_revoxelize = true;
+		else if ((_wcsnicmp(argv[i], L"-mesh", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/mesh", wcslen(argv[i])) == 0) && i + 1 < argc)
+		{
+			// OBJ, binary STL or binary PLY, told apart by the contents
+			const auto size = WideCharToMultiByte(CP_ACP, 0, argv[++i], -1, nullptr, 0, nullptr, nullptr);
+			m_meshFileName.resize(size > 0 ? size : 1);
+			WideCharToMultiByte(CP_ACP, 0, argv[i], -1, &m_meshFileName[0], size, nullptr, nullptr);
+			m_meshFileName.resize(m_meshFileName.size() - 1);
+		}
+	}
+}
+
 void VoxelizerX::PopulateCommandList()
 {
 	// Command list allocators can only be reset when the associated 
@@ -346,7 +388,8 @@ void VoxelizerX::PopulateCommandList()
 	m_commandList.ClearDepthStencilView(m_depth.GetDSV(), D3D12_CLEAR_FLAG_DEPTH, 1.0f);
 
 	// Voxelizer rendering
-	m_voxelizer->Render(m_solid, m_voxMethod, m_frameIndex, m_rtvTables[m_frameIndex], m_depth.GetDSV());
+	if (m_revoxelize) m_voxelizer->MarkDirty();
+	m_voxelizer->Render(m_solid, m_voxMethod, m_frameIndex, m_rtvTables[m_frameIndex], m_depth.GetDSV(), m_showMip);
 
 	// Indicate that the back buffer will now be used to present.
 	m_renderTargets[m_frameIndex].Barrier(m_commandList, D3D12_RESOURCE_STATE_PRESENT);
@@ -412,6 +455,7 @@ double VoxelizerX::CalculateFrameStats(float *pTimeStep)
 		if (m_showFPS) windowText << setprecision(2) << fixed << fps;
 		else windowText << L"[F1]";
 		windowText << L"    [V] " << m_voxMethodDesc << L"    [S] " << m_solidDesc;
+		windowText << L"    [M] Mip level " << static_cast<uint32_t>(m_showMip) << L" (" << (m_gridSize >> m_showMip) << L"^3)";
 		SetCustomWindowText(windowText.str().c_str());
 	}
 
@@ -39,6 +39,8 @@ public:
 	virtual void OnMouseWheel(float deltaZ, float posX, float posY);
 	virtual void OnMouseLeave();
 
+	virtual void ParseCommandLineArgs(wchar_t *argv[], int argc);
+
 private:
 	XUSG::DescriptorTableCache m_descriptorTableCache;
 
@@ -71,6 +73,12 @@ private:
 	bool		m_pausing;
 	StepTimer	m_timer;
 	Voxelizer::Method m_voxMethod;
+	uint32_t	m_gridSize;
+	bool		m_anisotropic;
+	bool		m_optimizeMesh;
+	bool		m_revoxelize;	// Every frame, for timing, instead of only when stale
+	std::string	m_meshFileName;
+	uint8_t		m_showMip;
 	std::wstring m_voxMethodDesc;
 	std::wstring m_solidDesc;
 
@@ -28,7 +28,9 @@
 #include "d3dx12.h"
 
 // C RunTime Header Files
+#include <cfloat>
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <iomanip>
 
@@ -38,6 +40,13 @@
 #include <unordered_map>
 #include <map>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <immintrin.h>
+#include <intrin.h>
 #include <wrl.h>
 #include <shellapi.h>
 